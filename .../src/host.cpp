@@ -26,36 +26,13 @@
 #include "experimental/xrt_device.h"
 #include "experimental/xrt_kernel.h"
 
-typedef short DTYPE;
-const int SIZE = 512;
-
-void mm_sw( std::vector<DTYPE> A, std::vector<DTYPE> B, std::vector<DTYPE> & AB){
-
-#pragma omp parallel
-    {
-        int tid = omp_get_thread_num();
-        if( tid == 0 ){
-            int nthreads = omp_get_num_threads();
-            std::cout << "Running OpenMP with " << nthreads << " threads...\n";
-        }
-    }
-
-    DTYPE sum = 0;
-#pragma omp parallel for private(sum)
-    for(int i = 0; i < SIZE; i++){
-        for(int j = 0; j<SIZE; j++){
-            sum = 0;
-            for(int k = 0; k < SIZE; k++){
-                sum = sum + A[i*SIZE+k] * B[k*SIZE+j];
-            }
-            AB[i*SIZE+j] = sum;
-        }
-    }
-}
+#include "../../lab3_actual/src/mm_ref.h"
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " <XCLBIN File>" << std::endl;
+    // Default problem is the original 512 x 512 x 512
+    mm_shape shape = {512, 512, 512, A_ROW_MAJOR};
+    if (argc < 2 || !parse_shape(argc - 2, argv + 2, shape)) {
+        std::cout << "Usage: " << argv[0] << " <XCLBIN File> [N | M K N]" << std::endl;
         return EXIT_FAILURE;
     }
     
@@ -68,39 +45,47 @@ int main(int argc, char** argv) {
     std::cout << "Load the xclbin " << xclbinFilename << std::endl;
 	auto uuid = device.load_xclbin(xclbinFilename);
 	auto dhdl = xrtDeviceOpenFromXcl(device);
-    int matrix_size = SIZE * SIZE;
-    size_t matrix_size_bytes = sizeof(DTYPE) * matrix_size;
     auto krnl = xrt::kernel(device, uuid, "mm");
 
-    // Allocate host side memory
-    std::vector<DTYPE> A(matrix_size,1);
-    std::vector<DTYPE> B(matrix_size,1);
-    std::vector<DTYPE> AB_sw(matrix_size,1);
+    std::cout << "Problem size M=" << shape.M << " K=" << shape.K << " N=" << shape.N << std::endl;
+    std::cout << "Element types: " << mm_t::name() << std::endl;
+    size_t a_size_bytes = shape.a_bytes();
+    size_t b_size_bytes = shape.b_bytes();
+    size_t ab_size_bytes = shape.ab_bytes();
+
+    // Allocate host side memory, row padding stays zero
+    std::vector<mm_in_t> A(shape.a_elems(), 0);
+    std::vector<mm_in_t> B(shape.b_elems(), 0);
+    std::vector<mm_out_t> AB_sw(shape.ab_elems(), 0);
     // Create the test data
-    for (int i = 0; i < matrix_size; ++i) {
-        A[i] = rand() % 8;
-        B[i] = rand() % 8;
+    for (int i = 0; i < shape.M; ++i) {
+        for (int k = 0; k < shape.K; ++k) {
+            shape.set_a(A.data(), i, k, rand() % 8);
+        }
+    }
+    for (int k = 0; k < shape.K; ++k) {
+        for (int j = 0; j < shape.N; ++j) {
+            shape.set_b(B.data(), k, j, rand() % 8);
+        }
     }
 
     //Allocate Buffer in Global Memory
-    auto bo0 = xrt::bo(device, matrix_size_bytes, krnl.group_id(1));
-    auto bo1 = xrt::bo(device, matrix_size_bytes, krnl.group_id(1));
-    auto bo_out = xrt::bo(device, matrix_size_bytes, krnl.group_id(1));
+    auto bo0 = xrt::bo(device, a_size_bytes, krnl.group_id(1));
+    auto bo1 = xrt::bo(device, b_size_bytes, krnl.group_id(1));
+    auto bo_out = xrt::bo(device, ab_size_bytes, krnl.group_id(1));
 
     // Map the contents of the buffer object into host memory
-    auto bo0_map = bo0.map<DTYPE*>();
-    auto bo1_map = bo1.map<DTYPE*>();
-    auto bo_out_map = bo_out.map<DTYPE*>();
+    auto bo0_map = bo0.map<mm_in_t*>();
+    auto bo1_map = bo1.map<mm_in_t*>();
+    auto bo_out_map = bo_out.map<mm_out_t*>();
 
     // Create the test data
-    for (int i = 0; i < matrix_size; ++i) {
-        bo0_map[i] = A[i];
-        bo1_map[i] = B[i];
-    }
+    std::memcpy(bo0_map, A.data(), a_size_bytes);
+    std::memcpy(bo1_map, B.data(), b_size_bytes);
 
     // Synchronize buffer content with device side
-    bo0.sync(XCL_BO_SYNC_BO_TO_DEVICE, matrix_size_bytes, 0);
-    bo1.sync(XCL_BO_SYNC_BO_TO_DEVICE, matrix_size_bytes, 0);
+    bo0.sync(XCL_BO_SYNC_BO_TO_DEVICE, a_size_bytes, 0);
+    bo1.sync(XCL_BO_SYNC_BO_TO_DEVICE, b_size_bytes, 0);
 
     std::cout << "Running FPGA MM...\n";
     double kernel_time_in_sec = 0;
@@ -108,7 +93,7 @@ int main(int argc, char** argv) {
     auto kernel_start = std::chrono::high_resolution_clock::now();
 
     //Execution of the kernel
-    auto run = krnl(bo0, bo1, bo_out, SIZE);
+    auto run = krnl(bo0, bo1, bo_out, shape.M, shape.K, shape.N);
     run.wait();
 
     auto kernel_end = std::chrono::high_resolution_clock::now();
@@ -116,23 +101,25 @@ int main(int argc, char** argv) {
     kernel_time = std::chrono::duration<double>(kernel_end - kernel_start);
     kernel_time_in_sec = kernel_time.count();
     std::cout << "Execution time = " << kernel_time_in_sec << std::endl;
-    double gops = double(SIZE) * SIZE * SIZE * 2 * 1e-9 / (kernel_time_in_sec);
+    double gops = shape.ops() * 1e-9 / (kernel_time_in_sec);
     std::cout << "Time: " << kernel_time_in_sec << " sec, GOPS: " << gops << std::endl;
 
     // Get the output data from the device;
-    bo_out.sync(XCL_BO_SYNC_BO_FROM_DEVICE, matrix_size_bytes, 0);
+    bo_out.sync(XCL_BO_SYNC_BO_FROM_DEVICE, ab_size_bytes, 0);
     
     // Calculate the golden results
-    mm_sw(A, B, AB_sw);
+    std::cout << "Running CPU MM with " << omp_get_max_threads() << " threads...\n";
+    mm_golden(shape, A.data(), B.data(), AB_sw.data());
 
     // Validate our results
     int err_cnt = 0;
-    for(int i = 0; i<SIZE; i++){
-        for(int j = 0; j<SIZE; j++){
-            if(AB_sw[i*SIZE+j] != bo_out_map[i*SIZE+j]) {
+    for(int i = 0; i<shape.M; i++){
+        for(int j = 0; j<shape.N; j++){
+            double sw = shape.get_ab(AB_sw.data(), i, j), hw = shape.get_ab(bo_out_map, i, j);
+            if(!mm_close(sw, hw)) {
                 err_cnt++;
                 if( err_cnt == 1 ){
-                    printf("i:%d j:%d sw:%d hw:%d\n", i, j, AB_sw[i*SIZE+j], bo_out_map[i*SIZE+j] );
+                    printf("i:%d j:%d sw:%g hw:%g\n", i, j, sw, hw );
                 }
             }
         }
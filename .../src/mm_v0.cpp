@@ -47,10 +47,14 @@ used in kernel.
 
 typedef short DTYPE;
 const int M = 256;
+// Row strides are padded to a 64 byte beat, matching the wide-port kernels.
+const int LD_ALIGN = 32;
 
 extern "C" {
 
-void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int N )
+// AB[Mdim][Ndim] = A[Mdim][Kdim] * B[Kdim][Ndim], any sizes.
+// Edge tiles only iterate over their valid rows/columns/depth.
+void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int Mdim, int Kdim, int Ndim )
 {
 
 #pragma HLS INTERFACE m_axi port = A offset = slave bundle = gmem
@@ -59,29 +63,39 @@ void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int N )
 #pragma HLS INTERFACE s_axilite port = A bundle = control
 #pragma HLS INTERFACE s_axilite port = B bundle = control
 #pragma HLS INTERFACE s_axilite port = AB bundle = control
-#pragma HLS INTERFACE s_axilite port = N bundle = control
+#pragma HLS INTERFACE s_axilite port = Mdim bundle = control
+#pragma HLS INTERFACE s_axilite port = Kdim bundle = control
+#pragma HLS INTERFACE s_axilite port = Ndim bundle = control
 #pragma HLS INTERFACE s_axilite port = return bundle = control
 
     DTYPE AB_block[M][M];
 
-    ib_loop: for(int ib = 0; ib < N/M; ib++) {
-        jb_loop: for(int jb = 0; jb < N/M; jb++) {
+    int ldA = (Kdim + LD_ALIGN - 1) / LD_ALIGN * LD_ALIGN;
+    int ldB = (Ndim + LD_ALIGN - 1) / LD_ALIGN * LD_ALIGN;
+
+    ib_loop: for(int ib = 0; ib < (Mdim+M-1)/M; ib++) {
+        int i_cnt = Mdim - ib*M < M ? Mdim - ib*M : M;
+        jb_loop: for(int jb = 0; jb < (Ndim+M-1)/M; jb++) {
+            int j_cnt = Ndim - jb*M < M ? Ndim - jb*M : M;
             init_i_loop: for(int i = 0; i < M; i++) {
                 init_j_loop: for(int j = 0; j < M; j++) {
                     AB_block[i][j] = 0;
                 }
             }
 
-            kb_loop: for(int kb = 0; kb < N/M; kb++) {
-                k_loop: for(int k = 0; k < M; k++) {
+            kb_loop: for(int kb = 0; kb < (Kdim+M-1)/M; kb++) {
+                int k_cnt = Kdim - kb*M < M ? Kdim - kb*M : M;
+                k_loop: for(int k = 0; k < k_cnt; k++) {
+#pragma HLS loop_tripcount min=1 max=M
                     DTYPE Bj[M];
                     readB_j_loop: for(int j = 0; j < M; j++) {
-                        DTYPE B_temp = B[(kb*M+k)*N+jb*M+j];
+                        DTYPE B_temp = j < j_cnt ? B[(kb*M+k)*ldB+jb*M+j] : (DTYPE) 0;
                         Bj[j] = B_temp;
                     }
 
-                    i_loop: for(int i = 0; i < M; i++) {
-                        DTYPE Ai =  A[((ib*M+i)*N+kb*M)+k];
+                    i_loop: for(int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+                        DTYPE Ai =  A[((ib*M+i)*ldA+kb*M)+k];
                         j_loop: for(int j = 0; j < M; j++) {
                             AB_block[i][j] += Ai * Bj[j];
                         }
@@ -89,9 +103,11 @@ void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int N )
                 }
             }
 
-            writeAB_i_loop: for(int i = 0; i < M; i++) {
-                writeAB_j_loop: for(int j = 0; j < M; j++) {
-                    AB[(ib*M+i)*N+jb*M+j] = AB_block[i][j];
+            writeAB_i_loop: for(int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+                writeAB_j_loop: for(int j = 0; j < j_cnt; j++) {
+#pragma HLS loop_tripcount min=1 max=M
+                    AB[(ib*M+i)*ldB+jb*M+j] = AB_block[i][j];
                 }
             }
         }
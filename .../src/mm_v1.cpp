@@ -48,9 +48,13 @@ used in kernel.
 typedef short DTYPE;
 const int M = 256;
 const int TILE_SIZE = M/4;
+// Row strides are padded to a 64 byte beat, matching the wide-port kernels.
+const int LD_ALIGN = 32;
 extern "C" {
 
-void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int N )
+// AB[Mdim][Ndim] = A[Mdim][Kdim] * B[Kdim][Ndim], any sizes.
+// Edge tiles only iterate over their valid rows/columns/depth.
+void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int Mdim, int Kdim, int Ndim )
 {
 #pragma HLS INTERFACE m_axi port = A offset = slave bundle = gmem
 #pragma HLS INTERFACE m_axi port = B offset = slave bundle = gmem
@@ -58,15 +62,22 @@ void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int N )
 #pragma HLS INTERFACE s_axilite port = A bundle = control
 #pragma HLS INTERFACE s_axilite port = B bundle = control
 #pragma HLS INTERFACE s_axilite port = AB bundle = control
-#pragma HLS INTERFACE s_axilite port = N bundle = control
+#pragma HLS INTERFACE s_axilite port = Mdim bundle = control
+#pragma HLS INTERFACE s_axilite port = Kdim bundle = control
+#pragma HLS INTERFACE s_axilite port = Ndim bundle = control
 #pragma HLS INTERFACE s_axilite port = return bundle = control
 
     DTYPE AB_block[M][M];
 // Fill This Part !!! Add pragma to partition AB_block
 #pragma HLS array_partition variable=AB_block type=block factor=TILE_SIZE;
 
-    ib_loop: for(int ib = 0; ib < N/M; ib++) {
-        jb_loop: for(int jb = 0; jb < N/M; jb++) {
+    int ldA = (Kdim + LD_ALIGN - 1) / LD_ALIGN * LD_ALIGN;
+    int ldB = (Ndim + LD_ALIGN - 1) / LD_ALIGN * LD_ALIGN;
+
+    ib_loop: for(int ib = 0; ib < (Mdim+M-1)/M; ib++) {
+        int i_cnt = Mdim - ib*M < M ? Mdim - ib*M : M;
+        jb_loop: for(int jb = 0; jb < (Ndim+M-1)/M; jb++) {
+            int j_cnt = Ndim - jb*M < M ? Ndim - jb*M : M;
             init_i_loop: for(int i = 0; i < M; i++) {
 // Fill This Part !!! Add #pragma HLS pipeline II=1 pragma in init_i_loop loop, therefore, init_j_loop is fully unrolled
 #pragma HLS pipeline II=1
@@ -75,20 +86,23 @@ void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int N )
                 }
             }
 
-            kb_loop: for(int kb = 0; kb < N/M; kb++) {
-                k_loop: for(int k = 0; k < M; k++) {
+            kb_loop: for(int kb = 0; kb < (Kdim+M-1)/M; kb++) {
+                int k_cnt = Kdim - kb*M < M ? Kdim - kb*M : M;
+                k_loop: for(int k = 0; k < k_cnt; k++) {
+#pragma HLS loop_tripcount min=1 max=M
                     DTYPE Bj[M];
 // Fill This Part !!! Add pragma to partition Bj
 #pragma HLS array_partition variable=Bj type=block factor=TILE_SIZE;
                     readB_j_loop: for(int j = 0; j < M; j++) {
-                        DTYPE B_temp = B[(kb*M+k)*N+jb*M+j];
+                        DTYPE B_temp = j < j_cnt ? B[(kb*M+k)*ldB+jb*M+j] : (DTYPE) 0;
                         Bj[j] = B_temp;
                     }
 
-                    i_loop: for(int i = 0; i < M; i++) {
+                    i_loop: for(int i = 0; i < i_cnt; i++) {
 // Fill This Part !!! Add #pragma HLS pipeline II=1 pragma in i_loop loop, therefore, j_loop is fully unrolled
 #pragma HLS pipeline II=1
-                        DTYPE Ai =  A[((ib*M+i)*N+kb*M)+k];
+#pragma HLS loop_tripcount min=1 max=M
+                        DTYPE Ai =  A[((ib*M+i)*ldA+kb*M)+k];
                         j_loop: for(int j = 0; j < M; j++) {
                             AB_block[i][j] += Ai * Bj[j];
                         }
@@ -96,9 +110,11 @@ void mm(DTYPE *A,  DTYPE *B, DTYPE *AB,   int N )
                 }
             }
 
-            writeAB_i_loop: for(int i = 0; i < M; i++) {
-                writeAB_j_loop: for(int j = 0; j < M; j++) {
-                    AB[(ib*M+i)*N+jb*M+j] = AB_block[i][j];
+            writeAB_i_loop: for(int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+                writeAB_j_loop: for(int j = 0; j < j_cnt; j++) {
+#pragma HLS loop_tripcount min=1 max=M
+                    AB[(ib*M+i)*ldB+jb*M+j] = AB_block[i][j];
                 }
             }
         }
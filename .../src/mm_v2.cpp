@@ -57,7 +57,9 @@ const int DTYPE_PER_PORT = PORT_WIDTH_B / sizeof(DTYPE);
 extern "C" {
 
 // increase port width of B_p, AB_p
-void mm(DTYPE *A,  block_t *B_p, block_t *AB_p,   int N )
+// AB[Mdim][Ndim] = A[Mdim][Kdim] * B[Kdim][Ndim], any sizes. Row strides are
+// padded to a whole block_t; edge tiles only move their valid beats.
+void mm(DTYPE *A,  block_t *B_p, block_t *AB_p,   int Mdim, int Kdim, int Ndim )
 {
 #pragma HLS INTERFACE m_axi port = A offset = slave bundle = gmem0
 #pragma HLS INTERFACE m_axi port = B_p offset = slave bundle = gmem1
@@ -65,15 +67,23 @@ void mm(DTYPE *A,  block_t *B_p, block_t *AB_p,   int N )
 #pragma HLS INTERFACE s_axilite port = A bundle = control
 #pragma HLS INTERFACE s_axilite port = B_p bundle = control
 #pragma HLS INTERFACE s_axilite port = AB_p bundle = control
-#pragma HLS INTERFACE s_axilite port = N bundle = control
+#pragma HLS INTERFACE s_axilite port = Mdim bundle = control
+#pragma HLS INTERFACE s_axilite port = Kdim bundle = control
+#pragma HLS INTERFACE s_axilite port = Ndim bundle = control
 #pragma HLS INTERFACE s_axilite port = return bundle = control
 
     DTYPE AB_block[M][M];
 //      Add pragma to partition AB_block
 #pragma HLS array_partition variable=AB_block type=block factor=TILE_SIZE;
 
-    ib_loop: for(int ib = 0; ib < N/M; ib++) {
-        jb_loop: for(int jb = 0; jb < N/M; jb++) {
+    int ldA = (Kdim + DTYPE_PER_PORT - 1) / DTYPE_PER_PORT * DTYPE_PER_PORT;
+    int ldB_p = (Ndim + DTYPE_PER_PORT - 1) / DTYPE_PER_PORT;
+
+    ib_loop: for(int ib = 0; ib < (Mdim+M-1)/M; ib++) {
+        int i_cnt = Mdim - ib*M < M ? Mdim - ib*M : M;
+        jb_loop: for(int jb = 0; jb < (Ndim+M-1)/M; jb++) {
+            int j_cnt = Ndim - jb*M < M ? Ndim - jb*M : M;
+            int jj_cnt = (j_cnt + DTYPE_PER_PORT - 1) / DTYPE_PER_PORT;
             init_i_loop: for(int i = 0; i < M; i++) {
 //     Add #pragma HLS pipeline II=1 pragma in init_i_loop loop, therefore, init_j_loop is fully unrolled
 #pragma HLS pipeline II=1
@@ -83,8 +93,10 @@ void mm(DTYPE *A,  block_t *B_p, block_t *AB_p,   int N )
                 }
             }
 
-            kb_loop: for(int kb = 0; kb < N/M; kb++) {
-                k_loop: for(int k = 0; k < M; k++) {
+            kb_loop: for(int kb = 0; kb < (Kdim+M-1)/M; kb++) {
+                int k_cnt = Kdim - kb*M < M ? Kdim - kb*M : M;
+                k_loop: for(int k = 0; k < k_cnt; k++) {
+#pragma HLS loop_tripcount min=1 max=M
                     DTYPE Bj[M];
 //      Add pragma to partition Bj
 #pragma HLS array_partition variable=Bj type=block factor=TILE_SIZE;
@@ -92,7 +104,9 @@ void mm(DTYPE *A,  block_t *B_p, block_t *AB_p,   int N )
 
 #pragma HLS pipeline II=1
 //       read from B_p to temp 
-                        block_t B_temp = B_p[((kb * M + k) * N / DTYPE_PER_PORT) + jb * M / DTYPE_PER_PORT + jj];
+                        block_t B_temp = 0;
+                        if (jj < jj_cnt)
+                            B_temp = B_p[((kb * M + k) * ldB_p) + jb * M / DTYPE_PER_PORT + jj];
 
 
 
@@ -106,10 +120,11 @@ void mm(DTYPE *A,  block_t *B_p, block_t *AB_p,   int N )
 						}
                     }
 
-                    i_loop: for(int i = 0; i < M; i++) {
+                    i_loop: for(int i = 0; i < i_cnt; i++) {
 //          Add #pragma HLS pipeline II=1 pragma in i_loop loop, therefore, j is fully unrolled
 #pragma HLS pipeline II=1
-                        DTYPE Ai =  A[((ib*M+i)*N+kb*M)+k];
+#pragma HLS loop_tripcount min=1 max=M
+                        DTYPE Ai =  A[((ib*M+i)*ldA+kb*M)+k];
                         j_loop: for(int j = 0; j < M; j++) {
 #pragma HLS unroll
                             AB_block[i][j] += Ai * Bj[j];
@@ -118,10 +133,12 @@ void mm(DTYPE *A,  block_t *B_p, block_t *AB_p,   int N )
                 }
             }
 
-            writeAB_i_loop: for(int i = 0; i < M; i++) {
-                writeAB_j_loop: for(int jj = 0; jj < M/DTYPE_PER_PORT; jj++) {
+            writeAB_i_loop: for(int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+                writeAB_j_loop: for(int jj = 0; jj < jj_cnt; jj++) {
 //          Add #pragma HLS pipeline II=1 pragma in writeAB_j_loop loop, therefore, j is fully unrolled
 #pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/DTYPE_PER_PORT
 					block_t AB_temp;
 					for (int j = 0; j < DTYPE_PER_PORT; j++) {
 #pragma HLS unroll
@@ -129,7 +146,7 @@ void mm(DTYPE *A,  block_t *B_p, block_t *AB_p,   int N )
                         AB_temp.range((j + 1) * DTYPE_WIDTH_b - 1, j * DTYPE_WIDTH_b) = AB_block[i][jj * DTYPE_PER_PORT + j];
 					}
 //                      read from temp to AB_p 
-                        AB_p[((ib * M + i) * N / DTYPE_PER_PORT) + jb * M / DTYPE_PER_PORT + jj] = AB_temp;
+                        AB_p[((ib * M + i) * ldB_p) + jb * M / DTYPE_PER_PORT + jj] = AB_temp;
 
 
 
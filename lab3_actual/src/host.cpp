@@ -18,97 +18,238 @@
 #include <cstring>
 #include <time.h>
 #include <algorithm>
+#include <memory>
 #include <vector>
 #include <omp.h>
 
-// XRT includes
-#include "experimental/xrt_bo.h"
-#include "experimental/xrt_device.h"
-#include "experimental/xrt_kernel.h"
+#include "mm_shape.h"
+#include "mm_abft.h"
+#include "mm_backend.h"
+#include "mm_batch.h"
+#include "mm_layout.h"
+#include "mm_ooc.h"
+#include "mm_ref.h"
+#include "mm_sched.h"
+#include "mm_stream.h"
+#include "mm_tiled.h"
+#include "mm_strassen.h"
+#include "mm_trace.h"
+#include "mm_verify.h"
 
-typedef short DTYPE;
-const int SIZE = 512;
+static void usage(const char *prog) {
+    std::cout << "Usage: " << prog << " <XCLBIN File | --cpu> [N | M K N] [--batch B | --stream J]"
+              << " [--bo device|host|user] [--trace trace.json]"
+              << " [--units U [--devices D] [--chunk C]] [--order rows|cols] [--tol R]"
+              << " [--sparse A|B|AB [--density D]] [--a-layout rows|cols]"
+              << " [--bias] [--scale R [--shift S]] [--relu] [--clamp LO HI] [--no-gemv] [--resident-b]"
+              << " [--verify ROUNDS] [--abft] [--strassen DEPTH [--cutoff C]]"
+              << " [--ooc DIR [--budget MB]] [--tiled DIR]" << std::endl;
+}
+
+// Relative tolerance of the float and half comparisons, --tol.
+static double tolerance = mm_t::tolerance;
+static bool tolerance_set = false;
+
+// Freivalds rounds that replace the golden GEMM, --verify; 0 for the full
+// comparison.
+static int verify_rounds = 0;
+
+// Tile checksums computed by the kernel check the results instead, and
+// failing tiles are re-run, --abft.
+static bool abft = false;
 
-void mm_sw( std::vector<DTYPE> At, std::vector<DTYPE> B, std::vector<DTYPE> & AB){
+// Layout A is produced in, --a-layout. The kernels read it transposed, row
+// major data is converted with mm_load_a().
+static a_layout_t src_layout = A_COL_MAJOR;
+
+// Fused epilogue of the kernels, --bias / --scale / --shift / --relu /
+// --clamp. The bias is random per column, the scale the same for every
+// column.
+static mm_epilogue epilogue;
+static double scale_value = 1;
+
+static void epilogue_vectors(const mm_shape &shape, std::vector<uint32_t> &bias, std::vector<uint32_t> &scale) {
+    bias.resize(shape.N);
+    scale.resize(shape.N);
+    for (int j = 0; j < shape.N; j++) {
+        bias[j] = mm_epilogue_word(mm_t::exact ? rand() % 2001 - 1000 : mm_t::sample(rand()));
+        scale[j] = mm_epilogue_word(scale_value);
+    }
+}
 
-#pragma omp parallel
+// Fills the valid region of one problem with test data, only A when B is
+// null.
+static void fill_problem(const mm_shape &shape, mm_in_t *A, mm_in_t *B) {
+    mm_shape src = shape;
+    src.a_layout = src_layout;
+    std::vector<char> staging(src_layout != shape.a_layout ? src.a_bytes() : 0);
     {
-        int tid = omp_get_thread_num();
-        if( tid == 0 ){
-            int nthreads = omp_get_num_threads();
-            std::cout << "Running OpenMP with " << nthreads << " threads...\n";
+        mm_trace_scope trace("data gen");
+        void *A_src = staging.empty() ? (void *) A : staging.data();
+        for (int i = 0; i < shape.M; ++i) {
+            for (int k = 0; k < shape.K; ++k) {
+                src.set_a(A_src, i, k, mm_t::sample(rand()));
+            }
+        }
+    }
+    if (!staging.empty()) {
+        mm_trace_scope trace("layout");
+        mm_load_a(shape, A, staging.data(), src_layout, src.lda());
+    }
+    if (!B)
+        return;
+    mm_trace_scope trace("data gen");
+    for (int k = 0; k < shape.K; ++k) {
+        for (int j = 0; j < shape.N; ++j) {
+            shape.set_b(B, k, j, mm_t::sample(rand()));
         }
     }
+}
+
+// Block-sparse test data: clears each tile of the operands selected by
+// sparse with probability 1 - density.
+static void sparsify_problem(const mm_shape &shape, mm_in_t *A, mm_in_t *B, mm_sparse_t sparse, double density) {
+    mm_trace_scope trace("data gen");
+    auto drop = [density] { return rand() >= density * ((double) RAND_MAX + 1); };
+    if (sparse & BLOCK_SPARSE_A) {
+        for (int i0 = 0; i0 < shape.M; i0 += TILE_DIM)
+            for (int k0 = 0; k0 < shape.K; k0 += TILE_DIM)
+                if (drop())
+                    for (int i = i0; i < std::min(shape.M, i0 + TILE_DIM); i++)
+                        for (int k = k0; k < std::min(shape.K, k0 + TILE_DIM); k++)
+                            shape.set_a(A, i, k, 0);
+    }
+    if (sparse & BLOCK_SPARSE_B) {
+        for (int k0 = 0; k0 < shape.K; k0 += TILE_DIM)
+            for (int j0 = 0; j0 < shape.N; j0 += TILE_DIM)
+                if (drop())
+                    for (int k = k0; k < std::min(shape.K, k0 + TILE_DIM); k++)
+                        for (int j = j0; j < std::min(shape.N, j0 + TILE_DIM); j++)
+                            shape.set_b(B, k, j, 0);
+    }
+}
+
+static void print_occupancy(const mm_occupancy_stats &occ, mm_sparse_t sparse) {
+    if (sparse & BLOCK_SPARSE_A)
+        std::cout << "A: " << occ.a_nonzero << " of " << occ.a_tiles << " tiles nonzero\n";
+    if (sparse & BLOCK_SPARSE_B)
+        std::cout << "B: " << occ.b_nonzero << " of " << occ.b_tiles << " tiles nonzero\n";
+    std::cout << "Tile products computed: " << occ.live << " of " << occ.products << " (" << occ.work() * 100
+              << "%)\n";
+}
+
+// Registers a random K x N weight matrix, sparsified like B with --sparse,
+// as resident B operand. It is produced row major and packed by the
+// weights themselves, like weights loaded from a file would be.
+static std::unique_ptr<mm_weights> resident_weights(mm_backend &backend, const mm_shape &shape, mm_bo_mode mode,
+                                                    mm_sparse_t sparse, double density) {
+    std::unique_ptr<mm_weights> w(new mm_weights(backend, shape.K, shape.N, mode));
+    {
+        std::vector<char> src(((size_t) shape.K * shape.N * mm_t::in_bits + 7) / 8);
+        mm_trace_scope trace("data gen");
+        for (size_t e = 0; e < (size_t) shape.K * shape.N; e++)
+            mm_t::in::set(src.data(), e, mm_t::sample(rand()));
+        w->load(src.data(), shape.N);
+    }
+    sparsify_problem(shape, nullptr, w->data(), (mm_sparse_t) (sparse & BLOCK_SPARSE_B), density);
+    long nonzero = w->sync_in();
+    std::cout << "Resident B: " << shape.K << " x " << shape.N << " registered, " << nonzero << " of "
+              << shape.tile_depth() * shape.tile_cols() << " tiles nonzero, only A is synced per launch\n";
+    return w;
+}
 
-    DTYPE sum = 0;
-#pragma omp parallel for private(sum)
-    for(int i = 0; i < SIZE; i++){
-        for(int j = 0; j<SIZE; j++){
-            sum = 0;
-            for(int k = 0; k < SIZE; k++){
-                sum = sum + At[k*SIZE+i] * B[k*SIZE+j];
+// Golden result of one problem on the host, finished with the epilogue.
+static void golden(const mm_shape &shape, const mm_in_t *A, const mm_in_t *B, mm_out_t *AB,
+                   const uint32_t *bias = nullptr, const uint32_t *scale = nullptr) {
+    mm_trace_scope trace("golden");
+    mm_golden(shape, A, B, AB, epilogue, bias, scale);
+}
+
+// Compares the valid region of AB against the golden results, exactly or
+// within the tolerance, printing the first mismatch. Returns the number of
+// wrong elements.
+static int validate(const mm_shape &shape, const mm_out_t *AB_sw, const mm_out_t *AB_hw) {
+    mm_trace_scope trace("validation");
+    int err_cnt = 0;
+    for(int i = 0; i<shape.M; i++){
+        for(int j = 0; j<shape.N; j++){
+            double sw = shape.get_ab(AB_sw, i, j), hw = shape.get_ab(AB_hw, i, j);
+            if(!mm_close(sw, hw, tolerance)) {
+                err_cnt++;
+                if( err_cnt == 1 ){
+                    printf("i:%d j:%d sw:%g hw:%g\n", i, j, sw, hw );
+                }
             }
-            AB[i*SIZE+j] = sum;
         }
     }
+    return err_cnt;
 }
 
-int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " <XCLBIN File>" << std::endl;
-        return EXIT_FAILURE;
+// Reports the checksum checks of --abft, the tiles still failing count as
+// errors.
+static int report_abft(const mm_abft_stats &s, long tiles) {
+    std::cout << "ABFT: " << s.detected << " of " << tiles << " tiles failed their checksums";
+    if (s.detected)
+        std::cout << ", " << s.rerun << " tile(s) re-run, " << s.failed << " still failing";
+    std::cout << "\n";
+    return (int) s.failed;
+}
+
+// Checks one result: against the golden GEMM, or with --verify by
+// Freivalds rounds, which report the failing rows and columns and the wrong
+// entries where they cross. Returns the number of wrong elements found.
+static int check_result(const mm_shape &shape, const mm_in_t *A, const mm_in_t *B, const mm_out_t *AB,
+                        const uint32_t *bias, const uint32_t *scale) {
+    if (verify_rounds > 0 && mm_verify_supported(epilogue)) {
+        std::cout << "Verifying with " << verify_rounds << " Freivalds rounds...\n";
+        mm_verify_result v;
+        {
+            mm_trace_scope trace("verify");
+            v = mm_freivalds(shape, A, B, AB, verify_rounds, epilogue, bias, scale, rand(), tolerance);
+        }
+        if (v.ok())
+            return 0;
+        std::cout << "Failing rows: " << v.rows.size() << ", failing columns: " << v.cols.size() << "\n";
+        if (!v.wrong.empty())
+            printf("i:%d j:%d hw:%g\n", v.wrong[0].first, v.wrong[0].second,
+                   shape.get_ab(AB, v.wrong[0].first, v.wrong[0].second));
+        return std::max<int>(1, (int) v.wrong.size());
     }
-    
-    //////////////////////////////////////////
-    // Open xclbin
-    //////////////////////////////////////////
-    auto device = xrt::device(0); //device index=0
-    char* xclbinFilename=argv[1];
-    std::cout << "Open the device " << 0 << std::endl;
-    std::cout << "Load the xclbin " << xclbinFilename << std::endl;
-	auto uuid = device.load_xclbin(xclbinFilename);
-	auto dhdl = xrtDeviceOpenFromXcl(device);
-    int matrix_size = SIZE * SIZE;
-    size_t matrix_size_bytes = sizeof(DTYPE) * matrix_size;
-    auto krnl = xrt::kernel(device, uuid, "mm");
-
-    // Allocate host side memory
-    std::vector<DTYPE> A(matrix_size,1);
-    std::vector<DTYPE> B(matrix_size,1);
-    std::vector<DTYPE> AB_sw(matrix_size,1);
-    // Create the test data
-    for (int i = 0; i < matrix_size; ++i) {
-        A[i] = rand() % 8;
-        B[i] = rand() % 8;
-    }
-
-    //Allocate Buffer in Global Memory
-    auto bo0 = xrt::bo(device, matrix_size_bytes, krnl.group_id(1));
-    auto bo1 = xrt::bo(device, matrix_size_bytes, krnl.group_id(1));
-    auto bo_out = xrt::bo(device, matrix_size_bytes, krnl.group_id(1));
-
-    // Map the contents of the buffer object into host memory
-    auto bo0_map = bo0.map<DTYPE*>();
-    auto bo1_map = bo1.map<DTYPE*>();
-    auto bo_out_map = bo_out.map<DTYPE*>();
-
-    // Create the test data
-    for (int i = 0; i < matrix_size; ++i) {
-        bo0_map[i] = A[i];
-        bo1_map[i] = B[i];
+    if (verify_rounds > 0)
+        std::cout << "Not linear (epilogue or ap_fixed), verifying with the full golden GEMM\n";
+    std::cout << "Running CPU MM with " << omp_get_max_threads() << " threads...\n";
+    std::vector<mm_out_t> AB_sw(shape.ab_elems());
+    golden(shape, A, B, AB_sw.data(), bias, scale);
+    return validate(shape, AB_sw.data(), AB);
+}
+
+static int run_single(mm_backend &backend, const mm_shape &shape, mm_bo_mode mode, tile_order_t order,
+                      mm_sparse_t sparse, double density, mm_weights *w) {
+    //Allocate Buffer in Global Memory, mapped into host memory
+    mm_operands ops = w ? mm_operands(backend, shape, *w, 1, mode) : mm_operands(backend, shape, 1, mode);
+    ops.order = order;
+    ops.set_abft(abft);
+
+    // Create the test data in place
+    fill_problem(shape, ops.A(), w ? nullptr : ops.B());
+    if (sparse) {
+        sparsify_problem(shape, ops.A(), ops.B(), w ? (mm_sparse_t) (sparse & BLOCK_SPARSE_A) : sparse, density);
+        print_occupancy(ops.set_sparse(sparse), sparse);
     }
+    std::vector<uint32_t> bias, scale;
+    epilogue_vectors(shape, bias, scale);
+    ops.set_epilogue(epilogue, bias.data(), scale.data());
 
     // Synchronize buffer content with device side
-    bo0.sync(XCL_BO_SYNC_BO_TO_DEVICE, matrix_size_bytes, 0);
-    bo1.sync(XCL_BO_SYNC_BO_TO_DEVICE, matrix_size_bytes, 0);
+    ops.sync_in();
 
-    std::cout << "Running FPGA MM...\n";
+    std::cout << "Running MM on " << backend.name() << "...\n";
     double kernel_time_in_sec = 0;
     std::chrono::duration<double> kernel_time(0);
     auto kernel_start = std::chrono::high_resolution_clock::now();
 
-    //Execution of the kernel
-    auto run = krnl(bo0, bo1, bo_out, SIZE);
+    //Execution of the kernel, a batch of one
+    mm_job run = ops.launch(backend);
     run.wait();
 
     auto kernel_end = std::chrono::high_resolution_clock::now();
@@ -116,27 +257,456 @@ int main(int argc, char** argv) {
     kernel_time = std::chrono::duration<double>(kernel_end - kernel_start);
     kernel_time_in_sec = kernel_time.count();
     std::cout << "Execution time = " << kernel_time_in_sec << std::endl;
-    double gops = double(SIZE) * SIZE * SIZE * 2 * 1e-9 / (kernel_time_in_sec);
+    double gops = shape.ops() * 1e-9 / (kernel_time_in_sec);
     std::cout << "Time: " << kernel_time_in_sec << " sec, GOPS: " << gops << std::endl;
 
     // Get the output data from the device;
-    bo_out.sync(XCL_BO_SYNC_BO_FROM_DEVICE, matrix_size_bytes, 0);
-    
-    // Calculate the golden results
-    mm_sw(A, B, AB_sw);
+    ops.sync_out();
+
+    if (abft) {
+        mm_abft_stats s = mm_abft_repair(backend, ops, 2, tolerance);
+        if (s.supported)
+            return report_abft(s, shape.num_tiles());
+        std::cout << "Not linear (epilogue or ap_fixed), no checksum check\n";
+    }
+
+    // Validate our results against the mapped inputs
+    return check_result(shape, ops.A(), ops.B(), ops.AB(), bias.data(), scale.data());
+}
+
+static int run_batch(mm_backend &backend, const mm_shape &shape, int count, mm_bo_mode mode, tile_order_t order,
+                     mm_sparse_t sparse, double density, mm_weights *w) {
+    mm_batch batch = w ? mm_batch(backend, shape, *w, count, mode) : mm_batch(backend, shape, count, mode);
+    batch.set_order(order);
+    batch.set_abft(abft);
+    std::cout << "Batch of " << count << " problems in " << batch.num_groups() << " launch(es)\n";
+
+    // Create the test data directly in the mapped buffers
+    for (int b = 0; b < count; ++b) {
+        fill_problem(shape, batch.A(b), w ? nullptr : batch.B(b));
+        if (sparse)
+            sparsify_problem(shape, batch.A(b), batch.B(b), w ? (mm_sparse_t) (sparse & BLOCK_SPARSE_A) : sparse,
+                             density);
+    }
+    if (sparse)
+        print_occupancy(batch.set_sparse(sparse), sparse);
+    std::vector<uint32_t> bias, scale;
+    epilogue_vectors(shape, bias, scale);
+    batch.set_epilogue(epilogue, bias.data(), scale.data());
+    batch.sync_in();
+
+    std::cout << "Running MM on " << backend.name() << "...\n";
+    double kernel_time_in_sec = batch.run();
+    std::cout << "Done.\n";
+    double gops = shape.ops() * count * 1e-9 / (kernel_time_in_sec);
+    std::cout << "Time: " << kernel_time_in_sec << " sec, GOPS: " << gops
+              << ", problems/s: " << count / kernel_time_in_sec << std::endl;
+
+    batch.sync_out();
+
+    if (abft) {
+        mm_abft_stats s = batch.abft_repair(2, tolerance);
+        if (s.supported)
+            return report_abft(s, (long) shape.num_tiles() * count);
+        std::cout << "Not linear (epilogue or ap_fixed), no checksum check\n";
+    }
 
-    // Validate our results
     int err_cnt = 0;
-    for(int i = 0; i<SIZE; i++){
-        for(int j = 0; j<SIZE; j++){
-            if(AB_sw[i*SIZE+j] != bo_out_map[i*SIZE+j]) {
-                err_cnt++;
-                if( err_cnt == 1 ){
-                    printf("i:%d j:%d sw:%d hw:%d\n", i, j, AB_sw[i*SIZE+j], bo_out_map[i*SIZE+j] );
+    for (int b = 0; b < count; ++b) {
+        int err = check_result(shape, batch.A(b), batch.B(b), batch.AB(b), bias.data(), scale.data());
+        if (err != 0)
+            printf("problem %d: %d errors\n", b, err);
+        err_cnt += err;
+    }
+    return err_cnt;
+}
+
+// One GEMM split by up to `depth` levels of Strassen-Winograd recursion,
+// each leaf dimension at least cutoff, the leaves run as one batch.
+static int run_strassen(mm_backend &backend, const mm_shape &shape, int depth, int cutoff, mm_bo_mode mode) {
+    int d = mm_strassen_depth(shape, depth, cutoff);
+    mm_strassen st(backend, shape, d, mode);
+    if (!tolerance_set)
+        tolerance = mm_strassen_tolerance(d);
+    fill_problem(shape, st.A(), st.B());
+    std::cout << "Strassen-Winograd: " << d << " level(s), " << st.num_leaves() << " leaf products of M="
+              << st.leaf().M << " K=" << st.leaf().K << " N=" << st.leaf().N << "\n";
+
+    std::cout << "Running MM on " << backend.name() << "...\n";
+    mm_strassen_stats stats = st.run();
+    std::cout << "Done.\n";
+    std::cout << "Split: " << stats.split << " sec, leaves: " << stats.kernel << " sec, combine: " << stats.combine
+              << " sec" << std::endl;
+    std::cout << "Time: " << stats.seconds << " sec, GOPS: " << shape.ops() * 1e-9 / stats.seconds
+              << " (direct-equivalent)" << std::endl;
+
+    return check_result(shape, st.A(), st.B(), st.AB(), nullptr, nullptr);
+}
+
+// Test data for --ooc: fn is reused when it already holds a rows x cols
+// matrix, otherwise written row by row.
+static void ooc_input(const std::string &fn, int rows, int cols) {
+    try {
+        mm_file_matrix existing(fn, rows, cols, mm_t::in_bits, false);
+        std::cout << "Reusing " << fn << "\n";
+        return;
+    } catch (const std::runtime_error &) {
+    }
+    mm_trace_scope trace("data gen");
+    mm_file_matrix m(fn, rows, cols, mm_t::in_bits, true);
+    std::vector<mm_in_t> row(cols);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++)
+            mm_t::in::set(row.data(), c, mm_t::sample(rand()));
+        m.write(r, 0, 1, cols, row.data(), cols);
+    }
+}
+
+// C = A B out of core, DIR/A.bin and DIR/B.bin into DIR/C.bin through
+// device buffers of at most budget_mb. A full golden GEMM would not fit
+// either, so a few sampled rows of C are checked, B streamed once in
+// column blocks.
+static int run_ooc(mm_backend &backend, const mm_shape &shape, const std::string &dir, size_t budget_mb,
+                   mm_bo_mode mode) {
+    // sizes the panels, a budget too small fails before any file is written
+    mm_ooc ooc(backend, shape, budget_mb << 20, 3, mode);
+    ooc_input(dir + "/A.bin", shape.M, shape.K);
+    ooc_input(dir + "/B.bin", shape.K, shape.N);
+    mm_file_matrix A(dir + "/A.bin", shape.M, shape.K, mm_t::in_bits, false);
+    mm_file_matrix B(dir + "/B.bin", shape.K, shape.N, mm_t::in_bits, false);
+    mm_file_matrix C(dir + "/C.bin", shape.M, shape.N, mm_t::out_bits, true);
+
+    if (!tolerance_set)
+        tolerance = ooc.tolerance();
+    const mm_shape &p = ooc.panel();
+    std::cout << "Out of core: panels of M=" << p.M << " K=" << p.K << " N=" << p.N << ", " << ooc.num_jobs()
+              << " panel products\n";
+    std::cout << "Running MM on " << backend.name() << "...\n";
+    mm_ooc_stats stats = ooc.run(A, B, C);
+    std::cout << "Done.\n";
+    std::cout << "Time: " << stats.seconds << " sec, GOPS: " << shape.ops() * 1e-9 / stats.seconds
+              << ", reading: " << stats.read_busy << " sec, writing: " << stats.write_busy << " sec" << std::endl;
+
+    int rows = std::min(shape.M, 8);
+    std::cout << "Checking " << rows << " sampled rows of C...\n";
+    mm_trace_scope trace("validation");
+    mm_shape s = {rows, shape.K, std::min(shape.N, 1024), A_COL_MAJOR};
+    std::vector<int> picked(rows);
+    std::vector<mm_in_t> a_rows((size_t) rows * shape.K), sa(s.a_elems()), sb(s.b_elems());
+    std::vector<mm_out_t> ref(s.ab_elems()), hw(s.ab_elems());
+    for (int r = 0; r < rows; r++) {
+        picked[r] = rows == shape.M ? r : rand() % shape.M;
+        A.read(picked[r], 0, 1, shape.K, a_rows.data() + (size_t) r * shape.K, shape.K);
+    }
+    mm_load_a(s, sa.data(), a_rows.data(), A_ROW_MAJOR, shape.K);
+    int err_cnt = 0;
+    for (int j0 = 0; j0 < shape.N; j0 += s.N) {
+        B.read(0, j0, shape.K, s.N, sb.data(), s.ldb());
+        mm_golden(s, sa.data(), sb.data(), ref.data());
+        for (int r = 0; r < rows; r++)
+            C.read(picked[r], j0, 1, s.N, hw.data() + s.ab_index(r, 0), s.ldab());
+        for (int r = 0; r < rows; r++) {
+            for (int j = 0; j < std::min(s.N, shape.N - j0); j++) {
+                double sw = s.get_ab(ref.data(), r, j), v = s.get_ab(hw.data(), r, j);
+                if (!mm_close(sw, v, tolerance) && err_cnt++ == 0)
+                    printf("i:%d j:%d sw:%g hw:%g\n", picked[r], j0 + j, sw, v);
+            }
+        }
+    }
+    return err_cnt;
+}
+
+// One GEMM on operands mapped from DIR/A.mmt and DIR/B.mmt (mm_tiled.h),
+// both written with test data first unless they already hold this
+// problem, its result mapped to DIR/AB.mmt.
+static int run_tiled(mm_backend &backend, const mm_shape &shape, const std::string &dir, tile_order_t order,
+                     mm_bo_mode mode) {
+    std::string fa = dir + "/A.mmt", fb = dir + "/B.mmt", why;
+    bool reuse = false;
+    try {
+        reuse = mm_tiled_file::open(fa).holds_a(shape, &why) && mm_tiled_file::open(fb).holds_b(shape, &why);
+    } catch (const std::runtime_error &e) {
+        why = e.what();
+    }
+    if (!reuse) {
+        std::cout << "Writing " << fa << " and " << fb << " (" << why << ")\n";
+        mm_tiled_file A = mm_tiled_file::create(
+            fa, shape.M, shape.K, mm_dtype_in(), shape.a_layout == A_COL_MAJOR ? TILED_TRANSPOSED : TILED_ROW_MAJOR);
+        mm_tiled_file B = mm_tiled_file::create(fb, shape.K, shape.N, mm_dtype_in());
+        fill_problem(shape, (mm_in_t *) A.data(), (mm_in_t *) B.data());
+        A.flush();
+        B.flush();
+    } else {
+        std::cout << "Reusing " << fa << " and " << fb << "\n";
+    }
+    mm_tiled_file A = mm_tiled_file::open(fa), B = mm_tiled_file::open(fb);
+    mm_tiled_file AB = mm_tiled_file::create(dir + "/AB.mmt", shape.M, shape.N, mm_dtype_out());
+    mm_operands ops(backend, shape, A.import(backend), B.import(backend), AB.import(backend), mode);
+    ops.order = order;
+    ops.sync_in();
+
+    std::cout << "Running MM on " << backend.name() << "...\n";
+    auto start = std::chrono::high_resolution_clock::now();
+    ops.launch(backend).wait();
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Done.\n";
+    std::cout << "Time: " << seconds << " sec, GOPS: " << shape.ops() * 1e-9 / seconds << std::endl;
+    ops.sync_out();
+    AB.flush();
+
+    return check_result(shape, ops.A(), ops.B(), ops.AB(), nullptr, nullptr);
+}
+
+// Sustained throughput over a stream of jobs. Each buffer set gets fresh
+// data and a golden result on first use; later jobs on that set reuse its
+// inputs so the producer does not become the bottleneck.
+static int run_stream(mm_backend &backend, const mm_shape &shape, int jobs, mm_bo_mode mode, mm_weights *w) {
+    mm_stream stream = w ? mm_stream(backend, shape, *w, 3, mode) : mm_stream(backend, shape, 3, mode);
+    int nslots = stream.num_slots();
+    std::vector<std::vector<mm_out_t>> AB_sw(nslots);
+    int err_cnt = 0;
+
+    auto produce = [&](int job, mm_in_t *A, mm_in_t *B) {
+        if (job >= nslots)
+            return;
+        fill_problem(shape, A, B);
+        AB_sw[job].resize(shape.ab_elems());
+        golden(shape, A, B ? B : w->data(), AB_sw[job].data());
+    };
+    auto consume = [&](int job, const mm_out_t *AB) {
+        int err = validate(shape, AB_sw[job % nslots].data(), AB);
+        if (err != 0)
+            printf("job %d: %d errors\n", job, err);
+        err_cnt += err;
+    };
+
+    std::cout << "Streaming " << jobs << " jobs through " << nslots << " buffer sets...\n";
+    mm_stream_stats stats = stream.run(jobs, produce, consume);
+    std::cout << "Done.\n";
+    std::cout << "Time: " << stats.seconds << " sec, GOPS: " << stats.gops()
+              << ", jobs/s: " << stats.jobs_per_sec() << std::endl;
+    return err_cnt;
+}
+
+// One GEMM spread over several compute units by the tile scheduler.
+static int run_sched(const std::vector<mm_backend *> &units, const mm_shape &shape, int chunk, mm_bo_mode mode) {
+    mm_sched sched(units, shape, chunk, mode);
+    fill_problem(shape, sched.A(), sched.B());
+
+    std::cout << "Running MM on " << units.size() << " " << units[0]->name() << " units, "
+              << shape.num_tiles() << " tiles in chunks of " << chunk << "...\n";
+    mm_sched_stats stats = sched.run();
+    std::cout << "Done.\n";
+    std::cout << "Time: " << stats.seconds << " sec, GOPS: " << shape.ops() * 1e-9 / stats.seconds << std::endl;
+    for (int u = 0; u < sched.num_units(); u++)
+        std::cout << "unit " << u << ": " << stats.tiles_per_unit[u] << " tiles\n";
+
+    return check_result(shape, sched.A(), sched.B(), sched.AB(), nullptr, nullptr);
+}
+
+int main(int argc, char** argv) {
+    // Default problem is the original 512 x 512 x 512
+    mm_shape shape = {512, 512, 512, A_COL_MAJOR};
+    int batch = 0;
+    int jobs = 0;
+    int nunits = 0, ndevices = 1, chunk = 1;
+    mm_bo_mode mode = BO_DEVICE;
+    tile_order_t order = TILE_ROWS;
+    mm_sparse_t sparse = BLOCK_DENSE;
+    double density = 1;
+    bool gemv = true, resident = false;
+    int strassen = -1, cutoff = TILE_DIM;
+    const char *ooc_dir = nullptr, *tiled_dir = nullptr;
+    size_t budget_mb = 1024;
+    const char *trace_path = nullptr;
+    std::vector<char*> dims;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--stream") && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--bo") && i + 1 < argc) {
+            if (!parse_bo_mode(argv[++i], mode)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (!strcmp(argv[i], "--units") && i + 1 < argc) {
+            nunits = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--devices") && i + 1 < argc) {
+            ndevices = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--chunk") && i + 1 < argc) {
+            chunk = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--order") && i + 1 < argc) {
+            if (!parse_tile_order(argv[++i], order)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (!strcmp(argv[i], "--sparse") && i + 1 < argc) {
+            if (!parse_sparse(argv[++i], sparse)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (!strcmp(argv[i], "--density") && i + 1 < argc) {
+            density = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--a-layout") && i + 1 < argc) {
+            if (!parse_a_layout(argv[++i], src_layout)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (!strcmp(argv[i], "--bias")) {
+            epilogue.flags |= EPILOGUE_BIAS;
+        } else if (!strcmp(argv[i], "--scale") && i + 1 < argc) {
+            epilogue.flags |= EPILOGUE_SCALE;
+            scale_value = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--shift") && i + 1 < argc) {
+            epilogue.shift = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--relu")) {
+            epilogue.flags |= EPILOGUE_RELU;
+        } else if (!strcmp(argv[i], "--clamp") && i + 2 < argc) {
+            epilogue.flags |= EPILOGUE_CLAMP;
+            epilogue.act_lo = atoi(argv[++i]);
+            epilogue.act_hi = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--no-gemv")) {
+            gemv = false;
+        } else if (!strcmp(argv[i], "--resident-b")) {
+            resident = true;
+        } else if (!strcmp(argv[i], "--verify") && i + 1 < argc) {
+            verify_rounds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--abft")) {
+            abft = true;
+        } else if (!strcmp(argv[i], "--strassen") && i + 1 < argc) {
+            strassen = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--cutoff") && i + 1 < argc) {
+            cutoff = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--ooc") && i + 1 < argc) {
+            ooc_dir = argv[++i];
+        } else if (!strcmp(argv[i], "--tiled") && i + 1 < argc) {
+            tiled_dir = argv[++i];
+        } else if (!strcmp(argv[i], "--budget") && i + 1 < argc) {
+            budget_mb = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--tol") && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+            tolerance_set = true;
+        } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (!strncmp(argv[i], "--", 2)) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            dims.push_back(argv[i]);
+        }
+    }
+    if (argc < 2 || !parse_shape((int) dims.size(), dims.data(), shape) || batch < 0 || jobs < 0 || (batch > 0 && jobs > 0)
+        || tolerance < 0 || verify_rounds < 0 || nunits < 0 || ndevices < 1 || chunk < 1 || (nunits > 0 && (batch > 0 || jobs > 0))
+        || density < 0 || density > 1 || ((sparse || epilogue.flags) && (nunits > 0 || jobs > 0))
+        || (resident && nunits > 0) || (abft && (nunits > 0 || jobs > 0)) || cutoff < 1
+        || (strassen >= 0 && (nunits > 0 || batch > 0 || jobs > 0 || sparse || epilogue.flags || resident || abft))
+        || (ooc_dir && (strassen >= 0 || nunits > 0 || batch > 0 || jobs > 0 || sparse || epilogue.flags || resident
+                        || abft || verify_rounds > 0 || src_layout != A_COL_MAJOR))
+        || (tiled_dir && (ooc_dir || strassen >= 0 || nunits > 0 || batch > 0 || jobs > 0 || sparse || epilogue.flags
+                          || resident || abft))
+        || epilogue.shift < 0 || epilogue.shift > 62 || epilogue.act_lo > epilogue.act_hi) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (trace_path)
+        mm_tracer::get().enable();
+    
+    //////////////////////////////////////////
+    // Open xclbin, or fall back to the native kernel build
+    //////////////////////////////////////////
+    // With --units, one backend per compute unit: U CUs (mm_1..mm_U) on
+    // each of D devices, or U * D native instances with --cpu. Unless
+    // --no-gemv is given, launches with N <= MM_GEMV_N go to the skinny
+    // kernel (mm_gemv, mm_gemv_1..mm_gemv_U) when the xclbin has it; it has
+    // no checksums, so --abft launches stay on mm.
+    std::vector<std::unique_ptr<mm_backend>> backends;
+    int per_device = nunits > 0 ? nunits : 1;
+    for (int d = 0; d < ndevices; d++) {
+        for (int c = 0; c < per_device; c++) {
+            std::unique_ptr<mm_backend> general, skinny;
+            if (!strcmp(argv[1], "--cpu")) {
+                general.reset(new mm_cpu_backend());
+                if (gemv)
+                    skinny.reset(new mm_cpu_backend(true));
+            } else {
+#ifndef MM_NO_XRT
+                std::string id = nunits > 0 ? ":{mm_" + std::to_string(c + 1) + "}" : "";
+                mm_xrt_backend *xrt = new mm_xrt_backend(argv[1], d, "mm" + id);
+                general.reset(xrt);
+                if (gemv) {
+                    std::string gemv_id = nunits > 0 ? ":{mm_gemv_" + std::to_string(c + 1) + "}" : "";
+                    try {
+                        skinny.reset(new mm_xrt_backend(*xrt, "mm_gemv" + gemv_id));
+                    } catch (const std::exception &) {
+                        if (d == 0 && c == 0)
+                            std::cout << "No mm_gemv" << gemv_id << " kernel in the xclbin, skinny shapes run on mm"
+                                      << std::endl;
+                    }
                 }
+#else
+                std::cout << "Built without XRT, only --cpu is available" << std::endl;
+                return EXIT_FAILURE;
+#endif
             }
+            if (skinny)
+                backends.emplace_back(new mm_dispatch_backend(std::move(general), std::move(skinny)));
+            else
+                backends.push_back(std::move(general));
         }
     }
+    mm_backend *backend = backends[0].get();
+    if (shape.N <= MM_GEMV_N && !abft && dynamic_cast<mm_dispatch_backend *>(backend))
+        std::cout << "N <= " << MM_GEMV_N << ": running the skinny kernel mm_gemv" << std::endl;
+
+    std::cout << "Problem size M=" << shape.M << " K=" << shape.K << " N=" << shape.N << std::endl;
+    std::cout << "Element types: " << mm_t::name() << std::endl;
+    if (ooc_dir && !mm_ooc_supported()) {
+        std::cout << "Out of core needs byte sized integers with out_bits <= acc_bits, or float" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (strassen >= 0 && !mm_strassen_supported()) {
+        std::cout << "Strassen needs results wrapping within the input width, or float" << std::endl;
+        return EXIT_FAILURE;
+    }
+    int err_cnt;
+    // bad files, directories and budgets, and failed device allocations and
+    // syncs, surface as exceptions
+    try {
+        // B registered once and kept on the device, --resident-b
+        std::unique_ptr<mm_weights> weights;
+        if (resident)
+            weights = resident_weights(*backend, shape, mode, sparse, density);
+        if (nunits > 0) {
+            std::vector<mm_backend *> units;
+            for (auto &b : backends)
+                units.push_back(b.get());
+            err_cnt = run_sched(units, shape, chunk, mode);
+        } else if (tiled_dir)
+            err_cnt = run_tiled(*backend, shape, tiled_dir, order, mode);
+        else if (ooc_dir)
+            err_cnt = run_ooc(*backend, shape, ooc_dir, budget_mb, mode);
+        else if (strassen >= 0)
+            err_cnt = run_strassen(*backend, shape, strassen, cutoff, mode);
+        else if (batch > 0)
+            err_cnt = run_batch(*backend, shape, batch, mode, order, sparse, density, weights.get());
+        else if (jobs > 0)
+            err_cnt = run_stream(*backend, shape, jobs, mode, weights.get());
+        else
+            err_cnt = run_single(*backend, shape, mode, order, sparse, density, weights.get());
+    } catch (const std::exception &e) {
+        std::cout << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (trace_path) {
+        std::cout << "\nPhase summary:\n";
+        mm_tracer::get().print_summary();
+        if (!mm_tracer::get().write_chrome(trace_path))
+            std::cout << "Could not write " << trace_path << std::endl;
+        else
+            std::cout << "Trace written to " << trace_path << std::endl;
+    }
 
     if(err_cnt != 0){
         printf("TEST FAILED! Error count : %d\n", err_cnt);
@@ -147,4 +717,4 @@ int main(int argc, char** argv) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,284 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Algorithm-based fault tolerance (ABFT) checks of kernel results.
+//
+// Launches with abft set (mm_operands::abft) also return checksums of every
+// output tile, which the kernel computes from the operands apart from its
+// MACs (abft_sums in mm_kernel.h): the column sums sum_i S[i][j] and the
+// row sums sum_j S[i][j] of the tile's raw sums S. Summing the rows and
+// columns of the tiles that came back checks a whole result in O(MN)
+// without a reference GEMM and names the corrupted tiles, which
+// mm_abft_repair() then recomputes alone.
+//
+// Integers compare exactly in the kernel's modular arithmetic, modulo
+// 2^min(out_bits, acc_bits), with the bias counted once per row of a
+// column sum and once per column of a row sum. Float and half compare
+// within the error mm_close() allows each entry plus the float rounding of
+// the kernel's checksums, so a wrong entry is only caught when its error
+// exceeds that slack summed over its tile row or column. With a scale only
+// the column sums apply. ReLU, clamp, the integer requantizing scale and
+// the fraction bits ap_fixed truncates are not linear; those results are
+// not supported.
+
+#ifndef MM_ABFT_H
+#define MM_ABFT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "mm_backend.h"
+#include "mm_ref.h"
+#include "mm_trace.h"
+
+struct mm_abft_result {
+    bool supported = true; // false when the epilogue is not linear
+    std::vector<int> tiles; // tiles whose checksums failed, in row order
+
+    bool ok() const { return supported && tiles.empty(); }
+};
+
+template <class T, bool EXACT = T::exact> struct mm_abft_impl {
+    static const int BITS = std::min(T::out_bits, T::acc_bits);
+
+    static bool supported(const mm_epilogue &e) { return T::frac_bits == 0 && !(e.flags & ~EPILOGUE_BIAS); }
+
+    // exact checks need no magnitudes
+    struct bounds {
+        bounds(const mm_shape &, const void *, const void *) {}
+    };
+
+    static uint64_t mask() { return BITS >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << BITS) - 1; }
+    static uint64_t ab(const mm_shape &s, const void *AB, int i, int j) {
+        return T::out::get_raw(AB, s.ab_index(i, j));
+    }
+    static uint64_t bias(const mm_ref_epilogue &epi, int j) {
+        return epi.e.flags & EPILOGUE_BIAS ? (uint64_t) (int64_t) (int32_t) epi.b(j) : 0;
+    }
+
+    static bool tile_ok(const mm_shape &s, const void *AB, const int64_t *chk, const mm_ref_epilogue &epi,
+                        const bounds &, double, int t) {
+        int i0 = s.tile_row(t) * TILE_DIM, j0 = s.tile_col(t) * TILE_DIM;
+        int i_cnt = std::min(TILE_DIM, s.M - i0), j_cnt = std::min(TILE_DIM, s.N - j0);
+        const int64_t *col = chk + s.chk_index(t), *row = col + TILE_DIM;
+        uint64_t bias_row = 0;
+        for (int j = 0; j < j_cnt; j++) {
+            uint64_t sum = 0;
+            for (int i = 0; i < i_cnt; i++)
+                sum += ab(s, AB, i0 + i, j0 + j);
+            if ((sum - (uint64_t) col[j] - bias(epi, j0 + j) * i_cnt) & mask())
+                return false;
+            bias_row += bias(epi, j0 + j);
+        }
+        for (int i = 0; i < i_cnt; i++) {
+            uint64_t sum = 0;
+            for (int j = 0; j < j_cnt; j++)
+                sum += ab(s, AB, i0 + i, j0 + j);
+            if ((sum - (uint64_t) row[i] - bias_row) & mask())
+                return false;
+        }
+        return true;
+    }
+};
+
+template <class T> struct mm_abft_impl<T, false> {
+    static bool supported(const mm_epilogue &e) { return !(e.flags & ~(EPILOGUE_BIAS | EPILOGUE_SCALE)); }
+
+    // Magnitudes of the float rounding of the checksums, O(MK + KN): the
+    // kernel's column sum j of tile (ib, jb) adds up cs_k B[k][j], which is
+    // at most |cs| |B[.][j]| by Cauchy-Schwarz, cs the A column sums of tile
+    // row ib; its row sum i adds up A[i][k] rs_k, at most |A[i][.]| |rs|.
+    struct bounds {
+        std::vector<double> a_norm, b_norm, cs_norm, rs_norm;
+
+        bounds(const mm_shape &s, const void *A, const void *B)
+            : a_norm(s.M, 0), b_norm(s.N, 0), cs_norm(s.tile_rows(), 0), rs_norm(s.tile_cols(), 0) {
+#pragma omp parallel for schedule(static)
+            for (int ib = 0; ib < s.tile_rows(); ib++) {
+                int i1 = std::min(s.M, (ib + 1) * TILE_DIM);
+                for (int k = 0; k < s.K; k++) {
+                    double cs = 0;
+                    for (int i = ib * TILE_DIM; i < i1; i++) {
+                        double v = s.get_a(A, i, k);
+                        cs += v;
+                        a_norm[i] += v * v;
+                    }
+                    cs_norm[ib] += cs * cs;
+                }
+            }
+#pragma omp parallel for schedule(static)
+            for (int jb = 0; jb < s.tile_cols(); jb++) {
+                int j1 = std::min(s.N, (jb + 1) * TILE_DIM);
+                for (int k = 0; k < s.K; k++) {
+                    double rs = 0;
+                    for (int j = jb * TILE_DIM; j < j1; j++) {
+                        double v = s.get_b(B, k, j);
+                        rs += v;
+                        b_norm[j] += v * v;
+                    }
+                    rs_norm[jb] += rs * rs;
+                }
+            }
+            for (auto *v : {&a_norm, &b_norm, &cs_norm, &rs_norm})
+                for (double &x : *v)
+                    x = std::sqrt(x);
+        }
+    };
+
+    static double word(uint32_t w) {
+        float f;
+        std::memcpy(&f, &w, sizeof(f));
+        return f;
+    }
+    static double bias(const mm_ref_epilogue &epi, int j) {
+        return epi.e.flags & EPILOGUE_BIAS ? word(epi.b(j)) : 0;
+    }
+    static double scale(const mm_ref_epilogue &epi, int j) {
+        return epi.e.flags & EPILOGUE_SCALE ? word(epi.s(j)) : 1;
+    }
+    // what mm_close() allows an entry, and the float rounding of the
+    // kernel's checksums of magnitude `mag`, sums of K products of sums of
+    // up to TILE_DIM elements
+    static double allowed(double hw, double tol) { return tol * std::max(1.0, (std::fabs(hw) + tol) / (1 - tol)); }
+    static double rounding(const mm_shape &s, double mag) {
+        return std::ldexp(std::sqrt((double) s.K) + std::sqrt((double) TILE_DIM), -24) * mag;
+    }
+
+    // AB_ij = s_j (S_ij + b_j)
+    static bool tile_ok(const mm_shape &s, const void *AB, const int64_t *chk, const mm_ref_epilogue &epi,
+                        const bounds &m, double tol, int t) {
+        int ib = s.tile_row(t), jb = s.tile_col(t);
+        int i0 = ib * TILE_DIM, j0 = jb * TILE_DIM;
+        int i_cnt = std::min(TILE_DIM, s.M - i0), j_cnt = std::min(TILE_DIM, s.N - j0);
+        const int64_t *col = chk + s.chk_index(t), *row = col + TILE_DIM;
+        double bias_row = 0;
+        for (int j = 0; j < j_cnt; j++) {
+            double sum = 0, bound = 0;
+            for (int i = 0; i < i_cnt; i++) {
+                double hw = s.get_ab(AB, i0 + i, j0 + j);
+                sum += hw;
+                bound += allowed(hw, tol);
+            }
+            double sc = scale(epi, j0 + j);
+            double expect = sc * (word((uint32_t) col[j]) + bias(epi, j0 + j) * i_cnt);
+            if (!(std::fabs(sum - expect) <= bound + std::fabs(sc) * rounding(s, m.cs_norm[ib] * m.b_norm[j0 + j])))
+                return false;
+            bias_row += bias(epi, j0 + j);
+        }
+        if (epi.e.flags & EPILOGUE_SCALE)
+            return true;
+        for (int i = 0; i < i_cnt; i++) {
+            double sum = 0, bound = 0;
+            for (int j = 0; j < j_cnt; j++) {
+                double hw = s.get_ab(AB, i0 + i, j0 + j);
+                sum += hw;
+                bound += allowed(hw, tol);
+            }
+            double expect = word((uint32_t) row[i]) + bias_row;
+            if (!(std::fabs(sum - expect) <= bound + rounding(s, m.rs_norm[jb] * m.a_norm[i0 + i])))
+                return false;
+        }
+        return true;
+    }
+};
+
+// Whether results finished with e can be checked by mm_abft_check().
+inline bool mm_abft_supported(const mm_epilogue &e) { return mm_abft_impl<mm_t>::supported(e); }
+
+// Checks one result AB of A * B laid out as described by shape, finished
+// with epilogue e and its per-column bias / scale words, against the tile
+// checksums chk the kernel returned with it. A and B are only read for
+// float and half. tol is the relative tolerance of their entries, as for
+// mm_close().
+inline mm_abft_result mm_abft_check(const mm_shape &shape, const void *A, const void *B, const void *AB,
+                                    const int64_t *chk, const mm_epilogue &e = mm_epilogue(),
+                                    const uint32_t *bias = nullptr, const uint32_t *scale = nullptr,
+                                    double tol = mm_t::tolerance) {
+    typedef mm_abft_impl<mm_t> impl;
+    mm_abft_result res;
+    if (!mm_abft_supported(e)) {
+        res.supported = false;
+        return res;
+    }
+    mm_ref_epilogue epi{e, bias, scale};
+    typename impl::bounds m(shape, A, B);
+    std::vector<char> bad(shape.num_tiles(), 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < shape.num_tiles(); t++)
+        bad[t] = !impl::tile_ok(shape, AB, chk, epi, m, tol, t);
+    for (int t = 0; t < shape.num_tiles(); t++)
+        if (bad[t])
+            res.tiles.push_back(t);
+    return res;
+}
+
+struct mm_abft_stats {
+    bool supported = true;
+    long detected = 0; // tiles failing after the launch, over all problems
+    long rerun = 0;    // tile launches to repair them
+    long failed = 0;   // tiles still failing at the end
+};
+
+// Checks every problem of ops, launched with abft and synced out, and
+// recomputes the tiles that failed in any of them, for all problems at
+// once, up to `retries` times while some keep failing.
+inline mm_abft_stats mm_abft_repair(mm_backend &backend, mm_operands &ops, int retries = 2,
+                                    double tol = mm_t::tolerance) {
+    mm_abft_stats stats;
+    if (!mm_abft_supported(ops.epilogue)) {
+        stats.supported = false;
+        return stats;
+    }
+    std::vector<char> bad(ops.shape.num_tiles(), 0);
+    auto check = [&] {
+        mm_trace_scope trace("abft");
+        long n = 0;
+        std::fill(bad.begin(), bad.end(), 0);
+        for (int i = 0; i < ops.size(); i++) {
+            mm_abft_result r = mm_abft_check(ops.shape, ops.A(i), ops.B(i), ops.AB(i), ops.checksums(i),
+                                             ops.epilogue, ops.bias(), ops.scale(), tol);
+            for (int t : r.tiles)
+                bad[t] = 1;
+            n += (long) r.tiles.size();
+        }
+        return n;
+    };
+    long failing = stats.detected = check();
+    for (int pass = 0; pass < retries && failing > 0; pass++) {
+        // runs of consecutive failing tiles share a launch
+        for (int t = 0; t < ops.shape.num_tiles();) {
+            if (!bad[t]) {
+                t++;
+                continue;
+            }
+            int n = 1;
+            while (t + n < ops.shape.num_tiles() && bad[t + n])
+                n++;
+            ops.launch_tiles(backend, t, n).wait();
+            stats.rerun += n;
+            t += n;
+        }
+        ops.sync_out();
+        failing = check();
+    }
+    stats.failed = failing;
+    return stats;
+}
+
+#endif
@@ -0,0 +1,440 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Execution backends for the host.
+//
+// Everything above this layer (single runs, batches, streams) allocates
+// operands and launches kernels through an mm_backend, so the same host
+// code runs either on an FPGA through XRT or on the native CPU build of
+// the kernel (mm_cpu.h) when no card is available.
+
+#ifndef MM_BACKEND_H
+#define MM_BACKEND_H
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef MM_NO_XRT
+#include "experimental/xrt_bo.h"
+#include "experimental/xrt_device.h"
+#include "experimental/xrt_kernel.h"
+#endif
+
+#include "mm_buffers.h"
+#include "mm_cpu.h"
+#include "mm_sparse.h"
+#include "mm_trace.h"
+
+// Handle of an asynchronous kernel launch. XRT runs are traced as a
+// "kernel" phase from launch until wait() returns.
+class mm_job {
+public:
+    mm_job() {}
+#ifndef MM_NO_XRT
+    explicit mm_job(const xrt::run &r)
+        : run(r), has_run(true), launched(mm_tracer::get().now()), job(mm_tracer::job()) {}
+#endif
+    explicit mm_job(const std::shared_future<void> &f) : done(f) {}
+
+    void wait() {
+#ifndef MM_NO_XRT
+        if (has_run) {
+            run.wait();
+            if (launched) {
+                mm_tracer::get().record("kernel", launched, mm_tracer::get().now(), job);
+                launched = 0;
+            }
+            return;
+        }
+#endif
+        if (done.valid())
+            done.get();
+    }
+
+private:
+#ifndef MM_NO_XRT
+    xrt::run run;
+    bool has_run = false;
+    uint64_t launched = 0;
+    int job = -1;
+#endif
+    std::shared_future<void> done;
+};
+
+class mm_backend {
+public:
+    virtual ~mm_backend() {}
+    virtual const char *name() const = 0;
+    virtual mm_buffer alloc(size_t bytes, mm_bo_mode mode) = 0;
+    // Uses the page aligned memory at p, kept alive by owner, as a buffer.
+    virtual mm_buffer import(void *p, size_t bytes, std::shared_ptr<void> owner) = 0;
+    // Starts mm on (A, B, AB) and returns without waiting. occ holds the
+    // occupancy bitmaps, only read when args.sparse is set, epi the
+    // epilogue bias and scale vectors, chk receives the tile checksums when
+    // args.abft is set.
+    virtual mm_job launch(mm_buffer &A, mm_buffer &B, mm_buffer &AB, mm_buffer &occ, mm_buffer &epi,
+                          mm_buffer &chk, const mm_args &args) = 0;
+};
+
+#ifndef MM_NO_XRT
+// Kernels built from mm_kernel.h take batch, stride and tile arguments.
+// `kernel` selects a single CU, e.g. "mm:{mm_2}", when the xclbin has
+// several.
+class mm_xrt_backend : public mm_backend {
+public:
+    mm_xrt_backend(const std::string &xclbin, unsigned index = 0, const std::string &kernel = "mm")
+        : device(index), split_a(is_gemv(kernel)) {
+        std::cout << "Open the device " << index << std::endl;
+        std::cout << "Load the xclbin " << xclbin << std::endl;
+        mm_trace_scope trace("xclbin load");
+        uuid = device.load_xclbin(xclbin);
+        krnl = xrt::kernel(device, uuid, kernel);
+    }
+
+    // Another kernel of the xclbin `loaded` already opened, e.g. mm_gemv.
+    mm_xrt_backend(const mm_xrt_backend &loaded, const std::string &kernel)
+        : device(loaded.device), uuid(loaded.uuid), krnl(device, uuid, kernel), split_a(is_gemv(kernel)) {}
+
+    const char *name() const { return "xrt"; }
+
+    mm_buffer alloc(size_t bytes, mm_bo_mode mode) { return mm_buffer(device, bytes, krnl.group_id(1), mode); }
+    mm_buffer import(void *p, size_t bytes, std::shared_ptr<void> owner) {
+        return mm_buffer(device, p, bytes, krnl.group_id(1), std::move(owner));
+    }
+
+    mm_job launch(mm_buffer &A, mm_buffer &B, mm_buffer &AB, mm_buffer &occ, mm_buffer &epi, mm_buffer &chk,
+                  const mm_args &args) {
+        if (split_a)
+            return mm_job(krnl(A.bo(), B.bo(), AB.bo(), args.M, args.K, args.N,
+                               args.batch, args.strideA, args.strideB, args.strideAB,
+                               args.tile_first, args.tile_count, args.order, occ.bo(), args.strideOcc, args.sparse,
+                               epi.bo(), args.epilogue, args.shift, args.act_lo, args.act_hi,
+                               chk.bo(), args.strideChk, args.abft, A.bo()));
+        return mm_job(krnl(A.bo(), B.bo(), AB.bo(), args.M, args.K, args.N,
+                           args.batch, args.strideA, args.strideB, args.strideAB,
+                           args.tile_first, args.tile_count, args.order, occ.bo(), args.strideOcc, args.sparse,
+                           epi.bo(), args.epilogue, args.shift, args.act_lo, args.act_hi,
+                           chk.bo(), args.strideChk, args.abft));
+    }
+
+    xrt::device device;
+    xrt::uuid uuid;
+    xrt::kernel krnl;
+
+private:
+    // mm_gemv (and its compute units mm_gemv:{...}) take A twice, see
+    // MM_TOP_SPLIT_A in mm_top.h
+    static bool is_gemv(const std::string &kernel) { return kernel.compare(0, 7, "mm_gemv") == 0; }
+
+    bool split_a;
+};
+#endif
+
+// Runs the native build of the kernel, or of mm_gemv with gemv = true.
+// Launches are serialized like runs queued on a single compute unit; each
+// one uses a thread per DATAFLOW stage.
+class mm_cpu_backend : public mm_backend {
+public:
+    explicit mm_cpu_backend(bool gemv = false) : run(gemv ? mm_cpu_gemv_run : mm_cpu_run) {}
+
+    const char *name() const { return "cpu"; }
+
+    mm_buffer alloc(size_t bytes, mm_bo_mode) { return mm_buffer::host(bytes); }
+    mm_buffer import(void *p, size_t bytes, std::shared_ptr<void> owner) {
+        return mm_buffer::wrap(p, bytes, std::move(owner));
+    }
+
+    mm_job launch(mm_buffer &A, mm_buffer &B, mm_buffer &AB, mm_buffer &occ, mm_buffer &epi, mm_buffer &chk,
+                  const mm_args &args) {
+        void *a = A.data<void>(), *b = B.data<void>(), *ab = AB.data<void>();
+        void *o = occ.data<void>(), *e = epi.data<void>(), *c = chk.data<void>();
+        std::mutex *cu = &busy;
+        int job = mm_tracer::job();
+        void (*kernel)(void *, void *, void *, void *, void *, void *, const mm_args &) = run;
+        return mm_job(std::async(std::launch::async, [=] {
+            std::lock_guard<std::mutex> lock(*cu);
+            mm_trace_job in_job(job);
+            mm_trace_scope trace("kernel");
+            kernel(a, b, ab, o, e, c, args);
+        }).share());
+    }
+
+private:
+    void (*run)(void *, void *, void *, void *, void *, void *, const mm_args &);
+    std::mutex busy;
+};
+
+// Sends launches with N <= max_n to the skinny kernel (mm_gemv) and all
+// others to the general one, which also takes every launch asking for
+// checksums. Buffers come from the general backend, so on a card both
+// kernels have to be linked to the same memory banks.
+class mm_dispatch_backend : public mm_backend {
+public:
+    mm_dispatch_backend(std::unique_ptr<mm_backend> general, std::unique_ptr<mm_backend> skinny,
+                        int max_n = MM_GEMV_N)
+        : general(std::move(general)), skinny(std::move(skinny)), max_n(max_n) {}
+
+    const char *name() const { return general->name(); }
+
+    mm_buffer alloc(size_t bytes, mm_bo_mode mode) { return general->alloc(bytes, mode); }
+    mm_buffer import(void *p, size_t bytes, std::shared_ptr<void> owner) {
+        return general->import(p, bytes, std::move(owner));
+    }
+
+    mm_job launch(mm_buffer &A, mm_buffer &B, mm_buffer &AB, mm_buffer &occ, mm_buffer &epi, mm_buffer &chk,
+                  const mm_args &args) {
+        mm_backend &to = args.N <= max_n && !args.abft ? *skinny : *general;
+        return to.launch(A, B, AB, occ, epi, chk, args);
+    }
+
+private:
+    std::unique_ptr<mm_backend> general, skinny;
+    int max_n;
+};
+
+// A B operand (a weight matrix) kept resident on the device across
+// launches. It is registered once: packed into the kernel layout, synced
+// and scanned for empty tiles. mm_operands built on it share its buffer,
+// so later launches only move A and AB, and every problem of a batch reads
+// the same B (strideB = 0). Must outlive the operands using it.
+class mm_weights {
+public:
+    mm_weights(mm_backend &backend, int K, int N, mm_bo_mode mode = BO_DEVICE)
+        : shape{TILE_DIM, K, N, A_COL_MAJOR}, b(backend.alloc(shape.b_bytes(), mode)),
+          occ_b(shape.occ_words() - shape.occ_b_word()) {}
+
+    int K() const { return shape.K; }
+    int N() const { return shape.N; }
+
+    // Host view in the kernel layout, rows shape.ldb() elements apart
+    mm_in_t *data() const { return b.data<mm_in_t>(); }
+
+    // Packs the K x N row-major matrix src, rows ld elements apart, into
+    // the kernel layout. Either this or writing data() directly, then
+    // sync_in().
+    void load(const void *src, long ld) {
+        mm_trace_scope trace("layout");
+        if (mm_t::in_bits % 8 == 0) {
+            size_t row = (size_t) shape.N * mm_t::in_bits / 8, ld_bytes = (size_t) ld * mm_t::in_bits / 8;
+            for (int k = 0; k < shape.K; k++)
+                std::memcpy(b.data<char>() + shape.b_index(k, 0) * mm_t::in_bits / 8,
+                            (const char *) src + k * ld_bytes, row);
+        } else {
+            for (int k = 0; k < shape.K; k++)
+                for (int j = 0; j < shape.N; j++)
+                    mm_elem<4>::set_raw(data(), shape.b_index(k, j), mm_elem<4>::get_raw(src, (size_t) k * ld + j));
+        }
+    }
+
+    // Scans the tiles and moves the matrix to the device, once. Returns the
+    // number of nonzero tiles.
+    long sync_in() {
+        {
+            mm_trace_scope trace("occupancy");
+            std::fill(occ_b.begin(), occ_b.end(), 0);
+            b_nonzero = mm_occupancy_b(shape, data(), occ_b.data());
+        }
+        mm_trace_scope trace("sync in");
+        b.to_device(shape.b_bytes());
+        return b_nonzero;
+    }
+
+    // The B half of the occupancy bitmaps (mm_shape.h)
+    const uint32_t *occupancy() const { return occ_b.data(); }
+    long nonzero_tiles() const { return b_nonzero; }
+
+    mm_buffer &buffer() { return b; }
+
+private:
+    mm_shape shape;
+    mm_buffer b;
+    std::vector<uint32_t> occ_b;
+    long b_nonzero = 0;
+};
+
+// A, B and AB buffers for count problems of one shape, packed back to back,
+// their tile occupancy bitmaps for the block-sparse mode, their tile
+// checksums and the epilogue vectors shared by all of them. With resident
+// weights B is theirs and shared by all problems. The bitmaps and checksums
+// are allocated by set_sparse() and set_abft() when they are first turned
+// on; until then occ and chk are one beat placeholders the kernel never
+// touches.
+class mm_operands {
+public:
+    mm_operands() : count(0) {}
+
+    mm_operands(mm_backend &backend, const mm_shape &shape, int count = 1, mm_bo_mode mode = BO_DEVICE)
+        : shape(shape), count(count), backend(&backend), mode(mode),
+          a(backend.alloc(count * shape.a_bytes(), mode)),
+          b(backend.alloc(count * shape.b_bytes(), mode)),
+          ab(backend.alloc(count * shape.ab_bytes(), mode)),
+          occ(backend.alloc(MM_PORT_BYTES, mode)),
+          epi(backend.alloc(shape.epi_bytes(), mode)),
+          chk(backend.alloc(MM_PORT_BYTES, mode)) {}
+
+    mm_operands(mm_backend &backend, const mm_shape &shape, mm_weights &w, int count = 1,
+                mm_bo_mode mode = BO_DEVICE)
+        : shape(shape), count(count), weights(&w), backend(&backend), mode(mode),
+          a(backend.alloc(count * shape.a_bytes(), mode)),
+          b(w.buffer()),
+          ab(backend.alloc(count * shape.ab_bytes(), mode)),
+          occ(backend.alloc(MM_PORT_BYTES, mode)),
+          epi(backend.alloc(shape.epi_bytes(), mode)),
+          chk(backend.alloc(MM_PORT_BYTES, mode)) {
+        if (shape.K != w.K() || shape.N != w.N())
+            throw std::invalid_argument("mm_operands: weights do not match the shape");
+    }
+
+    // One problem on A, B and AB buffers the caller provides, e.g. imported
+    // from mapped matrix files (mm_tiled.h).
+    mm_operands(mm_backend &backend, const mm_shape &shape, mm_buffer a_buf, mm_buffer b_buf, mm_buffer ab_buf,
+                mm_bo_mode mode = BO_DEVICE)
+        : shape(shape), count(1), backend(&backend), mode(mode),
+          a(std::move(a_buf)), b(std::move(b_buf)), ab(std::move(ab_buf)),
+          occ(backend.alloc(MM_PORT_BYTES, mode)),
+          epi(backend.alloc(shape.epi_bytes(), mode)),
+          chk(backend.alloc(MM_PORT_BYTES, mode)) {
+        if (a.bytes() < shape.a_bytes() || b.bytes() < shape.b_bytes() || ab.bytes() < shape.ab_bytes())
+            throw std::invalid_argument("mm_operands: buffers do not hold the shape");
+    }
+
+    int size() const { return count; }
+
+    // Host views of problem i, laid out as described by shape
+    mm_in_t *A(int i = 0) const { return (mm_in_t *) (a.data<char>() + i * shape.a_bytes()); }
+    mm_in_t *B(int i = 0) const { return (mm_in_t *) (b.data<char>() + (weights ? 0 : i * shape.b_bytes())); }
+    mm_out_t *AB(int i = 0) const { return (mm_out_t *) (ab.data<char>() + i * shape.ab_bytes()); }
+    uint32_t *occupancy(int i = 0) const { return occ.data<uint32_t>() + (size_t) i * shape.occ_words(); }
+    // Tile checksums of launches with abft set, see mm_shape::chk_index()
+    int64_t *checksums(int i = 0) const { return chk.data<int64_t>() + (size_t) i * shape.chk_words(); }
+    // Per-column epilogue words, see mm_epilogue
+    uint32_t *bias() const { return epi.data<uint32_t>(); }
+    uint32_t *scale() const { return epi.data<uint32_t>() + shape.epi_ld(); }
+
+    // Finishes every result with e; bias and scale hold N words each and
+    // may be null when e does not use them. Call before sync_in().
+    void set_epilogue(const mm_epilogue &e, const uint32_t *bias_words = nullptr,
+                      const uint32_t *scale_words = nullptr) {
+        epilogue = e;
+        if (bias_words)
+            std::copy(bias_words, bias_words + shape.N, bias());
+        if (scale_words)
+            std::copy(scale_words, scale_words + shape.N, scale());
+    }
+
+    // Treats the operands selected by mode as block sparse: scans every
+    // problem for empty tiles, which later launches skip. Call once A and B
+    // hold their final values, before sync_in(). Returns the totals over
+    // all problems.
+    mm_occupancy_stats set_sparse(mm_sparse_t mode) {
+        sparse = mode;
+        mm_occupancy_stats total = {0, 0, 0, 0, 0, 0};
+        if (mode == BLOCK_DENSE)
+            return total;
+        reserve(occ, count * shape.occ_bytes());
+        mm_trace_scope trace("occupancy");
+        for (int i = 0; i < count; i++) {
+            if (!weights) {
+                total.add(mm_occupancy(shape, A(i), B(i), occupancy(i), mode));
+                continue;
+            }
+            // the B half comes from the registered weights
+            uint32_t *o = occupancy(i);
+            std::memset(o, 0, shape.occ_bytes());
+            long a_nonzero = mm_occupancy_a(shape, A(i), o);
+            std::copy(weights->occupancy(), weights->occupancy() + shape.occ_words() - shape.occ_b_word(),
+                      o + shape.occ_b_word());
+            total.add(mm_occupancy_count(shape, o, mode, a_nonzero, weights->nonzero_tiles()));
+        }
+        return total;
+    }
+
+    // Tile checksums with every launch, see mm_abft.h. Call before
+    // launching.
+    void set_abft(bool on) {
+        abft = on;
+        if (on)
+            reserve(chk, count * shape.chk_bytes());
+    }
+
+    // Kernel arguments for all count problems in one launch
+    mm_args args() const {
+        mm_args r = {shape.M, shape.K, shape.N, count,
+                     (int) (shape.a_bytes() / MM_PORT_BYTES), weights ? 0 : (int) (shape.b_bytes() / MM_PORT_BYTES),
+                     (int) (shape.ab_bytes() / MM_PORT_BYTES), 0, shape.num_tiles(), order,
+                     shape.occ_words(), sparse,
+                     epilogue.flags, epilogue.shift, epilogue.act_lo, epilogue.act_hi,
+                     (int) (shape.chk_bytes() / MM_PORT_BYTES), abft};
+        return r;
+    }
+
+    mm_job launch(mm_backend &backend) { return backend.launch(a, b, ab, occ, epi, chk, args()); }
+
+    // Recomputes output tiles [first, first + n), numbered in row order, of
+    // every problem, e.g. those whose checksums failed.
+    mm_job launch_tiles(mm_backend &backend, int first, int n) {
+        mm_args r = args();
+        r.order = TILE_ROWS;
+        r.tile_first = first;
+        r.tile_count = n;
+        return backend.launch(a, b, ab, occ, epi, chk, r);
+    }
+
+    void sync_in() {
+        mm_trace_scope trace("sync in");
+        a.to_device(count * shape.a_bytes());
+        if (!weights)
+            b.to_device(count * shape.b_bytes());
+        if (sparse)
+            occ.to_device(count * shape.occ_bytes());
+        if (epilogue.flags & (EPILOGUE_BIAS | EPILOGUE_SCALE))
+            epi.to_device(shape.epi_bytes());
+    }
+    void sync_out() {
+        mm_trace_scope trace("sync out");
+        ab.from_device(count * shape.ab_bytes());
+        if (abft)
+            chk.from_device(count * shape.chk_bytes());
+    }
+
+    mm_shape shape;
+    int count;
+    tile_order_t order = TILE_ROWS;
+    mm_sparse_t sparse = BLOCK_DENSE;
+    mm_epilogue epilogue;
+    // the kernel also stores tile checksums, see set_abft()
+    bool abft = false;
+    mm_weights *weights = nullptr;
+    mm_backend *backend = nullptr;
+    mm_bo_mode mode = BO_DEVICE;
+    mm_buffer a, b, ab, occ, epi, chk;
+
+private:
+    // Replaces a placeholder by a buffer of the full size.
+    void reserve(mm_buffer &buf, size_t bytes) {
+        if (buf.bytes() < bytes)
+            buf = backend->alloc(bytes, mode);
+    }
+};
+
+#endif
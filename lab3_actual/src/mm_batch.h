@@ -0,0 +1,159 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Batched launches of the mm_v4 kernel.
+//
+// Many independent problems of one shape are packed back to back into a
+// few large buffer objects. Each group of buffers is processed by a single
+// kernel invocation that walks the batch with fixed strides, so the launch
+// and completion overhead is paid per group instead of per problem.
+
+#ifndef MM_BATCH_H
+#define MM_BATCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "mm_abft.h"
+#include "mm_backend.h"
+
+class mm_batch {
+public:
+    // Groups are capped at max_bo_bytes per buffer object, the device
+    // allocator and a single sync both get slow for very large BOs.
+    mm_batch(mm_backend &backend, const mm_shape &shape, int count,
+             mm_bo_mode mode = BO_DEVICE, size_t max_bo_bytes = size_t(1) << 30)
+        : backend(backend), shape(shape), count(count) {
+        init(nullptr, mode, max_bo_bytes);
+    }
+
+    // Every problem multiplies by the resident weights w, only A is synced.
+    mm_batch(mm_backend &backend, const mm_shape &shape, mm_weights &w, int count,
+             mm_bo_mode mode = BO_DEVICE, size_t max_bo_bytes = size_t(1) << 30)
+        : backend(backend), shape(shape), count(count) {
+        init(&w, mode, max_bo_bytes);
+    }
+
+    int size() const { return count; }
+
+    void set_order(tile_order_t order) {
+        for (auto &g : groups)
+            g.order = order;
+    }
+    int num_groups() const { return (int) groups.size(); }
+
+    // Epilogue of every problem, see mm_operands::set_epilogue().
+    void set_epilogue(const mm_epilogue &e, const uint32_t *bias = nullptr, const uint32_t *scale = nullptr) {
+        for (auto &g : groups)
+            g.set_epilogue(e, bias, scale);
+    }
+
+    // Block-sparse operands, see mm_operands::set_sparse(). Call once the
+    // inputs are final, before sync_in().
+    mm_occupancy_stats set_sparse(mm_sparse_t mode) {
+        mm_occupancy_stats total = {0, 0, 0, 0, 0, 0};
+        for (auto &g : groups)
+            total.add(g.set_sparse(mode));
+        return total;
+    }
+
+    // Tile checksums with every launch, see mm_abft.h.
+    void set_abft(bool on) {
+        for (auto &g : groups)
+            g.set_abft(on);
+    }
+
+    // Checks every problem against its checksums and recomputes the failing
+    // tiles, group by group, see mm_abft_repair(). Call after sync_out().
+    mm_abft_stats abft_repair(int retries = 2, double tol = mm_t::tolerance) {
+        mm_abft_stats total;
+        for (int g = 0; g < num_groups(); g++) {
+            mm_trace_job in_job(g);
+            mm_abft_stats s = mm_abft_repair(backend, groups[g], retries, tol);
+            total.supported = s.supported;
+            total.detected += s.detected;
+            total.rerun += s.rerun;
+            total.failed += s.failed;
+        }
+        return total;
+    }
+
+    // Host views of problem i, laid out as described by shape.
+    mm_in_t *A(int i) { return at(i).A(i % per_group); }
+    mm_in_t *B(int i) { return at(i).B(i % per_group); }
+    mm_out_t *AB(int i) { return at(i).AB(i % per_group); }
+
+    // Trace events of group g are attributed to job g.
+    void sync_in() {
+        for (int g = 0; g < num_groups(); g++) {
+            mm_trace_job in_job(g);
+            groups[g].sync_in();
+        }
+    }
+
+    // Launches every group, then waits for all of them. Returns the time
+    // from the first launch to the last completion in seconds.
+    double run() {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<mm_job> jobs;
+        for (int g = 0; g < num_groups(); g++) {
+            mm_trace_job in_job(g);
+            jobs.push_back(groups[g].launch(backend));
+        }
+        for (auto &j : jobs)
+            j.wait();
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    void sync_out() {
+        for (int g = 0; g < num_groups(); g++) {
+            mm_trace_job in_job(g);
+            groups[g].sync_out();
+        }
+    }
+
+private:
+    void init(mm_weights *w, mm_bo_mode mode, size_t max_bo_bytes) {
+        // the bitmaps and checksums a group allocates for set_sparse() and
+        // set_abft() are capped as well
+        size_t largest = std::max({shape.a_bytes(), w ? 0 : shape.b_bytes(), shape.ab_bytes(), shape.occ_bytes(),
+                                   shape.chk_bytes()});
+        if (count <= 0 || largest > max_bo_bytes)
+            throw std::invalid_argument("mm_batch: bad batch size or problem too large for one buffer");
+        per_group = (int) std::min<size_t>(count, max_bo_bytes / largest);
+
+        for (int first = 0; first < count; first += per_group) {
+            int n = std::min(per_group, count - first);
+            if (w)
+                groups.emplace_back(backend, shape, *w, n, mode);
+            else
+                groups.emplace_back(backend, shape, n, mode);
+        }
+    }
+
+    mm_operands &at(int i) { return groups[i / per_group]; }
+
+    mm_backend &backend;
+    mm_shape shape;
+    int count;
+    int per_group;
+    std::vector<mm_operands> groups;
+};
+
+#endif
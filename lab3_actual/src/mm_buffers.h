@@ -0,0 +1,157 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Device-mappable host buffers.
+//
+// Producers write operands straight into the host mapping of a buffer
+// object and consumers read results from it in place, so no intermediate
+// std::vector copies are made on the way to or from the device.
+//
+// The backing memory is selected per buffer:
+//   BO_DEVICE    regular BO in device DDR, XRT keeps a host shadow copy
+//   BO_HOST_ONLY BO in host memory the kernel accesses over PCIe (needs a
+//                platform with host memory enabled), sync only flushes caches
+//   BO_USER_PTR  page aligned memory owned by us, imported as a BO
+//
+// Memory owned elsewhere, such as a mapped matrix file (mm_tiled.h), is
+// imported as a user pointer BO too, kept alive by the owner handle.
+//
+// Backends that run on the host (the CPU backend) use plain page aligned
+// memory with no BO behind it, and syncing is a no-op. Building with
+// MM_NO_XRT drops every XRT dependency.
+
+#ifndef MM_BUFFERS_H
+#define MM_BUFFERS_H
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+
+#ifndef MM_NO_XRT
+#include "experimental/xrt_bo.h"
+#include "experimental/xrt_device.h"
+#endif
+
+#include "mm_shape.h"
+#include "mm_trace.h"
+
+enum mm_bo_mode { BO_DEVICE, BO_HOST_ONLY, BO_USER_PTR };
+
+inline bool parse_bo_mode(const std::string &s, mm_bo_mode &mode) {
+    if (s == "device")
+        mode = BO_DEVICE;
+    else if (s == "host")
+        mode = BO_HOST_ONLY;
+    else if (s == "user")
+        mode = BO_USER_PTR;
+    else
+        return false;
+    return true;
+}
+
+class mm_buffer {
+public:
+    mm_buffer() : ptr(nullptr), size(0) {}
+
+    // Page aligned host memory without a buffer object.
+    static mm_buffer host(size_t bytes) {
+        mm_trace_scope trace("bo alloc");
+        mm_buffer b;
+        b.size = bytes;
+        b.ptr = b.alloc_user(bytes);
+        return b;
+    }
+
+    // Page aligned memory kept alive by owner, without a buffer object.
+    static mm_buffer wrap(void *p, size_t bytes, std::shared_ptr<void> owner) {
+        mm_buffer b;
+        b.size = bytes;
+        b.ptr = p;
+        b.user = std::move(owner);
+        return b;
+    }
+
+#ifndef MM_NO_XRT
+    // Page aligned memory kept alive by owner, imported as a BO.
+    mm_buffer(xrt::device &device, void *p, size_t bytes, int group, std::shared_ptr<void> owner)
+        : user(std::move(owner)), size(bytes) {
+        mm_trace_scope trace_alloc("bo alloc");
+        buf = xrt::bo(device, p, bytes, group);
+        has_bo = true;
+        ptr = p;
+    }
+
+    mm_buffer(xrt::device &device, size_t bytes, int group, mm_bo_mode mode = BO_DEVICE) : size(bytes) {
+        mm_trace_scope trace_alloc("bo alloc");
+        if (mode == BO_USER_PTR) {
+            buf = xrt::bo(device, alloc_user(bytes), bytes, group);
+        } else if (mode == BO_HOST_ONLY) {
+            buf = xrt::bo(device, bytes, xrt::bo::flags::host_only, group);
+        } else {
+            buf = xrt::bo(device, bytes, group);
+        }
+        has_bo = true;
+        mm_trace_scope trace_map("map");
+        ptr = buf.map<void *>();
+    }
+
+    xrt::bo &bo() { return buf; }
+#endif
+
+    template <typename T = void> T *data() const { return (T *) ptr; }
+    size_t bytes() const { return size; }
+
+    void to_device(size_t len, size_t offset = 0) {
+#ifndef MM_NO_XRT
+        if (has_bo)
+            buf.sync(XCL_BO_SYNC_BO_TO_DEVICE, len, offset);
+#endif
+        (void) len;
+        (void) offset;
+    }
+    void from_device(size_t len, size_t offset = 0) {
+#ifndef MM_NO_XRT
+        if (has_bo)
+            buf.sync(XCL_BO_SYNC_BO_FROM_DEVICE, len, offset);
+#endif
+        (void) len;
+        (void) offset;
+    }
+    void to_device() { to_device(size); }
+    void from_device() { from_device(size); }
+
+private:
+    void *alloc_user(size_t bytes) {
+        size_t rounded = (bytes + 4095) & ~size_t(4095);
+        void *p = std::aligned_alloc(4096, rounded ? rounded : 4096);
+        if (!p)
+            throw std::bad_alloc();
+        user.reset(p, std::free);
+        return p;
+    }
+
+    // declared first so the imported memory outlives the BO
+    std::shared_ptr<void> user;
+#ifndef MM_NO_XRT
+    xrt::bo buf;
+    bool has_bo = false;
+#endif
+    void *ptr;
+    size_t size;
+};
+
+#endif
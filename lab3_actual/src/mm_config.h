@@ -0,0 +1,79 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Element type flags, shared by the kernels (mm_elem.h) and the host
+// (mm_types.h) so both sides derive the same types from the same -D flags.
+//
+//   (default)      integers: MM_IN_BITS (16) wide A and B, MM_ACC_BITS (16)
+//                  wide accumulator, MM_OUT_BITS (= MM_ACC_BITS) wide AB
+//   -DMM_FIXED_W=W ap_fixed<W, MM_FIXED_I> A, B and AB (MM_FIXED_I defaults
+//                  to W / 2), an MM_ACC_BITS (2W + 16) wide accumulator that
+//                  keeps every fraction bit of the products
+//   -DMM_FLOAT     float A, B, accumulator and AB
+//   -DMM_HALF      half A, B and AB, float accumulator
+//
+// MM_FADD_LAT is the latency of the kernels' pipelined float adder.
+//
+// MM_GEMV_N (16) is the number of B columns the skinny kernel (mm_gemv.cpp)
+// multiplies per A element and cycle; the host sends launches with
+// N <= MM_GEMV_N to it when it is available.
+//
+// MM_TILE (256) is the output tile edge and MM_PORT_BYTES (64) the width of
+// a gmem beat. The host numbers tiles and pads row strides with them, so
+// size-specialized kernels (mm_kernel.h) set them for both sides.
+
+#ifndef MM_CONFIG_H
+#define MM_CONFIG_H
+
+#if defined(MM_FLOAT) + defined(MM_HALF) + defined(MM_FIXED_W) > 1
+#error "pick one of MM_FLOAT, MM_HALF and MM_FIXED_W"
+#endif
+
+#ifdef MM_FIXED_W
+#ifndef MM_FIXED_I
+#define MM_FIXED_I (MM_FIXED_W / 2)
+#endif
+#ifndef MM_ACC_BITS
+#define MM_ACC_BITS (2 * MM_FIXED_W + 16)
+#endif
+#endif
+
+#ifndef MM_IN_BITS
+#define MM_IN_BITS 16
+#endif
+#ifndef MM_ACC_BITS
+#define MM_ACC_BITS 16
+#endif
+#ifndef MM_OUT_BITS
+#define MM_OUT_BITS MM_ACC_BITS
+#endif
+
+#ifndef MM_TILE
+#define MM_TILE 256
+#endif
+#ifndef MM_PORT_BYTES
+#define MM_PORT_BYTES 64
+#endif
+
+#ifndef MM_FADD_LAT
+#define MM_FADD_LAT 8
+#endif
+
+#ifndef MM_GEMV_N
+#define MM_GEMV_N 16
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Native build of the mm_v4 kernel (or another mm_kernel.h design point, see
+// mm_cpu.cpp) and of the skinny mm_gemv kernel, run by the CPU backend.
+//
+// mm_cpu.cpp and mm_cpu_gemv.cpp compile the unmodified kernel sources
+// against the stand-in HLS headers in native/ (-DMM_NATIVE -Inative), so
+// the DATAFLOW stages run as concurrent threads connected by bounded FIFOs.
+// Programs using the CPU backend link both.
+
+#ifndef MM_CPU_H
+#define MM_CPU_H
+
+#include "mm_shape.h"
+
+// Same contract as the kernel's mm top function, operands packed as in
+// mm_types.h. Blocks until done.
+void mm_cpu_run(void *A, void *B, void *AB, void *occ, void *epi, void *chk, const mm_args &args);
+
+// The same for the skinny kernel mm_gemv (mm_cpu_gemv.cpp).
+void mm_cpu_gemv_run(void *A, void *B, void *AB, void *occ, void *epi, void *chk, const mm_args &args);
+
+#endif
@@ -0,0 +1,32 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Build with -DMM_NATIVE -Inative, see mm_cpu.h.
+#ifndef MM_NATIVE
+#error "mm_cpu_gemv.cpp must be built with -DMM_NATIVE -Inative"
+#endif
+
+#include "mm_gemv.cpp"
+
+#include "mm_cpu.h"
+
+void mm_cpu_gemv_run(void *A, void *B, void *AB, void *occ, void *epi, void *chk, const mm_args &args) {
+    mm_gemv((block_t *) A, (block_t *) B, (block_t *) AB, args.M, args.K, args.N,
+            args.batch, args.strideA, args.strideB, args.strideAB, args.tile_first, args.tile_count, args.order,
+            (unsigned *) occ, args.strideOcc, args.sparse,
+            (block_t *) epi, args.epilogue, args.shift, args.act_lo, args.act_hi,
+            (block_t *) chk, args.strideChk, args.abft, (block_t *) A);
+}
@@ -0,0 +1,220 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Element types of the kernels, selected by the flags in mm_config.h.
+//
+// Each family gives the types of A/B (in_t), of the accumulator (acc_t)
+// and of AB (out_t), their widths, the product that is accumulated, the
+// conversion of a finished sum to out_t and the mapping of elements to
+// the bits of a beat. Element e of a beat occupies bits [e * W, (e + 1) * W).
+//
+// ACC_LAT is the number of cycles an accumulator needs before it can take
+// the next addition: 1 for integer and fixed-point adders, MM_FADD_LAT for
+// a pipelined float adder. comp never updates the same accumulator twice
+// within ACC_LAT cycles, which is what keeps it at II=1 for float.
+//
+// epilogue() is the fused output stage of writeAB (see mm_kernel.h): a
+// per-column bias and scale, then an activation, applied to a finished sum
+// on its way to out_t. bias and scale arrive as 32 bit words, int32 for
+// the exact families and float for the others. The exact families add the
+// bias to the raw accumulator and requantize by scale * 2^-shift, rounding
+// to nearest and saturating to out_t; float and half ignore shift. ReLU and
+// clamp (act_lo <= x <= act_hi) act on the output value. With no flags
+// set epilogue() is to_out().
+//
+// acc_word() is the 64 bit checksum word of an accumulator value (ABFT, see
+// abft_sums in mm_kernel.h): the raw sum sign extended for the exact
+// families, the float bits for the others.
+
+#ifndef MM_ELEM_H
+#define MM_ELEM_H
+
+#include "ap_int.h"
+#include "mm_config.h"
+#if defined(MM_FIXED_W)
+#include "ap_fixed.h"
+#elif defined(MM_HALF)
+#include "hls_half.h"
+#endif
+
+const int EPI_BIAS = 1;
+const int EPI_SCALE = 2;
+const int EPI_RELU = 4;
+const int EPI_CLAMP = 8;
+
+// Bias and requantizing scale of the exact families, on raw sums.
+static long long epi_scale(long long v, ap_uint<32> bias, ap_uint<32> scale, int flags, int shift) {
+	ap_int<32> b = bias, m = scale;
+	if (flags & EPI_BIAS)
+		v += (long long) b;
+	if (flags & EPI_SCALE) {
+		v *= (long long) m;
+		if (shift > 0)
+			v = (v + (1LL << (shift - 1))) >> shift;
+	}
+	return v;
+}
+
+// Saturation (requantization only) and activation of a raw result of an
+// OUT_W bit output.
+template <int OUT_W>
+static long long epi_act(long long v, int flags, int act_lo, int act_hi) {
+	const long long hi = (1LL << (OUT_W - 1)) - 1, lo = -hi - 1;
+	if (flags & EPI_SCALE)
+		v = v < lo ? lo : v > hi ? hi : v;
+	if ((flags & EPI_RELU) && v < 0)
+		v = 0;
+	if (flags & EPI_CLAMP)
+		v = v < act_lo ? act_lo : v > act_hi ? act_hi : v;
+	return v;
+}
+
+// The float epilogue, shared by float and half.
+static float epi_float(float v, ap_uint<32> bias, ap_uint<32> scale, int flags, int act_lo, int act_hi) {
+	union { unsigned u; float f; } b, m;
+	b.u = (unsigned) bias;
+	m.u = (unsigned) scale;
+	if (flags & EPI_BIAS)
+		v += b.f;
+	if (flags & EPI_SCALE)
+		v *= m.f;
+	if ((flags & EPI_RELU) && v < 0)
+		v = 0;
+	if (flags & EPI_CLAMP)
+		v = v < act_lo ? (float) act_lo : v > act_hi ? (float) act_hi : v;
+	return v;
+}
+
+template <int IN_W, int ACC_W, int OUT_W>
+struct int_elems {
+	typedef ap_int<IN_W> in_t;
+	typedef ap_int<ACC_W> acc_t;
+	typedef ap_int<OUT_W> out_t;
+	static const int IN_WIDTH_b = IN_W;
+	static const int OUT_WIDTH_b = OUT_W;
+	static const int ACC_LAT = 1;
+
+	static acc_t mul(in_t a, in_t b) { return a * b; }
+	// sums wrap at ACC_W bits and are truncated to OUT_W
+	static out_t to_out(acc_t x) { return x; }
+	static out_t epilogue(acc_t x, ap_uint<32> bias, ap_uint<32> scale, int flags, int shift, int act_lo, int act_hi) {
+		long long v = epi_scale((long long) x, bias, scale, flags, shift);
+		return (out_t) epi_act<OUT_W>(v, flags, act_lo, act_hi);
+	}
+	static in_t in_from_bits(ap_uint<IN_W> b) { return b; }
+	static ap_uint<OUT_W> out_bits(out_t x) { return x; }
+	static ap_uint<64> acc_word(acc_t x) { return (ap_int<64>) x; }
+};
+
+#ifdef MM_FIXED_W
+// The accumulator has the 2 (W - I) fraction bits of a full product, so the
+// only rounding is the AP_TRN / AP_WRAP conversion of the sum to ap_fixed<W, I>.
+template <int W, int I, int ACC_W>
+struct fixed_elems {
+	typedef ap_fixed<W, I> in_t;
+	typedef ap_fixed<ACC_W, ACC_W - 2 * (W - I)> acc_t;
+	typedef ap_fixed<W, I> out_t;
+	static const int IN_WIDTH_b = W;
+	static const int OUT_WIDTH_b = W;
+	static const int ACC_LAT = 1;
+
+	static acc_t mul(in_t a, in_t b) { return a * b; }
+	static out_t to_out(acc_t x) { return x; }
+	// on the raw bits: the sum has 2 (W - I) fraction bits, the output W - I
+	static out_t epilogue(acc_t x, ap_uint<32> bias, ap_uint<32> scale, int flags, int shift, int act_lo, int act_hi) {
+		ap_int<ACC_W> r;
+		r.range(ACC_W - 1, 0) = x.range(ACC_W - 1, 0);
+		long long v = epi_scale((long long) r, bias, scale, flags, shift) >> (W - I);
+		out_t o;
+		o.range(W - 1, 0) = epi_act<W>(v, flags, act_lo, act_hi);
+		return o;
+	}
+	static in_t in_from_bits(ap_uint<W> b) {
+		in_t x;
+		x.range(W - 1, 0) = b;
+		return x;
+	}
+	static ap_uint<W> out_bits(out_t x) { return x.range(W - 1, 0); }
+	static ap_uint<64> acc_word(acc_t x) {
+		ap_int<ACC_W> r;
+		r.range(ACC_W - 1, 0) = x.range(ACC_W - 1, 0);
+		return (ap_int<64>) r;
+	}
+};
+#endif
+
+struct float_elems {
+	typedef float in_t;
+	typedef float acc_t;
+	typedef float out_t;
+	static const int IN_WIDTH_b = 32;
+	static const int OUT_WIDTH_b = 32;
+	static const int ACC_LAT = MM_FADD_LAT;
+
+	static acc_t mul(in_t a, in_t b) { return a * b; }
+	static out_t to_out(acc_t x) { return x; }
+	static out_t epilogue(acc_t x, ap_uint<32> bias, ap_uint<32> scale, int flags, int, int act_lo, int act_hi) {
+		return epi_float(x, bias, scale, flags, act_lo, act_hi);
+	}
+	static in_t in_from_bits(ap_uint<32> b) {
+		union { unsigned u; float f; } c;
+		c.u = (unsigned) b;
+		return c.f;
+	}
+	static ap_uint<32> out_bits(out_t x) {
+		union { unsigned u; float f; } c;
+		c.f = x;
+		return c.u;
+	}
+	static ap_uint<64> acc_word(acc_t x) { return out_bits(x); }
+};
+
+#ifdef MM_HALF
+// Products are formed in float, a half multiplier would round every one.
+struct half_elems {
+	typedef half in_t;
+	typedef float acc_t;
+	typedef half out_t;
+	static const int IN_WIDTH_b = 16;
+	static const int OUT_WIDTH_b = 16;
+	static const int ACC_LAT = MM_FADD_LAT;
+
+	static acc_t mul(in_t a, in_t b) { return (float) a * (float) b; }
+	static out_t to_out(acc_t x) { return (half) x; }
+	static out_t epilogue(acc_t x, ap_uint<32> bias, ap_uint<32> scale, int flags, int, int act_lo, int act_hi) {
+		return (half) epi_float(x, bias, scale, flags, act_lo, act_hi);
+	}
+	static in_t in_from_bits(ap_uint<16> b) {
+		half x;
+		x.set_bits(b);
+		return x;
+	}
+	static ap_uint<16> out_bits(out_t x) { return x.get_bits(); }
+	static ap_uint<64> acc_word(acc_t x) { return float_elems::out_bits(x); }
+};
+#endif
+
+#if defined(MM_FLOAT)
+typedef float_elems mm_elems;
+#elif defined(MM_HALF)
+typedef half_elems mm_elems;
+#elif defined(MM_FIXED_W)
+typedef fixed_elems<MM_FIXED_W, MM_FIXED_I, MM_ACC_BITS> mm_elems;
+#else
+typedef int_elems<MM_IN_BITS, MM_ACC_BITS, MM_OUT_BITS> mm_elems;
+#endif
+
+#endif
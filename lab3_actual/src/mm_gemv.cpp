@@ -0,0 +1,62 @@
+/**********
+Copyright (c) 2019, Xilinx, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software
+without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********/
+
+
+// mm_gemv: the skinny kernel for matrix-vector and narrow-N products. Same
+// interface as mm, but the top function is mm_gemv so it can share an
+// xclbin with an mm design point; the host sends it launches with
+// N <= MM_GEMV_N (mm_backend.h). A streams once per column chunk at a full
+// beat per cycle against on-chip B columns, see gemv_comp in mm_kernel.h.
+// The even and odd At rows come through gmem0 and gmem3, so the host passes
+// A again as the last argument.
+
+#include "mm_kernel.h"
+
+// Rows of the on-chip B chunk. The chunk is only CHUNK columns wide, so it
+// holds K up to 8192 in the memory of one mm_v4 A panel; longer K reloads
+// B for every tile.
+#ifndef MM_GEMV_PANEL_K
+#define MM_GEMV_PANEL_K 8192
+#endif
+
+struct mm_gemv_cfg : mm_kernel_cfg {
+	static const int PANEL_K = MM_GEMV_PANEL_K;
+	static const int GEMV_N = MM_GEMV_N;
+};
+
+#define MM_TOP mm_gemv
+#define MM_TOP_CFG mm_gemv_cfg
+#define MM_TOP_SPLIT_A
+#include "mm_top.h"
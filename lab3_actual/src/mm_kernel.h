@@ -0,0 +1,1334 @@
+/**********
+Copyright (c) 2019, Xilinx, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software
+without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********/
+
+// Kernel template shared by every mm_vX.cpp design point.
+//
+// A design point is a struct derived from mm_kernel_cfg that overrides the
+// parameters it changes; mm_vX.cpp defines it as mm_cfg and includes
+// mm_top.h for the mm top function. Every design point has the same
+// interface and argument contract (see mm_top.h), so the host and the
+// native build run any of them.
+//
+// Tile size and port width have to match the host's MM_TILE and
+// MM_PORT_BYTES (mm_config.h), the element types its type flags, so they
+// default to those flags. Size-specialized kernels are built by setting
+// the flags for both sides rather than by overriding M or PORT_WIDTH_B.
+//
+// Problem sizes are arbitrary (Mdim x Kdim x Ndim), A is stored transposed
+// (At[Kdim][Mdim]) and every row stride is padded to a whole block_t.
+// Edge tiles only move and compute their valid rows, columns and depth, so
+// all stages derive the same per-tile counts from the traits helpers.
+//
+// One launch processes `batch` independent problems of the same shape. The
+// i-th problem starts i*strideA / i*strideB / i*strideAB beats into A_p /
+// B_p / AB_p, and every stage simply walks the batch in order.
+//
+// Only output tiles [tile_first, tile_first + tile_count) of each problem
+// are computed. With order == ORDER_ROWS tiles are numbered row by row
+// (t = ib * tiles(Ndim) + jb), with ORDER_COLS column by column
+// (t = jb * tiles(Mdim) + ib). The host uses tile ranges to spread one GEMM
+// over several compute units; a full problem is tile_first = 0,
+// tile_count = tiles(Mdim) * tiles(Ndim).
+//
+// Block-sparse operands are described by tile occupancy bitmaps at occ_p,
+// strideOcc words per problem: first the A bitmap, bit ib * tiles(Kdim) + kb
+// set when tile (ib, kb) of A has a nonzero element, then, from word
+// ceil(tiles(Mdim) * tiles(Kdim) / 32), the B bitmap with bit
+// kb * tiles(Ndim) + jb for tile (kb, jb) of B. `sparse` selects which of
+// them are used (SPARSE_A, SPARSE_B); k blocks of an output tile whose A or
+// B tile is empty are neither read nor computed. With sparse == 0 occ_p is
+// never read and every k block is live.
+//
+// Finished sums go through the fused epilogue of mm_elem.h in writeAB.
+// epi_p holds a per-column bias vector followed by a per-column scale
+// vector, 32 bit words, each vector padded to whole beats; they are shared
+// by every problem of the launch and only read when `epilogue` has
+// EPI_BIAS or EPI_SCALE set.
+//
+// With abft set the design points also store checksums of every output
+// tile at chk_p, strideChk beats per problem: for tile (ib, jb), at tile
+// index ib * tiles(Ndim) + jb whatever the order, M column checksums
+// sum_i S[i][j] followed by M row checksums sum_j S[i][j] of the tile's raw
+// sums S, 64 bit acc_word()s. They are computed from the operands apart
+// from the MACs (abft_sums in the row-broadcast design, abft_line in the
+// sequential and systolic ones), so the host finds corrupted tiles by
+// summing the tiles it got back. The skinny kernel ignores abft and never
+// writes chk_p.
+//
+// A design point with GEMV_N > 0 is the skinny kernel for matrix-vector
+// and narrow-N products (mm_gemv.cpp). It keeps the interface above but
+// computes every output tile CHUNK columns at a time: the B columns of a
+// chunk stay on chip and A streams past them at a full beat per cycle, so
+// for Ndim <= CHUNK A is read exactly once at the port rate. Its top takes
+// A a second time (MM_TOP_SPLIT_A in mm_top.h) to read the even and odd
+// At rows through two bundles.
+
+#ifndef MM_KERNEL_H
+#define MM_KERNEL_H
+
+#include "hls_stream.h"
+#include "ap_int.h"
+#include "mm_config.h"
+#include "mm_elem.h"
+#ifdef MM_NATIVE
+#include "hls_dataflow.h"
+// constants and loop labels only named by HLS pragmas and reports look
+// unused to the native compiler
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-label"
+#endif
+
+const int ORDER_ROWS = 0;
+const int ORDER_COLS = 1;
+const int SPARSE_A = 1;
+const int SPARSE_B = 2;
+
+struct mm_kernel_cfg {
+	// output tile edge and gmem port width in bytes
+	static const int M = MM_TILE;
+	static const int PORT_WIDTH_B = MM_PORT_BYTES;
+	// block partition factor of the accumulator tile and the B row
+	static const int PARTITION = 2;
+	// DATAFLOW: readA, readB, comp and writeAB overlap as a pipeline of
+	// stages. Otherwise one loop nest reads, computes and writes each tile
+	// in turn.
+	static const bool DATAFLOW = true;
+	// A_ROWS: A stored row-major (A_ROW_MAJOR, the lab 2 layout) instead of
+	// transposed, so each element of a k step's A column is its own
+	// scattered beat (sequential only)
+	static const bool A_ROWS = false;
+	// A / B panels of up to PANEL_K rows kept on chip (dataflow only): a
+	// panel (the At rows of one ib, or the B rows of one jb, for every k) is
+	// replayed instead of re-read for later tiles of the same ib / jb. Row
+	// order reuses the A panel across jb; column order reuses the B panel
+	// across ib, and with A_PANELS >= tiles(Mdim) every A panel as well, so
+	// A and B each cross gmem once. Larger Kdim streams everything from DRAM.
+	static const int A_PANELS = 1;
+	static const int B_PANELS = 1;
+	static const int PANEL_K = 1024;
+	// SA_ROWS x SA_COLS systolic array for comp (dataflow only), 0 for one
+	// fully unrolled M wide row of MACs
+	static const int SA_ROWS = 0;
+	static const int SA_COLS = 0;
+	// GEMV_N > 0 builds the skinny kernel instead (dataflow only): A streams
+	// at a full beat per cycle against GEMV_N on-chip B columns, see gemv_comp
+	static const int GEMV_N = 0;
+	// element types, see mm_elem.h
+	typedef mm_elems elems;
+};
+
+// Everything the stages derive from a design point.
+template <class C>
+struct mm_traits : C, C::elems {
+	typedef ap_int<C::PORT_WIDTH_B * 8> block_t;
+	static const int PORT_WIDTH_b = C::PORT_WIDTH_B * 8;
+	static const int IN_PER_PORT = PORT_WIDTH_b / C::elems::IN_WIDTH_b;
+	static const int OUT_PER_PORT = PORT_WIDTH_b / C::elems::OUT_WIDTH_b;
+	// beats of one panel row and of a whole panel
+	static const int PANEL_W = C::M / IN_PER_PORT;
+	static const int PANEL_BEATS = C::PANEL_K * PANEL_W;
+	static const int PANEL_KB = C::PANEL_K / C::M;
+	// 32 bit epilogue words per beat
+	static const int EPI_PER_PORT = PORT_WIDTH_b / 32;
+	// 64 bit checksum words per beat and checksum beats of a tile
+	static const int CHK_PER_PORT = PORT_WIDTH_b / 64;
+	static const int CHK_BEATS = 2 * C::M / CHK_PER_PORT;
+
+	// columns of a skinny kernel's output chunk, whole output beats
+	static const int GEMV_W = C::GEMV_N > 0 ? C::GEMV_N : 1;
+	static const int CHUNK = GEMV_W > OUT_PER_PORT ? GEMV_W : OUT_PER_PORT;
+
+	// One output beat's worth of finished sums, comp -> writeAB.
+	struct acc_beat {
+		typename C::elems::acc_t v[OUT_PER_PORT];
+	};
+
+	static_assert(C::M % IN_PER_PORT == 0 && C::M % OUT_PER_PORT == 0, "a tile row must be whole beats");
+	static_assert(C::PANEL_K % C::M == 0, "panels hold whole k blocks");
+	static_assert(C::M % EPI_PER_PORT == 0, "an epilogue vector tile must be whole beats");
+	static_assert(C::M % CHK_PER_PORT == 0, "a tile's checksums must be whole beats");
+	static_assert(C::GEMV_N == 0 || (C::DATAFLOW && C::SA_ROWS == 0 && C::M % CHUNK == 0 &&
+	                                 (GEMV_W % OUT_PER_PORT == 0 || OUT_PER_PORT % GEMV_W == 0)),
+	              "the skinny kernel is a dataflow design of whole output beats");
+	static_assert(C::M % C::PARTITION == 0, "the partition factor must divide M");
+	static_assert(!C::A_ROWS || !C::DATAFLOW, "row-major A is read by the sequential design only");
+	static_assert(C::SA_ROWS == 0 || (C::DATAFLOW && C::M % C::SA_ROWS == 0 && C::M % C::SA_COLS == 0),
+	              "the systolic array is a dataflow comp and must tile M");
+
+	static int tiles(int dim) { return (dim + C::M - 1) / C::M; }
+	static int tile_len(int dim, int t) { return dim - t*C::M < C::M ? dim - t*C::M : C::M; }
+	static int tile_ib(int t, int Mdim, int Ndim, int order) { return order == ORDER_COLS ? t % tiles(Mdim) : t / tiles(Ndim); }
+	static int tile_jb(int t, int Mdim, int Ndim, int order) { return order == ORDER_COLS ? t / tiles(Mdim) : t % tiles(Ndim); }
+
+	// Whether k block kb of output tile (ib, jb) has work, per the
+	// occupancy bitmaps of one problem that `sparse` selects.
+	static bool live(const unsigned *occ, int sparse, int Mdim, int Kdim, int Ndim, int ib, int jb, int kb) {
+		int a = ib * tiles(Kdim) + kb, b = kb * tiles(Ndim) + jb;
+		int b_word = (tiles(Mdim) * tiles(Kdim) + 31) / 32;
+		bool a_nz = !(sparse & SPARSE_A) || (occ[a / 32] >> (a % 32) & 1);
+		bool b_nz = !(sparse & SPARSE_B) || (occ[b_word + b / 32] >> (b % 32) & 1);
+		return a_nz && b_nz;
+	}
+};
+
+static int beats(int len, int per_port) { return (len + per_port - 1) / per_port; }
+
+// Lists the live k blocks of every output tile, each list ended by -1, on
+// one stream per stage that walks the k blocks.
+template <class T, int N>
+void plan(const unsigned *occ_p, hls::stream<int> kbs[N], int Mdim, int Kdim, int Ndim, int batch, int strideOcc,
+          int sparse, int tile_first, int tile_count, int order) {
+	const int PANEL_KB = T::PANEL_KB;
+	for(int b = 0; b < batch; b++) {
+		const unsigned *occ_b = occ_p + (long) b * strideOcc;
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int ib = T::tile_ib(t, Mdim, Ndim, order), jb = T::tile_jb(t, Mdim, Ndim, order);
+			for(int kb = 0; kb <= T::tiles(Kdim); kb++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=PANEL_KB+1
+				bool end = kb == T::tiles(Kdim);
+				if (end || T::live(occ_b, sparse, Mdim, Kdim, Ndim, ib, jb, kb)) {
+					for(int n = 0; n < N; n++) {
+#pragma HLS unroll
+						kbs[n].write(end ? -1 : kb);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Streams the beats [col, col + nbeats) of the rows of each k block listed
+// on kbs, from the panel cache when that block of panel `key` is resident.
+// Panels are claimed round robin and filled block by block as they are read.
+template <class T, int PANELS>
+static void read_panel(typename T::block_t *src, int ld, int col, int nbeats, int Kdim, int key, hls::stream<int> &kbs,
+                       typename T::block_t panels[PANELS][T::PANEL_BEATS], int tag[PANELS],
+                       bool valid[PANELS][T::PANEL_KB], int &victim, hls::stream<typename T::block_t> &out) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, PANEL_W = T::PANEL_W, PANEL_KB = T::PANEL_KB;
+	int slot = -1;
+	for(int p = 0; p < PANELS; p++) {
+#pragma HLS unroll
+		if (tag[p] == key)
+			slot = p;
+	}
+	if (slot < 0 && Kdim <= T::PANEL_K) {
+		slot = victim;
+		tag[slot] = key;
+		victim = victim + 1 == PANELS ? 0 : victim + 1;
+		for(int kb = 0; kb < PANEL_KB; kb++)
+			valid[slot][kb] = false;
+	}
+	for(int kb = kbs.read(); kb >= 0; kb = kbs.read()) {
+#pragma HLS loop_tripcount min=1 max=PANEL_KB
+		bool hit = slot >= 0 && valid[slot][kb];
+		for(int k = kb*M; k < kb*M + T::tile_len(Kdim, kb); k++) {
+#pragma HLS loop_tripcount min=1 max=M
+			for(int ii = 0; ii < nbeats; ii++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=PANEL_W
+				block_t v;
+				if (hit) {
+					v = panels[slot][k*PANEL_W+ii];
+				} else {
+					v = src[(long) k*ld+col+ii];
+					if (slot >= 0)
+						panels[slot][k*PANEL_W+ii] = v;
+				}
+				out.write(v);
+			}
+		}
+		if (slot >= 0)
+			valid[slot][kb] = true;
+	}
+}
+
+template <class T>
+void readA(typename T::block_t *A_p, hls::stream<int> &kbs, hls::stream<typename T::block_t> &AStreamWide, int Mdim, int Kdim, int Ndim,
+           int batch, int strideA, int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int A_PANELS = T::A_PANELS;
+	block_t A_panels[A_PANELS][T::PANEL_BEATS];
+#pragma HLS bind_storage variable=A_panels type=ram_2p impl=uram
+	int A_tag[A_PANELS];
+#pragma HLS array_partition variable=A_tag complete
+	bool A_valid[A_PANELS][T::PANEL_KB];
+#pragma HLS array_partition variable=A_valid complete dim=0
+	int ldA_p = beats(Mdim, T::IN_PER_PORT);
+	for(int b = 0; b < batch; b++) {
+		block_t *A_b = A_p + (long) b * strideA;
+		// panels hold the previous problem's data
+		for(int p = 0; p < A_PANELS; p++)
+			A_tag[p] = -1;
+		int victim = 0;
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int ib = T::tile_ib(t, Mdim, Ndim, order);
+			read_panel<T, A_PANELS>(A_b, ldA_p, ib*T::PANEL_W, beats(T::tile_len(Mdim, ib), T::IN_PER_PORT), Kdim, ib, kbs,
+			                        A_panels, A_tag, A_valid, victim, AStreamWide);
+		}
+	}
+}
+
+template <class T>
+void readB(typename T::block_t *B_p, hls::stream<int> &kbs, hls::stream<typename T::block_t> &BStream, int Mdim, int Kdim, int Ndim,
+           int batch, int strideB, int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int B_PANELS = T::B_PANELS;
+	block_t B_panels[B_PANELS][T::PANEL_BEATS];
+#pragma HLS bind_storage variable=B_panels type=ram_2p impl=uram
+	int B_tag[B_PANELS];
+#pragma HLS array_partition variable=B_tag complete
+	bool B_valid[B_PANELS][T::PANEL_KB];
+#pragma HLS array_partition variable=B_valid complete dim=0
+	int ldB_p = beats(Ndim, T::IN_PER_PORT);
+	for(int b = 0; b < batch; b++) {
+		block_t *B_b = B_p + (long) b * strideB;
+		for(int p = 0; p < B_PANELS; p++)
+			B_tag[p] = -1;
+		int victim = 0;
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int jb = T::tile_jb(t, Mdim, Ndim, order);
+			read_panel<T, B_PANELS>(B_b, ldB_p, jb*T::PANEL_W, beats(T::tile_len(Ndim, jb), T::IN_PER_PORT), Kdim, jb, kbs,
+			                        B_panels, B_tag, B_valid, victim, BStream);
+		}
+	}
+}
+
+// Splits the A beats into one element per cycle for the row-broadcast comp.
+template <class T>
+void changeARate(hls::stream<int> &kbs, hls::stream<typename T::block_t> &AStreamWide, hls::stream<typename T::in_t> &AStream, int Mdim,
+                 int Kdim, int Ndim, int batch, int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, IN_W = T::IN_WIDTH_b, PER_PORT = T::IN_PER_PORT;
+	for(int b = 0; b < batch; b++) {
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int i_cnt = T::tile_len(Mdim, T::tile_ib(t, Mdim, Ndim, order));
+			for(int kb = kbs.read(); kb >= 0; kb = kbs.read()) {
+				for(int k = 0; k < T::tile_len(Kdim, kb); k++) {
+#pragma HLS loop_tripcount min=1 max=M
+					for(int ii = 0; ii < beats(i_cnt, PER_PORT); ii++) {
+#pragma HLS loop_tripcount min=1 max=M/PER_PORT
+						block_t A_temp = AStreamWide.read();
+						for(int i = 0; i < PER_PORT; i++) {
+#pragma HLS pipeline II=1
+							typename T::in_t a = T::in_from_bits(A_temp(IN_W * (i + 1) - 1, IN_W * i));
+							if (ii * PER_PORT + i < i_cnt)
+								AStream.write(a);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Row-broadcast comp: every A element of a k row is multiplied with the
+// whole B row in one cycle, M MACs wide. With abft it passes every A
+// element and B beat on to abft_sums as well.
+template <class T>
+void comp(hls::stream<int> &kbs, hls::stream<typename T::in_t> &AStream, hls::stream<typename T::block_t> &BStream,
+          hls::stream<typename T::acc_beat> &ABStream, hls::stream<typename T::in_t> &AChk,
+          hls::stream<typename T::block_t> &BChk, int abft, int Mdim, int Kdim, int Ndim, int batch,
+          int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, PARTITION = T::PARTITION;
+	const int IN_W = T::IN_WIDTH_b, IN_PER_PORT = T::IN_PER_PORT;
+	const int OUT_PER_PORT = T::OUT_PER_PORT;
+	typename T::acc_t AB_block[M][M];
+#pragma HLS array_partition variable=AB_block type=block factor=PARTITION
+	for (int b = 0; b < batch; b++) {
+		for (int t = tile_first; t < tile_first + tile_count; t++) {
+			int i_cnt = T::tile_len(Mdim, T::tile_ib(t, Mdim, Ndim, order));
+			int j_cnt = T::tile_len(Ndim, T::tile_jb(t, Mdim, Ndim, order));
+			int jj_in = beats(j_cnt, IN_PER_PORT), jj_out = beats(j_cnt, OUT_PER_PORT);
+			int i_trips = i_cnt < T::ACC_LAT ? T::ACC_LAT : i_cnt;
+			for (int i = 0; i < M; i++) {
+#pragma HLS pipeline II=1
+				for (int j = 0; j < M; j++) {
+#pragma HLS unroll
+					AB_block[i][j] = 0;
+				}
+			}
+
+			// a tile without live k blocks stays zero
+			for (int kb = kbs.read(); kb >= 0; kb = kbs.read()) {
+				for (int k=0; k < T::tile_len(Kdim, kb); k++) {
+#pragma HLS loop_tripcount min=1 max=M
+					typename T::in_t Bj[M];
+#pragma HLS array_partition variable=Bj type=block factor=PARTITION
+					for (int jj = 0; jj < M/IN_PER_PORT; jj++) {
+#pragma HLS pipeline II=1
+						// beats past the edge of B are not streamed
+						block_t B_temp = 0;
+						if (jj < jj_in) {
+							B_temp = BStream.read();
+							if (abft)
+								BChk.write(B_temp);
+						}
+						for (int j = 0; j < IN_PER_PORT; j++) {
+#pragma HLS unroll	
+							Bj[jj * IN_PER_PORT + j] = T::in_from_bits(B_temp.range((j+1) * IN_W - 1, j * IN_W));
+						}
+					}
+					// row i is updated again i_trips cycles later, which has
+					// to cover the adder latency; short edge tiles idle
+					for (int i = 0; i < i_trips; i++) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=AB_block inter false
+#pragma HLS loop_tripcount min=1 max=M
+						if (i < i_cnt) {
+							typename T::in_t A_val = AStream.read();
+							if (abft)
+								AChk.write(A_val);
+							for (int j = 0; j < M; j++) {
+#pragma HLS unroll	
+								AB_block[i][j] += T::mul(A_val, Bj[j]);
+							}
+						}
+					}
+				}
+			}
+			for (int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+				for (int jj = 0; jj < jj_out; jj++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/OUT_PER_PORT
+					typename T::acc_beat AB_temp;
+					for (int j = 0; j < OUT_PER_PORT; j++) {
+#pragma HLS unroll
+						AB_temp.v[j] = AB_block[i][jj * OUT_PER_PORT + j];
+					}
+					ABStream.write(AB_temp);
+
+				}
+			}
+		}
+	}
+}
+
+// Beat c of a tile's checksums: the column checksums, then the row ones.
+template <class T>
+static typename T::block_t abft_beat(const typename T::acc_t col[T::M], const typename T::acc_t row[T::M], int c) {
+	const int M = T::M, CHK_PER_PORT = T::CHK_PER_PORT;
+	typename T::block_t words;
+	for (int w = 0; w < CHK_PER_PORT; w++) {
+#pragma HLS unroll
+		int e = (c % (M / CHK_PER_PORT)) * CHK_PER_PORT + w;
+		words.range((w+1) * 64 - 1, w * 64) = T::acc_word(c < M / CHK_PER_PORT ? col[e] : row[e]);
+	}
+	return words;
+}
+
+// Adds k row a (A[i][k] of the tile) and b (B[k][j]) into the checksums,
+// as abft_sums does, for the designs that hold a whole k row on chip:
+// cs = sum_i a[i] and rs = sum_j b[j] over the tile, then col[j] += cs b[j]
+// and row[i] += a[i] rs.
+template <class T>
+static void abft_line(const typename T::in_t a[T::M], const typename T::in_t b[T::M], int i_cnt, int j_cnt,
+                      typename T::acc_t col[T::M], typename T::acc_t row[T::M]) {
+	typedef typename T::acc_t acc_t;
+	const int M = T::M;
+	acc_t cs = 0, rs = 0;
+	for (int i = 0; i < M; i++) {
+#pragma HLS unroll
+		if (i < i_cnt)
+			cs += (acc_t) a[i];
+		if (i < j_cnt)
+			rs += (acc_t) b[i];
+	}
+	for (int i = 0; i < M; i++) {
+#pragma HLS pipeline II=1
+		if (i < j_cnt)
+			col[i] += (acc_t) (cs * b[i]);
+		if (i < i_cnt)
+			row[i] += (acc_t) (rs * a[i]);
+	}
+}
+
+// ABFT checksums of every output tile, from the A elements and B beats
+// comp passes on when abft is set. With cs_k = sum_i A[i][k] and
+// rs_k = sum_j B[k][j] over the tile, the column checksums are
+// sum_k cs_k B[k][j] and the row checksums sum_k A[i][k] rs_k; writeAB
+// stores them after the tile. Only a few MACs wide, at comp's pace: the
+// column update of a k row runs while the next B row arrives, and the A
+// and B sums take ACC_LAT partial sums like comp's accumulators.
+template <class T>
+void abft_sums(hls::stream<int> &kbs, hls::stream<typename T::in_t> &AChk, hls::stream<typename T::block_t> &BChk,
+               hls::stream<typename T::block_t> &ChkStream, int abft, int Mdim, int Kdim, int Ndim, int batch,
+               int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	typedef typename T::acc_t acc_t;
+	const int M = T::M, LAT = T::ACC_LAT, IN_W = T::IN_WIDTH_b, IN_PER_PORT = T::IN_PER_PORT;
+	const int CHK_PER_PORT = T::CHK_PER_PORT;
+	acc_t col[M], row[M];
+#pragma HLS array_partition variable=col type=cyclic factor=IN_PER_PORT
+#pragma HLS array_partition variable=row type=cyclic factor=CHK_PER_PORT
+	typename T::in_t Bk[M];
+#pragma HLS array_partition variable=Bk type=cyclic factor=IN_PER_PORT
+	acc_t lane[LAT];
+#pragma HLS array_partition variable=lane complete
+	for (int b = 0; b < batch; b++) {
+		for (int t = tile_first; t < tile_first + tile_count; t++) {
+			int i_cnt = T::tile_len(Mdim, T::tile_ib(t, Mdim, Ndim, order));
+			int j_cnt = T::tile_len(Ndim, T::tile_jb(t, Mdim, Ndim, order));
+			int jj_in = beats(j_cnt, IN_PER_PORT);
+			int i_trips = i_cnt < LAT ? LAT : i_cnt;
+			for (int i = 0; i < M; i++) {
+#pragma HLS pipeline II=1
+				col[i] = 0;
+				row[i] = 0;
+				Bk[i] = 0;
+			}
+			// cs of the B row in Bk, still to be added into col
+			acc_t cs = 0;
+			for (int kb = kbs.read(); kb >= 0; kb = kbs.read()) {
+				for (int k = 0; abft && k < T::tile_len(Kdim, kb); k++) {
+#pragma HLS loop_tripcount min=1 max=M
+					for (int l = 0; l < LAT; l++) {
+#pragma HLS unroll
+						lane[l] = 0;
+					}
+					for (int jj = 0; jj < jj_in; jj++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/IN_PER_PORT
+						block_t B_temp = BChk.read();
+						acc_t sum = 0;
+						for (int j = 0; j < IN_PER_PORT; j++) {
+#pragma HLS unroll
+							int c = jj * IN_PER_PORT + j;
+							typename T::in_t x = T::in_from_bits(B_temp.range((j+1) * IN_W - 1, j * IN_W));
+							col[c] += (acc_t) (cs * Bk[c]);
+							Bk[c] = x;
+							if (c < j_cnt)
+								sum += (acc_t) x;
+						}
+						lane[jj % LAT] += sum;
+					}
+					acc_t rs = 0;
+					for (int l = 0; l < LAT; l++) {
+#pragma HLS unroll
+						rs += lane[l];
+						lane[l] = 0;
+					}
+					for (int i = 0; i < i_trips; i++) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=row inter false
+#pragma HLS loop_tripcount min=1 max=M
+						if (i < i_cnt) {
+							typename T::in_t a = AChk.read();
+							lane[i % LAT] += (acc_t) a;
+							row[i] += (acc_t) (rs * a);
+						}
+					}
+					cs = 0;
+					for (int l = 0; l < LAT; l++) {
+#pragma HLS unroll
+						cs += lane[l];
+					}
+				}
+			}
+			if (!abft)
+				continue;
+			for (int jj = 0; jj < jj_in; jj++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/IN_PER_PORT
+				for (int j = 0; j < IN_PER_PORT; j++) {
+#pragma HLS unroll
+					col[jj * IN_PER_PORT + j] += (acc_t) (cs * Bk[jj * IN_PER_PORT + j]);
+				}
+			}
+			for (int c = 0; c < T::CHK_BEATS; c++) {
+#pragma HLS pipeline II=1
+				ChkStream.write(abft_beat<T>(col, row, c));
+			}
+		}
+	}
+}
+
+// Output-stationary systolic array of SA_ROWS x SA_COLS processing elements.
+// PE (r, c) owns one output of the current SA_ROWS x SA_COLS sub-block.
+// A enters the left column with row r delayed by r cycles and moves one PE
+// to the right per cycle, B enters the top row with column c delayed by c
+// cycles and moves one PE down, so A[i0+r][k] and B[k][j0+c] meet in PE
+// (r, c) at cycle k + r + c. Partial sums never move; they are loaded
+// before and stored after the k_cnt + SA_ROWS + SA_COLS - 2 cycle sweep.
+//
+// Each PE adds into one of T::ACC_LAT lanes in turn, so a lane is only
+// updated again once its previous addition has retired (float adders),
+// and sums its lanes on the way out. Exact types have a single lane.
+template <class T>
+static void pe_array(typename T::in_t A_blk[T::M][T::M], typename T::in_t B_blk[T::M][T::M],
+                     typename T::acc_t AB_block[T::M][T::M], int i0, int j0, int k_cnt, bool first) {
+	typedef typename T::in_t in_t;
+	typedef typename T::acc_t acc_t;
+	const int M = T::M, SA_ROWS = T::SA_ROWS, SA_COLS = T::SA_COLS, LANES = T::ACC_LAT;
+	acc_t acc[SA_ROWS][SA_COLS][LANES];
+#pragma HLS array_partition variable=acc complete dim=0
+	in_t a_reg[SA_ROWS][SA_COLS];
+#pragma HLS array_partition variable=a_reg complete dim=0
+	in_t b_reg[SA_ROWS][SA_COLS];
+#pragma HLS array_partition variable=b_reg complete dim=0
+
+	for (int r = 0; r < SA_ROWS; r++) {
+#pragma HLS pipeline II=1
+		for (int c = 0; c < SA_COLS; c++) {
+#pragma HLS unroll
+			for (int l = 0; l < LANES; l++)
+				acc[r][c][l] = l == 0 && !first ? AB_block[i0 + r][j0 + c] : (acc_t) 0;
+			a_reg[r][c] = 0;
+			b_reg[r][c] = 0;
+		}
+	}
+
+	for (int t = 0; t < k_cnt + SA_ROWS + SA_COLS - 2; t++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M+SA_ROWS+SA_COLS-2
+		int lane = t % LANES;
+		// walk against the flow so every PE sees its neighbours' previous values
+		for (int r = SA_ROWS - 1; r >= 0; r--) {
+#pragma HLS unroll
+			for (int c = SA_COLS - 1; c >= 0; c--) {
+#pragma HLS unroll
+				in_t a, b;
+				if (c == 0)
+					a = t - r >= 0 && t - r < k_cnt ? A_blk[t - r][i0 + r] : (in_t) 0;
+				else
+					a = a_reg[r][c - 1];
+				if (r == 0)
+					b = t - c >= 0 && t - c < k_cnt ? B_blk[t - c][j0 + c] : (in_t) 0;
+				else
+					b = b_reg[r - 1][c];
+				acc[r][c][lane] += T::mul(a, b);
+				a_reg[r][c] = a;
+				b_reg[r][c] = b;
+			}
+		}
+	}
+
+	for (int r = 0; r < SA_ROWS; r++) {
+#pragma HLS pipeline II=1
+		for (int c = 0; c < SA_COLS; c++) {
+#pragma HLS unroll
+			acc_t sum = acc[r][c][0];
+			for (int l = 1; l < LANES; l++)
+				sum += acc[r][c][l];
+			AB_block[i0 + r][j0 + c] = sum;
+		}
+	}
+}
+
+// Systolic comp: loads a k-block of the A and B panels, whole beats at a
+// time, then sweeps pe_array over the sub-blocks of the tile. With abft it
+// also sums the loaded k-block into the tile's checksums (abft_line) and
+// passes them on to writeAB after the tile.
+template <class T>
+void comp_sa(hls::stream<int> &kbs, hls::stream<typename T::block_t> &AStream, hls::stream<typename T::block_t> &BStream,
+             hls::stream<typename T::acc_beat> &ABStream, hls::stream<typename T::block_t> &ChkStream, int abft,
+             int Mdim, int Kdim, int Ndim, int batch, int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, SA_ROWS = T::SA_ROWS, SA_COLS = T::SA_COLS;
+	const int IN_W = T::IN_WIDTH_b, IN_PER_PORT = T::IN_PER_PORT;
+	const int OUT_PER_PORT = T::OUT_PER_PORT;
+	typename T::acc_t AB_block[M][M];
+#pragma HLS array_partition variable=AB_block type=cyclic factor=SA_COLS dim=2
+	// k-block of the A panel (stored [k][i], like At) and of the B panel
+	typename T::in_t A_blk[M][M];
+#pragma HLS array_partition variable=A_blk type=cyclic factor=SA_ROWS dim=2
+	typename T::in_t B_blk[M][M];
+#pragma HLS array_partition variable=B_blk type=cyclic factor=SA_COLS dim=2
+	typename T::acc_t col[M], row[M];
+	for (int b = 0; b < batch; b++) {
+		for (int t = tile_first; t < tile_first + tile_count; t++) {
+			int i_cnt = T::tile_len(Mdim, T::tile_ib(t, Mdim, Ndim, order));
+			int j_cnt = T::tile_len(Ndim, T::tile_jb(t, Mdim, Ndim, order));
+			int ii_cnt = beats(i_cnt, IN_PER_PORT);
+			int jj_cnt = beats(j_cnt, IN_PER_PORT);
+			for (int i = 0; i < M; i++) {
+#pragma HLS pipeline II=1
+				col[i] = 0;
+				row[i] = 0;
+			}
+
+			bool first = true;
+			for (int kb = kbs.read(); kb >= 0; kb = kbs.read()) {
+				int k_cnt = T::tile_len(Kdim, kb);
+				for (int k = 0; k < k_cnt; k++) {
+#pragma HLS loop_tripcount min=1 max=M
+					for (int ii = 0; ii < M/IN_PER_PORT; ii++) {
+#pragma HLS pipeline II=1
+						// beats past the edge of the tile are not streamed
+						block_t A_temp = 0;
+						if (ii < ii_cnt)
+							A_temp = AStream.read();
+						for (int i = 0; i < IN_PER_PORT; i++) {
+#pragma HLS unroll
+							A_blk[k][ii * IN_PER_PORT + i] = T::in_from_bits(A_temp.range((i+1) * IN_W - 1, i * IN_W));
+						}
+					}
+				}
+				for (int k = 0; k < k_cnt; k++) {
+#pragma HLS loop_tripcount min=1 max=M
+					for (int jj = 0; jj < M/IN_PER_PORT; jj++) {
+#pragma HLS pipeline II=1
+						block_t B_temp = 0;
+						if (jj < jj_cnt)
+							B_temp = BStream.read();
+						for (int j = 0; j < IN_PER_PORT; j++) {
+#pragma HLS unroll
+							B_blk[k][jj * IN_PER_PORT + j] = T::in_from_bits(B_temp.range((j+1) * IN_W - 1, j * IN_W));
+						}
+					}
+				}
+
+				for (int k = 0; abft && k < k_cnt; k++) {
+#pragma HLS loop_tripcount min=1 max=M
+					abft_line<T>(A_blk[k], B_blk[k], i_cnt, j_cnt, col, row);
+				}
+
+				// sub-blocks entirely outside the tile are skipped
+				for (int i0 = 0; i0 < i_cnt; i0 += SA_ROWS) {
+#pragma HLS loop_tripcount min=1 max=M/SA_ROWS
+					for (int j0 = 0; j0 < j_cnt; j0 += SA_COLS) {
+#pragma HLS loop_tripcount min=1 max=M/SA_COLS
+						pe_array<T>(A_blk, B_blk, AB_block, i0, j0, k_cnt, first);
+					}
+				}
+				first = false;
+			}
+			// a tile without live k blocks is zero
+			if (first) {
+				for (int i = 0; i < M; i++) {
+#pragma HLS pipeline II=1
+					for (int j = 0; j < M; j++) {
+#pragma HLS unroll
+						AB_block[i][j] = 0;
+					}
+				}
+			}
+
+			for (int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+				for (int jj = 0; jj < beats(j_cnt, OUT_PER_PORT); jj++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/OUT_PER_PORT
+					typename T::acc_beat AB_temp;
+					for (int j = 0; j < OUT_PER_PORT; j++) {
+#pragma HLS unroll
+						AB_temp.v[j] = AB_block[i][jj * OUT_PER_PORT + j];
+					}
+					ABStream.write(AB_temp);
+				}
+			}
+			for (int c = 0; abft && c < T::CHK_BEATS; c++) {
+#pragma HLS pipeline II=1
+				ChkStream.write(abft_beat<T>(col, row, c));
+			}
+		}
+	}
+}
+
+// Loads the bias and scale words of output columns jb*M .. jb*M + j_cnt - 1
+// when the epilogue uses them.
+template <class T>
+static void read_epilogue(const typename T::block_t *epi_p, int epilogue, int Ndim, int jb, ap_uint<32> bias[T::M],
+                          ap_uint<32> scale[T::M]) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, PER_PORT = T::EPI_PER_PORT;
+	if (!(epilogue & (EPI_BIAS | EPI_SCALE)))
+		return;
+	int ldE = beats(Ndim, PER_PORT);
+	for (int jj = 0; jj < beats(T::tile_len(Ndim, jb), PER_PORT); jj++) {
+#pragma HLS pipeline II=2
+#pragma HLS loop_tripcount min=1 max=M/PER_PORT
+		block_t b = epi_p[jb*M/PER_PORT+jj], s = epi_p[ldE+jb*M/PER_PORT+jj];
+		for (int j = 0; j < PER_PORT; j++) {
+#pragma HLS unroll
+			bias[jj*PER_PORT+j] = b.range((j+1) * 32 - 1, j * 32);
+			scale[jj*PER_PORT+j] = s.range((j+1) * 32 - 1, j * 32);
+		}
+	}
+}
+
+// Applies the epilogue to the finished sums and writes them out as out_t,
+// with abft followed by the tile's checksums from ChkStream.
+template <class T>
+void writeAB(hls::stream<typename T::acc_beat> &ABStream, typename T::block_t *AB, const typename T::block_t *epi_p,
+             int epilogue, int shift, int act_lo, int act_hi, hls::stream<typename T::block_t> &ChkStream,
+             typename T::block_t *chk_p, int strideChk, int abft, int Mdim, int Kdim, int Ndim, int batch, int strideAB,
+             int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, OUT_W = T::OUT_WIDTH_b, OUT_PER_PORT = T::OUT_PER_PORT;
+	(void) Kdim;
+	ap_uint<32> bias[M], scale[M];
+#pragma HLS array_partition variable=bias type=cyclic factor=OUT_PER_PORT
+#pragma HLS array_partition variable=scale type=cyclic factor=OUT_PER_PORT
+	int ldAB_p = beats(Ndim, OUT_PER_PORT);
+	for(int b = 0; b < batch; b++) {
+		block_t *AB_b = AB + (long) b * strideAB;
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int ib = T::tile_ib(t, Mdim, Ndim, order), jb = T::tile_jb(t, Mdim, Ndim, order);
+			read_epilogue<T>(epi_p, epilogue, Ndim, jb, bias, scale);
+			for(int i = 0; i < T::tile_len(Mdim, ib); i++) {
+#pragma HLS loop_tripcount min=1 max=M
+				for(int jj = 0; jj < beats(T::tile_len(Ndim, jb), OUT_PER_PORT); jj++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/OUT_PER_PORT
+					typename T::acc_beat sums = ABStream.read();
+					block_t AB_temp;
+					for (int j = 0; j < OUT_PER_PORT; j++) {
+#pragma HLS unroll
+						int c = jj * OUT_PER_PORT + j;
+						typename T::out_t v = T::epilogue(sums.v[j], bias[c], scale[c], epilogue, shift, act_lo, act_hi);
+						AB_temp.range((j+1) * OUT_W - 1, j * OUT_W) = T::out_bits(v);
+					}
+					AB_b[(long) (ib*M+i)*ldAB_p+jb*M/OUT_PER_PORT+jj] = AB_temp;
+				}
+			}
+			if (abft) {
+				block_t *chk_t = chk_p + (long) b * strideChk + (long) (ib * T::tiles(Ndim) + jb) * T::CHK_BEATS;
+				for (int c = 0; c < T::CHK_BEATS; c++) {
+#pragma HLS pipeline II=1
+					chk_t[c] = ChkStream.read();
+				}
+			}
+		}
+	}
+}
+
+// Sequential design: one loop nest reads the A and B rows of a k step
+// straight from gmem, accumulates them into the tile and writes the tile
+// out, so reads, compute and writes never overlap. With abft every k row
+// also goes into the tile's checksums (abft_line), written after the tile.
+template <class T>
+void mm_sequential(typename T::block_t *A_p, typename T::block_t *B_p, typename T::block_t *AB_p,
+                   const unsigned *occ_p, const typename T::block_t *epi_p, int Mdim, int Kdim, int Ndim, int batch,
+                   int strideA, int strideB, int strideAB, int strideOcc, int sparse, int epilogue, int shift,
+                   int act_lo, int act_hi, int tile_first, int tile_count, int order, typename T::block_t *chk_p,
+                   int strideChk, int abft) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, PARTITION = T::PARTITION;
+	const int IN_W = T::IN_WIDTH_b, IN_PER_PORT = T::IN_PER_PORT;
+	const int OUT_W = T::OUT_WIDTH_b, OUT_PER_PORT = T::OUT_PER_PORT;
+	typename T::acc_t AB_block[M][M];
+#pragma HLS array_partition variable=AB_block type=block factor=PARTITION
+	ap_uint<32> bias[M], scale[M];
+#pragma HLS array_partition variable=bias type=cyclic factor=OUT_PER_PORT
+#pragma HLS array_partition variable=scale type=cyclic factor=OUT_PER_PORT
+	typename T::acc_t chk_col[M], chk_row[M];
+
+	int ldA_p = beats(T::A_ROWS ? Kdim : Mdim, IN_PER_PORT);
+	int ldB_p = beats(Ndim, IN_PER_PORT);
+	int ldAB_p = beats(Ndim, OUT_PER_PORT);
+
+	batch_loop: for(int b = 0; b < batch; b++) {
+		block_t *A_b = A_p + (long) b * strideA;
+		block_t *B_b = B_p + (long) b * strideB;
+		block_t *AB_b = AB_p + (long) b * strideAB;
+		const unsigned *occ_b = occ_p + (long) b * strideOcc;
+		tile_loop: for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int ib = T::tile_ib(t, Mdim, Ndim, order), jb = T::tile_jb(t, Mdim, Ndim, order);
+			int i_cnt = T::tile_len(Mdim, ib), j_cnt = T::tile_len(Ndim, jb);
+			int ii_cnt = beats(i_cnt, IN_PER_PORT);
+			int jj_in = beats(j_cnt, IN_PER_PORT), jj_out = beats(j_cnt, OUT_PER_PORT);
+			init_i_loop: for(int i = 0; i < M; i++) {
+#pragma HLS pipeline II=1
+				init_j_loop: for(int j = 0; j < M; j++) {
+#pragma HLS unroll
+					AB_block[i][j] = 0;
+				}
+				chk_col[i] = 0;
+				chk_row[i] = 0;
+			}
+
+			kb_loop: for(int kb = 0; kb < T::tiles(Kdim); kb++) {
+				if (!T::live(occ_b, sparse, Mdim, Kdim, Ndim, ib, jb, kb))
+					continue;
+				k_loop: for(int k = 0; k < T::tile_len(Kdim, kb); k++) {
+#pragma HLS loop_tripcount min=1 max=M
+					long row = (long) kb * M + k;
+					typename T::in_t Bj[M];
+#pragma HLS array_partition variable=Bj type=block factor=PARTITION
+					readB_j_loop: for(int jj = 0; jj < M/IN_PER_PORT; jj++) {
+#pragma HLS pipeline II=1
+						block_t B_temp = 0;
+						if (jj < jj_in)
+							B_temp = B_b[row * ldB_p + jb * M / IN_PER_PORT + jj];
+						for (int j = 0; j < IN_PER_PORT; j++) {
+#pragma HLS unroll
+							Bj[jj * IN_PER_PORT + j] = T::in_from_bits(B_temp.range((j + 1) * IN_W - 1, j * IN_W));
+						}
+					}
+
+					// written a beat at a time, read an element at a time
+					typename T::in_t A_line[M];
+#pragma HLS array_partition variable=A_line type=cyclic factor=IN_PER_PORT
+					if (T::A_ROWS) {
+						// row-major A: the column is one element of i_cnt rows
+						int lane = row % IN_PER_PORT;
+						readA_row_loop: for(int i = 0; i < i_cnt; i++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M
+							block_t A_temp = A_b[(long) (ib * M + i) * ldA_p + row / IN_PER_PORT];
+							A_line[i] = T::in_from_bits(A_temp.range((lane + 1) * IN_W - 1, lane * IN_W));
+						}
+					} else {
+						readA_i_loop: for(int ii = 0; ii < ii_cnt; ii++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/IN_PER_PORT
+							block_t A_temp = A_b[row * ldA_p + ib * M / IN_PER_PORT + ii];
+							for (int i = 0; i < IN_PER_PORT; i++) {
+#pragma HLS unroll
+								A_line[ii * IN_PER_PORT + i] = T::in_from_bits(A_temp.range((i + 1) * IN_W - 1, i * IN_W));
+							}
+						}
+					}
+
+					// j_loop is unrolled, i_loop stays unpipelined: the design is sequential
+					i_loop: for(int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+						j_loop: for(int j = 0; j < M; j++) {
+#pragma HLS unroll
+							AB_block[i][j] += T::mul(A_line[i], Bj[j]);
+						}
+					}
+					if (abft)
+						abft_line<T>(A_line, Bj, i_cnt, j_cnt, chk_col, chk_row);
+				}
+			}
+
+			read_epilogue<T>(epi_p, epilogue, Ndim, jb, bias, scale);
+			writeAB_i_loop: for(int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+				writeAB_j_loop: for(int jj = 0; jj < jj_out; jj++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/OUT_PER_PORT
+					block_t AB_temp;
+					for (int j = 0; j < OUT_PER_PORT; j++) {
+#pragma HLS unroll
+						int c = jj * OUT_PER_PORT + j;
+						typename T::out_t v = T::epilogue(AB_block[i][c], bias[c], scale[c], epilogue, shift, act_lo, act_hi);
+						AB_temp.range((j + 1) * OUT_W - 1, j * OUT_W) = T::out_bits(v);
+					}
+					AB_b[(long) (ib * M + i) * ldAB_p + jb * M / OUT_PER_PORT + jj] = AB_temp;
+				}
+			}
+			if (abft) {
+				block_t *chk_t = chk_p + (long) b * strideChk + (long) (ib * T::tiles(Ndim) + jb) * T::CHK_BEATS;
+				writeChk_loop: for (int c = 0; c < T::CHK_BEATS; c++) {
+#pragma HLS pipeline II=1
+					chk_t[c] = abft_beat<T>(chk_col, chk_row, c);
+				}
+			}
+		}
+	}
+}
+
+// Skinny design: reads the At rows of one parity (even or odd k) of every
+// live k block listed on kbs, once per column chunk of each tile. The two
+// strips run on their own bundles, so one burst is in flight on each.
+template <class T>
+void gemv_strip(typename T::block_t *A_p, int parity, hls::stream<int> &kbs,
+                hls::stream<typename T::block_t> &AStrip, int Mdim, int Kdim, int Ndim, int batch, int strideA,
+                int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, CHUNK = T::CHUNK;
+	int ldA_p = beats(Mdim, T::IN_PER_PORT);
+	for(int b = 0; b < batch; b++) {
+		block_t *A_b = A_p + (long) b * strideA;
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int ib = T::tile_ib(t, Mdim, Ndim, order), jb = T::tile_jb(t, Mdim, Ndim, order);
+			int ii_cnt = beats(T::tile_len(Mdim, ib), T::IN_PER_PORT);
+			for(int c = 0; c < beats(T::tile_len(Ndim, jb), CHUNK); c++) {
+#pragma HLS loop_tripcount min=1 max=M/CHUNK
+				for(int kb = kbs.read(); kb >= 0; kb = kbs.read()) {
+					for(int k = kb*M + parity; k < kb*M + T::tile_len(Kdim, kb); k += 2) {
+#pragma HLS loop_tripcount min=1 max=M/2
+						for(int ii = 0; ii < ii_cnt; ii++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/T::IN_PER_PORT
+							AStrip.write(A_b[(long) k*ldA_p+ib*T::PANEL_W+ii]);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Skinny design: streams the At strip of an output tile once per column
+// chunk, a full beat per cycle, preceded by the kb of every live k block
+// and followed by -1. The rows come from the even and odd gemv_strip, which
+// get the same kbs, and are merged back into k order.
+template <class T>
+void gemv_readA(const unsigned *occ_p, hls::stream<int> &kbs, hls::stream<int> strip_kbs[2],
+                hls::stream<typename T::block_t> AStrip[2], hls::stream<typename T::block_t> &AStream, int Mdim,
+                int Kdim, int Ndim, int batch, int strideOcc, int sparse, int tile_first, int tile_count, int order) {
+	const int M = T::M, CHUNK = T::CHUNK;
+	for(int b = 0; b < batch; b++) {
+		const unsigned *occ_b = occ_p + (long) b * strideOcc;
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int ib = T::tile_ib(t, Mdim, Ndim, order), jb = T::tile_jb(t, Mdim, Ndim, order);
+			int ii_cnt = beats(T::tile_len(Mdim, ib), T::IN_PER_PORT);
+			for(int c = 0; c < beats(T::tile_len(Ndim, jb), CHUNK); c++) {
+#pragma HLS loop_tripcount min=1 max=M/CHUNK
+				for(int kb = 0; kb < T::tiles(Kdim); kb++) {
+					if (!T::live(occ_b, sparse, Mdim, Kdim, Ndim, ib, jb, kb))
+						continue;
+					kbs.write(kb);
+					strip_kbs[0].write(kb);
+					strip_kbs[1].write(kb);
+					for(int k = kb*M; k < kb*M + T::tile_len(Kdim, kb); k++) {
+#pragma HLS loop_tripcount min=1 max=M
+						for(int ii = 0; ii < ii_cnt; ii++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=M/T::IN_PER_PORT
+							AStream.write(AStrip[k & 1].read());
+						}
+					}
+				}
+				kbs.write(-1);
+				strip_kbs[0].write(-1);
+				strip_kbs[1].write(-1);
+			}
+		}
+	}
+}
+
+// Skinny design: multiplies every A beat with GEMV_N columns of the chunk
+// per cycle, a row of IN_PER_PORT x GEMV_N MACs. The chunk's B rows are
+// loaded into B_buf per live k block; when all of Kdim fits they stay
+// there for the following tiles of the same chunk, which is every tile of
+// a GEMV.
+template <class T>
+void gemv_comp(typename T::block_t *B_p, hls::stream<int> &kbs, hls::stream<typename T::block_t> &AStream,
+               hls::stream<typename T::acc_beat> &ABStream, int Mdim, int Kdim, int Ndim, int batch, int strideB,
+               int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, CHUNK = T::CHUNK, G = T::GEMV_N, PANEL_K = T::PANEL_K;
+	const int IN_W = T::IN_WIDTH_b, IN_PER_PORT = T::IN_PER_PORT, OUT_PER_PORT = T::OUT_PER_PORT;
+	typename T::acc_t acc[M][CHUNK];
+#pragma HLS array_partition variable=acc type=cyclic factor=IN_PER_PORT dim=1
+#pragma HLS array_partition variable=acc type=cyclic factor=G dim=2
+	typename T::in_t B_buf[PANEL_K][CHUNK];
+#pragma HLS array_partition variable=B_buf type=cyclic factor=G dim=2
+	bool B_valid[T::PANEL_KB];
+	int ldB_p = beats(Ndim, IN_PER_PORT);
+	bool resident = Kdim <= PANEL_K;
+	int B_key = -1;
+	for(int b = 0; b < batch; b++) {
+		block_t *B_b = B_p + (long) b * strideB;
+		// a batch sharing one B (strideB == 0) keeps it across problems
+		if (strideB != 0)
+			B_key = -1;
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int ib = T::tile_ib(t, Mdim, Ndim, order), jb = T::tile_jb(t, Mdim, Ndim, order);
+			int i_cnt = T::tile_len(Mdim, ib), j_cnt = T::tile_len(Ndim, jb);
+			int ii_cnt = beats(i_cnt, IN_PER_PORT);
+			for(int c = 0; c < beats(j_cnt, CHUNK); c++) {
+#pragma HLS loop_tripcount min=1 max=M/CHUNK
+				int j0 = jb*M + c*CHUNK, cw = j_cnt - c*CHUNK < CHUNK ? j_cnt - c*CHUNK : CHUNK;
+				int passes = beats(cw, G);
+				// covers the adder latency like i_trips in comp
+				int trips = ii_cnt * passes < T::ACC_LAT ? T::ACC_LAT : ii_cnt * passes;
+				if (!resident || j0 != B_key) {
+					B_key = resident ? j0 : -1;
+					for(int kb = 0; kb < T::PANEL_KB; kb++)
+						B_valid[kb] = false;
+				}
+				for(int i = 0; i < M; i++) {
+#pragma HLS pipeline II=1
+					for(int j = 0; j < CHUNK; j++) {
+#pragma HLS unroll
+						acc[i][j] = 0;
+					}
+				}
+
+				for(int kb = kbs.read(); kb >= 0; kb = kbs.read()) {
+					int k_cnt = T::tile_len(Kdim, kb), row0 = resident ? kb*M : 0;
+					if (!resident || !B_valid[kb]) {
+						for(int k = 0; k < k_cnt; k++) {
+#pragma HLS loop_tripcount min=1 max=M
+							for(int jj = j0/IN_PER_PORT; jj <= (j0+CHUNK-1)/IN_PER_PORT; jj++) {
+#pragma HLS pipeline II=1
+								block_t B_temp = jj < ldB_p ? B_b[(long) (kb*M+k)*ldB_p+jj] : block_t(0);
+								for (int j = 0; j < IN_PER_PORT; j++) {
+#pragma HLS unroll
+									int col = jj*IN_PER_PORT + j - j0;
+									if (col >= 0 && col < CHUNK)
+										B_buf[row0+k][col] = T::in_from_bits(B_temp.range((j+1) * IN_W - 1, j * IN_W));
+								}
+							}
+						}
+						B_valid[kb] = resident;
+					}
+					for(int k = 0; k < k_cnt; k++) {
+#pragma HLS loop_tripcount min=1 max=M
+						block_t A_temp;
+						int ii = 0, p = 0;
+						for(int s = 0; s < trips; s++) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=acc inter false
+#pragma HLS loop_tripcount min=1 max=M/IN_PER_PORT*CHUNK/G
+							if (s < ii_cnt * passes) {
+								if (p == 0)
+									A_temp = AStream.read();
+								for (int i = 0; i < IN_PER_PORT; i++) {
+#pragma HLS unroll
+									typename T::in_t a = T::in_from_bits(A_temp.range((i+1) * IN_W - 1, i * IN_W));
+									for (int j = 0; j < G; j++) {
+#pragma HLS unroll
+										acc[ii*IN_PER_PORT+i][p*G+j] += T::mul(a, B_buf[row0+k][p*G+j]);
+									}
+								}
+								if (++p == passes) {
+									p = 0;
+									ii++;
+								}
+							}
+						}
+					}
+				}
+
+				for(int i = 0; i < i_cnt; i++) {
+#pragma HLS loop_tripcount min=1 max=M
+					for(int jj = 0; jj < beats(cw, OUT_PER_PORT); jj++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=CHUNK/OUT_PER_PORT
+						typename T::acc_beat AB_temp;
+						for (int j = 0; j < OUT_PER_PORT; j++) {
+#pragma HLS unroll
+							AB_temp.v[j] = acc[i][jj * OUT_PER_PORT + j];
+						}
+						ABStream.write(AB_temp);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Skinny design: writeAB for the chunks of gemv_comp.
+template <class T>
+void gemv_write(hls::stream<typename T::acc_beat> &ABStream, typename T::block_t *AB, const typename T::block_t *epi_p,
+                int epilogue, int shift, int act_lo, int act_hi, int Mdim, int Kdim, int Ndim, int batch, int strideAB,
+                int tile_first, int tile_count, int order) {
+	typedef typename T::block_t block_t;
+	const int M = T::M, CHUNK = T::CHUNK, OUT_W = T::OUT_WIDTH_b, OUT_PER_PORT = T::OUT_PER_PORT;
+	(void) Kdim;
+	ap_uint<32> bias[M], scale[M];
+#pragma HLS array_partition variable=bias type=cyclic factor=OUT_PER_PORT
+#pragma HLS array_partition variable=scale type=cyclic factor=OUT_PER_PORT
+	int ldAB_p = beats(Ndim, OUT_PER_PORT);
+	for(int b = 0; b < batch; b++) {
+		block_t *AB_b = AB + (long) b * strideAB;
+		for(int t = tile_first; t < tile_first + tile_count; t++) {
+			int ib = T::tile_ib(t, Mdim, Ndim, order), jb = T::tile_jb(t, Mdim, Ndim, order);
+			int j_cnt = T::tile_len(Ndim, jb);
+			read_epilogue<T>(epi_p, epilogue, Ndim, jb, bias, scale);
+			for(int c = 0; c < beats(j_cnt, CHUNK); c++) {
+#pragma HLS loop_tripcount min=1 max=M/CHUNK
+				int cw = j_cnt - c*CHUNK < CHUNK ? j_cnt - c*CHUNK : CHUNK;
+				for(int i = 0; i < T::tile_len(Mdim, ib); i++) {
+#pragma HLS loop_tripcount min=1 max=M
+					for(int jj = 0; jj < beats(cw, OUT_PER_PORT); jj++) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount min=1 max=CHUNK/OUT_PER_PORT
+						typename T::acc_beat sums = ABStream.read();
+						block_t AB_temp;
+						for (int j = 0; j < OUT_PER_PORT; j++) {
+#pragma HLS unroll
+							int col = c * CHUNK + jj * OUT_PER_PORT + j;
+							typename T::out_t v = T::epilogue(sums.v[j], bias[col], scale[col], epilogue, shift, act_lo, act_hi);
+							AB_temp.range((j+1) * OUT_W - 1, j * OUT_W) = T::out_bits(v);
+						}
+						AB_b[(long) (ib*M+i)*ldAB_p+(jb*M+c*CHUNK)/OUT_PER_PORT+jj] = AB_temp;
+					}
+				}
+			}
+		}
+	}
+}
+
+// The body of the top function for each kind of design point.
+template <class T, bool DATAFLOW = T::DATAFLOW, bool SYSTOLIC = (T::SA_ROWS > 0), bool GEMV = (T::GEMV_N > 0)>
+struct mm_body;
+
+template <class T>
+struct mm_body<T, false, false, false> {
+	static void run(typename T::block_t *A_p, typename T::block_t *B_p, typename T::block_t *AB_p, const unsigned *occ_p,
+	                const typename T::block_t *epi_p, int Mdim, int Kdim, int Ndim, int batch, int strideA, int strideB,
+	                int strideAB, int strideOcc, int sparse, int epilogue, int shift, int act_lo, int act_hi,
+	                int tile_first, int tile_count, int order, typename T::block_t *chk_p, int strideChk, int abft) {
+		mm_sequential<T>(A_p, B_p, AB_p, occ_p, epi_p, Mdim, Kdim, Ndim, batch, strideA, strideB, strideAB, strideOcc,
+		                 sparse, epilogue, shift, act_lo, act_hi, tile_first, tile_count, order, chk_p, strideChk, abft);
+	}
+};
+
+// readA -> changeARate -> comp <- readB, comp -> writeAB, comp -> abft_sums -> writeAB
+template <class T>
+struct mm_body<T, true, false, false> {
+	static void run(typename T::block_t *A_p, typename T::block_t *B_p, typename T::block_t *AB_p, const unsigned *occ_p,
+	                const typename T::block_t *epi_p, int Mdim, int Kdim, int Ndim, int batch, int strideA, int strideB,
+	                int strideAB, int strideOcc, int sparse, int epilogue, int shift, int act_lo, int act_hi,
+	                int tile_first, int tile_count, int order, typename T::block_t *chk_p, int strideChk, int abft) {
+		hls::stream<typename T::block_t> AStreamWide("AStreamWide");
+		hls::stream<typename T::in_t> AStream("AStream");
+		hls::stream<typename T::block_t> BStream("BStream");
+		hls::stream<typename T::acc_beat> ABStream("ABStream");
+		hls::stream<typename T::in_t> AChk("AChk");
+		hls::stream<typename T::block_t> BChk("BChk");
+		hls::stream<typename T::block_t> ChkStream("ChkStream");
+		// live k blocks for readA, changeARate, readB, comp and abft_sums
+		hls::stream<int> kbs[5];
+
+#pragma HLS DATAFLOW
+
+#ifdef MM_NATIVE
+		// native build: stages run concurrently, connected by the bounded streams
+		hls_native::dataflow({
+			{"plan", [&] { plan<T, 5>(occ_p, kbs, Mdim, Kdim, Ndim, batch, strideOcc, sparse, tile_first, tile_count, order); }},
+			{"readA", [&] { readA<T>(A_p, kbs[0], AStreamWide, Mdim, Kdim, Ndim, batch, strideA, tile_first, tile_count, order); }},
+			{"changeARate", [&] { changeARate<T>(kbs[1], AStreamWide, AStream, Mdim, Kdim, Ndim, batch, tile_first, tile_count, order); }},
+			{"readB", [&] { readB<T>(B_p, kbs[2], BStream, Mdim, Kdim, Ndim, batch, strideB, tile_first, tile_count, order); }},
+			{"comp", [&] { comp<T>(kbs[3], AStream, BStream, ABStream, AChk, BChk, abft, Mdim, Kdim, Ndim, batch, tile_first, tile_count, order); }},
+			{"abft", [&] { abft_sums<T>(kbs[4], AChk, BChk, ChkStream, abft, Mdim, Kdim, Ndim, batch, tile_first, tile_count, order); }},
+			{"writeAB", [&] { writeAB<T>(ABStream, AB_p, epi_p, epilogue, shift, act_lo, act_hi, ChkStream, chk_p, strideChk, abft, Mdim, Kdim, Ndim, batch, strideAB, tile_first, tile_count, order); }},
+		});
+#else
+		plan<T, 5>(occ_p, kbs, Mdim, Kdim, Ndim, batch, strideOcc, sparse, tile_first, tile_count, order);
+		readA<T>(A_p, kbs[0], AStreamWide, Mdim, Kdim, Ndim, batch, strideA, tile_first, tile_count, order);
+		changeARate<T>(kbs[1], AStreamWide, AStream, Mdim, Kdim, Ndim, batch, tile_first, tile_count, order);
+		readB<T>(B_p, kbs[2], BStream, Mdim, Kdim, Ndim, batch, strideB, tile_first, tile_count, order);
+		comp<T>(kbs[3], AStream, BStream, ABStream, AChk, BChk, abft, Mdim, Kdim, Ndim, batch, tile_first, tile_count, order);
+		abft_sums<T>(kbs[4], AChk, BChk, ChkStream, abft, Mdim, Kdim, Ndim, batch, tile_first, tile_count, order);
+		writeAB<T>(ABStream, AB_p, epi_p, epilogue, shift, act_lo, act_hi, ChkStream, chk_p, strideChk, abft, Mdim, Kdim, Ndim, batch, strideAB, tile_first, tile_count, order);
+#endif
+	}
+};
+
+// readA -> comp_sa <- readB, comp_sa -> writeAB; A reaches comp as whole beats,
+// comp_sa also sums the checksums
+template <class T>
+struct mm_body<T, true, true, false> {
+	static void run(typename T::block_t *A_p, typename T::block_t *B_p, typename T::block_t *AB_p, const unsigned *occ_p,
+	                const typename T::block_t *epi_p, int Mdim, int Kdim, int Ndim, int batch, int strideA, int strideB,
+	                int strideAB, int strideOcc, int sparse, int epilogue, int shift, int act_lo, int act_hi,
+	                int tile_first, int tile_count, int order, typename T::block_t *chk_p, int strideChk, int abft) {
+		hls::stream<typename T::block_t> AStream("AStream");
+		hls::stream<typename T::block_t> BStream("BStream");
+		hls::stream<typename T::acc_beat> ABStream("ABStream");
+		hls::stream<typename T::block_t> ChkStream("ChkStream");
+		// live k blocks for readA, readB and comp_sa
+		hls::stream<int> kbs[3];
+
+#pragma HLS DATAFLOW
+
+#ifdef MM_NATIVE
+		hls_native::dataflow({
+			{"plan", [&] { plan<T, 3>(occ_p, kbs, Mdim, Kdim, Ndim, batch, strideOcc, sparse, tile_first, tile_count, order); }},
+			{"readA", [&] { readA<T>(A_p, kbs[0], AStream, Mdim, Kdim, Ndim, batch, strideA, tile_first, tile_count, order); }},
+			{"readB", [&] { readB<T>(B_p, kbs[1], BStream, Mdim, Kdim, Ndim, batch, strideB, tile_first, tile_count, order); }},
+			{"comp", [&] { comp_sa<T>(kbs[2], AStream, BStream, ABStream, ChkStream, abft, Mdim, Kdim, Ndim, batch, tile_first, tile_count, order); }},
+			{"writeAB", [&] { writeAB<T>(ABStream, AB_p, epi_p, epilogue, shift, act_lo, act_hi, ChkStream, chk_p, strideChk, abft, Mdim, Kdim, Ndim, batch, strideAB, tile_first, tile_count, order); }},
+		});
+#else
+		plan<T, 3>(occ_p, kbs, Mdim, Kdim, Ndim, batch, strideOcc, sparse, tile_first, tile_count, order);
+		readA<T>(A_p, kbs[0], AStream, Mdim, Kdim, Ndim, batch, strideA, tile_first, tile_count, order);
+		readB<T>(B_p, kbs[1], BStream, Mdim, Kdim, Ndim, batch, strideB, tile_first, tile_count, order);
+		comp_sa<T>(kbs[2], AStream, BStream, ABStream, ChkStream, abft, Mdim, Kdim, Ndim, batch, tile_first, tile_count, order);
+		writeAB<T>(ABStream, AB_p, epi_p, epilogue, shift, act_lo, act_hi, ChkStream, chk_p, strideChk, abft, Mdim, Kdim, Ndim, batch, strideAB, tile_first, tile_count, order);
+#endif
+	}
+};
+
+// gemv_strip x 2 -> gemv_readA -> gemv_comp -> gemv_write; B is read by
+// gemv_comp itself. The even At rows are read through A_p, the odd ones
+// through A1_p, the same buffer on a second bundle (MM_TOP_SPLIT_A).
+template <class T>
+struct mm_body<T, true, false, true> {
+	static void run(typename T::block_t *A_p, typename T::block_t *A1_p, typename T::block_t *B_p,
+	                typename T::block_t *AB_p, const unsigned *occ_p, const typename T::block_t *epi_p, int Mdim,
+	                int Kdim, int Ndim, int batch, int strideA, int strideB, int strideAB, int strideOcc, int sparse,
+	                int epilogue, int shift, int act_lo, int act_hi, int tile_first, int tile_count, int order,
+	                typename T::block_t *chk_p, int strideChk, int abft) {
+		// no checksums, see the header comment
+		(void) chk_p;
+		(void) strideChk;
+		(void) abft;
+		// a row of slack per strip, so one strip's next burst overlaps the
+		// other's row being merged
+		hls::stream<typename T::block_t> AStrip[2];
+#pragma HLS stream variable=AStrip depth=2*T::PANEL_W
+		hls::stream<int> strip_kbs[2];
+		hls::stream<typename T::block_t> AStream("AStream");
+		hls::stream<typename T::acc_beat> ABStream("ABStream");
+		hls::stream<int> kbs("kbs");
+
+#pragma HLS DATAFLOW
+
+#ifdef MM_NATIVE
+		hls_native::dataflow({
+			{"readA0", [&] { gemv_strip<T>(A_p, 0, strip_kbs[0], AStrip[0], Mdim, Kdim, Ndim, batch, strideA, tile_first, tile_count, order); }},
+			{"readA1", [&] { gemv_strip<T>(A1_p, 1, strip_kbs[1], AStrip[1], Mdim, Kdim, Ndim, batch, strideA, tile_first, tile_count, order); }},
+			{"readA", [&] { gemv_readA<T>(occ_p, kbs, strip_kbs, AStrip, AStream, Mdim, Kdim, Ndim, batch, strideOcc, sparse, tile_first, tile_count, order); }},
+			{"comp", [&] { gemv_comp<T>(B_p, kbs, AStream, ABStream, Mdim, Kdim, Ndim, batch, strideB, tile_first, tile_count, order); }},
+			{"writeAB", [&] { gemv_write<T>(ABStream, AB_p, epi_p, epilogue, shift, act_lo, act_hi, Mdim, Kdim, Ndim, batch, strideAB, tile_first, tile_count, order); }},
+		});
+#else
+		gemv_strip<T>(A_p, 0, strip_kbs[0], AStrip[0], Mdim, Kdim, Ndim, batch, strideA, tile_first, tile_count, order);
+		gemv_strip<T>(A1_p, 1, strip_kbs[1], AStrip[1], Mdim, Kdim, Ndim, batch, strideA, tile_first, tile_count, order);
+		gemv_readA<T>(occ_p, kbs, strip_kbs, AStrip, AStream, Mdim, Kdim, Ndim, batch, strideOcc, sparse, tile_first, tile_count, order);
+		gemv_comp<T>(B_p, kbs, AStream, ABStream, Mdim, Kdim, Ndim, batch, strideB, tile_first, tile_count, order);
+		gemv_write<T>(ABStream, AB_p, epi_p, epilogue, shift, act_lo, act_hi, Mdim, Kdim, Ndim, batch, strideAB, tile_first, tile_count, order);
+#endif
+	}
+
+	// A top without MM_TOP_SPLIT_A reads both strips through A_p.
+	static void run(typename T::block_t *A_p, typename T::block_t *B_p, typename T::block_t *AB_p, const unsigned *occ_p,
+	                const typename T::block_t *epi_p, int Mdim, int Kdim, int Ndim, int batch, int strideA, int strideB,
+	                int strideAB, int strideOcc, int sparse, int epilogue, int shift, int act_lo, int act_hi,
+	                int tile_first, int tile_count, int order, typename T::block_t *chk_p, int strideChk, int abft) {
+		run(A_p, A_p, B_p, AB_p, occ_p, epi_p, Mdim, Kdim, Ndim, batch, strideA, strideB, strideAB, strideOcc, sparse,
+		    epilogue, shift, act_lo, act_hi, tile_first, tile_count, order, chk_p, strideChk, abft);
+	}
+};
+
+#ifdef MM_NATIVE
+#pragma GCC diagnostic pop
+#endif
+
+#endif
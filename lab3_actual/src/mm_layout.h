@@ -0,0 +1,176 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Operand layout conversion on the host.
+//
+// The kernels read A transposed (At[K][M], A_COL_MAJOR) with every row
+// padded to whole block_t beats, while most producers write row-major A.
+// mm_load_a() copies A from either layout into an operand buffer, so the
+// caller never runs a separate scalar transpose pass.
+//
+// The transpose is cache oblivious: the matrix is split along its longer
+// side until a block fits in L1, then moved as 16 byte squares (16x16
+// bytes, 8x8 halves, 4x4 words) transposed in registers with SSE2 unpack
+// sequences. Row bands are spread over the OpenMP threads. 4 bit operands
+// are packed two per byte and go element by element.
+
+#ifndef MM_LAYOUT_H
+#define MM_LAYOUT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mm_shape.h"
+
+namespace mm_layout_impl {
+
+// blocks of at most BASE x BASE elements are transposed directly
+const int BASE = 64;
+// rows per OpenMP work item
+const int BAND = 256;
+
+#if defined(__SSE2__)
+inline __m128i unpack(__m128i a, __m128i b, int bytes, bool hi) {
+    switch (bytes) {
+    case 1: return hi ? _mm_unpackhi_epi8(a, b) : _mm_unpacklo_epi8(a, b);
+    case 2: return hi ? _mm_unpackhi_epi16(a, b) : _mm_unpacklo_epi16(a, b);
+    case 4: return hi ? _mm_unpackhi_epi32(a, b) : _mm_unpacklo_epi32(a, b);
+    default: return hi ? _mm_unpackhi_epi64(a, b) : _mm_unpacklo_epi64(a, b);
+    }
+}
+
+inline int bit_reverse(int i, int n) {
+    int r = 0;
+    for (int b = 1; b < n; b <<= 1, i >>= 1)
+        r = r << 1 | (i & 1);
+    return r;
+}
+
+// Transposes one N x N square of E byte elements, N = 16 / E. Every round
+// interleaves row i with row i + N/2 at twice the previous width; with the
+// rows loaded in bit-reversed order the last round leaves column c in
+// register c.
+template <int E> inline void transpose_square(const uint8_t *src, size_t lds, uint8_t *dst, size_t ldd) {
+    const int N = 16 / E;
+    __m128i x[N], y[N];
+    for (int r = 0; r < N; r++)
+        x[r] = _mm_loadu_si128((const __m128i *) (src + bit_reverse(r, N) * lds));
+    for (int w = E; w < 16; w *= 2) {
+        for (int i = 0; i < N / 2; i++) {
+            y[2 * i] = unpack(x[i], x[i + N / 2], w, false);
+            y[2 * i + 1] = unpack(x[i], x[i + N / 2], w, true);
+        }
+        std::copy(y, y + N, x);
+    }
+    for (int c = 0; c < N; c++)
+        _mm_storeu_si128((__m128i *) (dst + c * ldd), x[c]);
+}
+#endif
+
+// dst[c][r] = src[r][c] for r in [r0, r1), c in [c0, c1); strides in bytes.
+template <int E>
+void transpose_rec(const uint8_t *src, size_t lds, uint8_t *dst, size_t ldd, int r0, int r1, int c0, int c1) {
+    if (r1 - r0 > BASE || c1 - c0 > BASE) {
+        if (r1 - r0 >= c1 - c0) {
+            int rm = r0 + (r1 - r0) / 2;
+            transpose_rec<E>(src, lds, dst, ldd, r0, rm, c0, c1);
+            transpose_rec<E>(src, lds, dst, ldd, rm, r1, c0, c1);
+        } else {
+            int cm = c0 + (c1 - c0) / 2;
+            transpose_rec<E>(src, lds, dst, ldd, r0, r1, c0, cm);
+            transpose_rec<E>(src, lds, dst, ldd, r0, r1, cm, c1);
+        }
+        return;
+    }
+    int r = r0, c;
+#if defined(__SSE2__)
+    const int N = 16 / E;
+    for (; r + N <= r1; r += N) {
+        for (c = c0; c + N <= c1; c += N)
+            transpose_square<E>(src + r * lds + c * E, lds, dst + c * ldd + r * E, ldd);
+        for (; c < c1; c++)
+            for (int rr = r; rr < r + N; rr++)
+                std::memcpy(dst + c * ldd + rr * E, src + rr * lds + c * E, E);
+    }
+#endif
+    for (; r < r1; r++)
+        for (c = c0; c < c1; c++)
+            std::memcpy(dst + c * ldd + r * E, src + r * lds + c * E, E);
+}
+
+template <int E> void transpose(const void *src, size_t lds, void *dst, size_t ldd, int rows, int cols) {
+    const uint8_t *s = (const uint8_t *) src;
+    uint8_t *d = (uint8_t *) dst;
+#pragma omp parallel for schedule(dynamic)
+    for (int r = 0; r < rows; r += BAND)
+        transpose_rec<E>(s, lds * E, d, ldd * E, r, std::min(rows, r + BAND), 0, cols);
+}
+
+} // namespace mm_layout_impl
+
+// dst[c][r] = src[r][c] for a rows x cols matrix of BITS wide elements,
+// leading dimensions in elements.
+template <int BITS> void mm_transpose(const void *src, size_t lds, void *dst, size_t ldd, int rows, int cols) {
+    static_assert(BITS == 4 || BITS == 8 || BITS == 16 || BITS == 32, "elements are 4, 8, 16 or 32 bits");
+    if (BITS == 4) {
+        // one destination row per thread, nibbles of a byte are never split
+#pragma omp parallel for
+        for (int c = 0; c < cols; c++)
+            for (int r = 0; r < rows; r++)
+                mm_elem<4>::set_raw(dst, (size_t) c * ldd + r, mm_elem<4>::get_raw(src, (size_t) r * lds + c));
+    } else {
+        mm_layout_impl::transpose<(BITS < 8 ? 1 : BITS / 8)>(src, lds, dst, ldd, rows, cols);
+    }
+}
+
+inline bool parse_a_layout(const std::string &s, a_layout_t &layout) {
+    if (s == "rows")
+        layout = A_ROW_MAJOR;
+    else if (s == "cols")
+        layout = A_COL_MAJOR;
+    else
+        return false;
+    return true;
+}
+
+// Copies the M x K matrix A at src, stored in src_layout with leading
+// dimension ld (elements), into the operand buffer A of shape, in
+// shape.a_layout and with its padded stride.
+inline void mm_load_a(const mm_shape &shape, void *A, const void *src, a_layout_t src_layout, size_t ld) {
+    int rows = src_layout == A_COL_MAJOR ? shape.K : shape.M;
+    int cols = src_layout == A_COL_MAJOR ? shape.M : shape.K;
+    if (src_layout != shape.a_layout) {
+        mm_transpose<mm_t::in_bits>(src, ld, A, shape.lda(), rows, cols);
+    } else if (mm_t::in_bits == 4) {
+        for (int r = 0; r < rows; r++)
+            for (int c = 0; c < cols; c++)
+                mm_elem<4>::set_raw(A, (size_t) r * shape.lda() + c, mm_elem<4>::get_raw(src, (size_t) r * ld + c));
+    } else {
+        size_t row_bytes = (size_t) cols * mm_t::in_bits / 8;
+        for (int r = 0; r < rows; r++)
+            std::memcpy((char *) A + (size_t) r * shape.lda() * mm_t::in_bits / 8,
+                        (const char *) src + (size_t) r * ld * mm_t::in_bits / 8, row_bytes);
+    }
+}
+
+#endif
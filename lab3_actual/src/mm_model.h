@@ -0,0 +1,377 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Analytical cycle and DRAM traffic model of the mm kernels.
+//
+// Every kernel version is described by its loop nest, walked tile by tile
+// exactly like the kernel walks it (edge tiles included), with these costs:
+//   - a pipelined loop of n trips costs n * II + pipe_depth cycles
+//   - a loop that is not pipelined costs its body latency on every trip
+//   - a burst (contiguous beats in a pipelined loop) costs mem_latency once,
+//     then one beat per cycle
+//   - scattered accesses in a pipelined loop are single beat transactions,
+//     at most `outstanding` of them in flight, so each one costs
+//     max(1, mem_latency / outstanding) cycles
+//   - v0/v1 share one m_axi bundle for A, B and AB; v2 and later use gmem0,
+//     gmem1 and gmem2, and mm_gemv splits A over gmem0 and gmem3
+//   - mm_v4/mm_v5/mm_gemv stages overlap (DATAFLOW), the slowest stage sets
+//     the time
+//
+// The hw defaults were fitted to the v0-v2 times at 512^3 / 200 MHz measured
+// in the lab 2 report, before those kernels moved onto mm_kernel.h, to
+// within about 10%, which is good enough to rank variants. Kernel constants (M, PORT_WIDTH_B, element types, panel counts) default
+// to the values in the sources and can be read from a kernel file with
+// parse_kernel().
+
+#ifndef MM_MODEL_H
+#define MM_MODEL_H
+
+#include <algorithm>
+#include <fstream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "mm_shape.h"
+
+struct mm_model_hw {
+    double clock_mhz = 200;
+    int mem_latency = 64; // cycles from request to first beat
+    int outstanding = 16; // single beat requests in flight per port
+    int pipe_depth = 4;   // fill/drain of a pipelined loop
+    int mac_latency = 7;  // load, multiply, add, store of an unpipelined MAC
+};
+
+struct mm_model_kernel {
+    int M = 256;            // tile size
+    int port_bytes = 64;    // PORT_WIDTH_B of the wide ports
+    int in_bits = 16;       // A and B elements (DTYPE, or the mm_config.h flags of mm_v4/v5)
+    int out_bits = 16;      // AB elements
+    int a_panels = 1;       // MM_A_PANELS, MM_B_PANELS and MM_PANEL_K of mm_v4
+    int b_panels = 1;
+    int panel_k = 1024;
+    tile_order_t order = TILE_ROWS; // tile traversal of mm_v4 launches
+    int sa_rows = 32;       // MM_SA_ROWS x MM_SA_COLS PEs of mm_v5
+    int sa_cols = 32;
+    int gemv_n = 16;        // MM_GEMV_N B columns per A element of mm_gemv
+    int gemv_panel_k = 8192; // MM_GEMV_PANEL_K rows of its on-chip B chunk
+
+    int in_per_port() const { return port_bytes * 8 / in_bits; }
+    int out_per_port() const { return port_bytes * 8 / out_bits; }
+};
+
+struct mm_model_stage {
+    std::string name;
+    double cycles;
+};
+
+struct mm_model_result {
+    std::string version;
+    double cycles = 0;
+    double bytes[4] = {0, 0, 0, 0}; // gmem0/1/2/3, or everything on gmem0 if shared_port
+    bool shared_port = false;
+    std::vector<mm_model_stage> stages; // DATAFLOW stages, empty otherwise
+
+    double total_bytes() const { return bytes[0] + bytes[1] + bytes[2] + bytes[3]; }
+    double seconds(const mm_model_hw &hw) const { return cycles / (hw.clock_mhz * 1e6); }
+
+    // Stage that limits a dataflow kernel, -1 for sequential kernels.
+    int bottleneck() const {
+        int worst = -1;
+        for (int s = 0; s < (int) stages.size(); s++)
+            if (worst < 0 || stages[s].cycles > stages[worst].cycles)
+                worst = s;
+        return worst;
+    }
+};
+
+// Reads the tile and port constants from a kernel source file: the literal
+// members of its mm_cfg, or the -D flag defaults of mm_v4/mm_v5. Values
+// that are not found keep their defaults. Returns false if the file can't
+// be read.
+inline bool parse_kernel(const std::string &path, mm_model_kernel &k) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::string src((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::smatch m;
+    if (std::regex_search(src, m, std::regex("const\\s+int\\s+M\\s*=\\s*(\\d+)\\s*;")))
+        k.M = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("const\\s+int\\s+PORT_WIDTH_B\\s*=\\s*(\\d+)\\s*;")))
+        k.port_bytes = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("#define\\s+MM_A_PANELS\\s+(\\d+)")))
+        k.a_panels = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("#define\\s+MM_B_PANELS\\s+(\\d+)")))
+        k.b_panels = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("#define\\s+MM_PANEL_K\\s+(\\d+)")))
+        k.panel_k = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("#define\\s+MM_SA_ROWS\\s+(\\d+)")))
+        k.sa_rows = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("#define\\s+MM_SA_COLS\\s+(\\d+)")))
+        k.sa_cols = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("#define\\s+MM_GEMV_PANEL_K\\s+(\\d+)")))
+        k.gemv_panel_k = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("\\bGEMV_N\\s*=\\s*(\\d+)\\s*;")))
+        k.gemv_n = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("\\bA_PANELS\\s*=\\s*(\\d+)\\s*;")))
+        k.a_panels = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("\\bB_PANELS\\s*=\\s*(\\d+)\\s*;")))
+        k.b_panels = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("\\bPANEL_K\\s*=\\s*(\\d+)\\s*;")))
+        k.panel_k = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("\\bSA_ROWS\\s*=\\s*(\\d+)\\s*;")))
+        k.sa_rows = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("\\bSA_COLS\\s*=\\s*(\\d+)\\s*;")))
+        k.sa_cols = std::stoi(m[1]);
+    if (std::regex_search(src, m, std::regex("typedef\\s+([\\w ]+?)\\s+DTYPE\\s*;"))) {
+        std::string t = m[1];
+        if (t.find("char") != std::string::npos)
+            k.in_bits = 8;
+        else if (t.find("short") != std::string::npos)
+            k.in_bits = 16;
+        else if (t.find("long") != std::string::npos || t == "double")
+            k.in_bits = 64;
+        else
+            k.in_bits = 32;
+        k.out_bits = k.in_bits;
+    }
+    return true;
+}
+
+namespace mm_model_impl {
+
+struct ctx {
+    const mm_shape &s;
+    const mm_model_kernel &k;
+    const mm_model_hw &hw;
+
+    int tiles(int dim) const { return (dim + k.M - 1) / k.M; }
+    int tile_len(int dim, int t) const { return std::min(k.M, dim - t * k.M); }
+    int beats(int len) const { return (len + k.in_per_port() - 1) / k.in_per_port(); }
+    int out_beats(int len) const { return (len + k.out_per_port() - 1) / k.out_per_port(); }
+
+    double pipelined(double trips, double ii = 1) const { return trips > 0 ? trips * ii + hw.pipe_depth : 0; }
+    double burst(double nbeats) const { return pipelined(nbeats) + hw.mem_latency; }
+    double scattered(double trips) const {
+        return trips * std::max(1.0, (double) hw.mem_latency / hw.outstanding) + hw.mem_latency + hw.pipe_depth;
+    }
+};
+
+// v0-v2: the sequential design reading A row-major, one scattered beat per
+// element. v0 leaves AB_block unpartitioned, so each unrolled row of MACs
+// waits on two BRAM ports; v0/v1 put every port on gmem0.
+inline mm_model_result v0_v2(const ctx &c, int version) {
+    mm_model_result r;
+    r.version = "v" + std::to_string(version);
+    r.shared_port = version < 2;
+    const int M = c.k.M, pb = c.k.port_bytes;
+    const int b_port = r.shared_port ? 0 : 1, ab_port = r.shared_port ? 0 : 2;
+    for (int ib = 0; ib < c.tiles(c.s.M); ib++) {
+        int i_cnt = c.tile_len(c.s.M, ib);
+        double macs = version == 0 ? i_cnt * (M / 2.0 + c.hw.mac_latency) : c.pipelined(i_cnt);
+        for (int jb = 0; jb < c.tiles(c.s.N); jb++) {
+            int jj_cnt = c.beats(c.tile_len(c.s.N, jb)), jj_out = c.out_beats(c.tile_len(c.s.N, jb));
+            r.cycles += c.pipelined(M);
+            for (int kb = 0; kb < c.tiles(c.s.K); kb++) {
+                int k_cnt = c.tile_len(c.s.K, kb);
+                r.cycles += k_cnt * (c.burst(M / c.k.in_per_port()) + c.scattered(i_cnt) + macs);
+                r.bytes[0] += (double) k_cnt * i_cnt * pb;
+                r.bytes[b_port] += (double) k_cnt * jj_cnt * pb;
+            }
+            r.cycles += i_cnt * c.burst(jj_out);
+            r.bytes[ab_port] += (double) i_cnt * jj_out * pb;
+        }
+    }
+    return r;
+}
+
+// v3: A, B and AB all wide, A transposed so every k row is one burst.
+inline mm_model_result v3(const ctx &c) {
+    mm_model_result r;
+    r.version = "v3";
+    const int M = c.k.M, pb = c.k.port_bytes;
+    for (int ib = 0; ib < c.tiles(c.s.M); ib++) {
+        int i_cnt = c.tile_len(c.s.M, ib);
+        int ii_cnt = c.beats(i_cnt);
+        for (int jb = 0; jb < c.tiles(c.s.N); jb++) {
+            int jj_cnt = c.beats(c.tile_len(c.s.N, jb)), jj_out = c.out_beats(c.tile_len(c.s.N, jb));
+            r.cycles += c.pipelined(M);
+            for (int kb = 0; kb < c.tiles(c.s.K); kb++) {
+                int k_cnt = c.tile_len(c.s.K, kb);
+                r.cycles += k_cnt * (c.burst(M / c.k.in_per_port()) + c.burst(ii_cnt) + c.pipelined(i_cnt));
+                r.bytes[0] += (double) k_cnt * ii_cnt * pb;
+                r.bytes[1] += (double) k_cnt * jj_cnt * pb;
+            }
+            r.cycles += i_cnt * c.burst(jj_out);
+            r.bytes[2] += (double) i_cnt * jj_out * pb;
+        }
+    }
+    return r;
+}
+
+// Round robin panel cache of readA / readB, returns true on a hit.
+struct panel_cache {
+    std::vector<int> tag;
+    int victim = 0;
+
+    explicit panel_cache(int panels) : tag(panels, -1) {}
+
+    bool access(int key, bool keep) {
+        if (std::find(tag.begin(), tag.end(), key) != tag.end())
+            return true;
+        if (keep) {
+            tag[victim] = key;
+            victim = (victim + 1) % (int) tag.size();
+        }
+        return false;
+    }
+};
+
+// v4: readA -> changeARate -> comp <- readB, comp -> writeAB, all overlapped.
+// Resident A/B panels are replayed without touching gmem.
+inline mm_model_result v4(const ctx &c) {
+    mm_model_result r;
+    r.version = "v4";
+    const int M = c.k.M, pb = c.k.port_bytes, dpp = c.k.in_per_port();
+    const bool keep = c.s.K <= c.k.panel_k;
+    double read_a = 0, change_rate = 0, read_b = 0, comp = 0, write_ab = 0;
+    panel_cache a_panels(c.k.a_panels), b_panels(c.k.b_panels);
+    int tm = c.tiles(c.s.M), tn = c.tiles(c.s.N);
+    for (int t = 0; t < tm * tn; t++) {
+        int ib = c.k.order == TILE_COLS ? t % tm : t / tn;
+        int jb = c.k.order == TILE_COLS ? t / tm : t % tn;
+        int i_cnt = c.tile_len(c.s.M, ib);
+        int ii_cnt = c.beats(i_cnt);
+        int jj_cnt = c.beats(c.tile_len(c.s.N, jb)), jj_out = c.out_beats(c.tile_len(c.s.N, jb));
+
+        bool a_hit = a_panels.access(ib, keep), b_hit = b_panels.access(jb, keep);
+        read_a += c.s.K * (a_hit ? c.pipelined(ii_cnt) : c.burst(ii_cnt));
+        read_b += c.s.K * (b_hit ? c.pipelined(jj_cnt) : c.burst(jj_cnt));
+        r.bytes[0] += a_hit ? 0 : (double) c.s.K * ii_cnt * pb;
+        r.bytes[1] += b_hit ? 0 : (double) c.s.K * jj_cnt * pb;
+
+        // the beat loop isn't pipelined, only the lane loop inside it
+        change_rate += (double) c.s.K * ii_cnt * c.pipelined(dpp);
+        comp += c.pipelined(M) + c.s.K * (c.pipelined(M / dpp) + c.pipelined(i_cnt)) + i_cnt * c.pipelined(jj_out);
+        write_ab += i_cnt * c.burst(jj_out);
+        r.bytes[2] += (double) i_cnt * jj_out * pb;
+    }
+    r.stages = {{"readA", read_a}, {"changeARate", change_rate}, {"readB", read_b}, {"comp", comp}, {"writeAB", write_ab}};
+    return r;
+}
+
+// v5: same feeders as v4, comp loads a k-block of A and B, then sweeps an
+// sa_rows x sa_cols systolic array over every sub-block of the tile.
+inline mm_model_result v5(const ctx &c) {
+    mm_model_result r = v4(c);
+    r.version = "v5";
+    const int M = c.k.M, dpp = c.k.in_per_port(), R = c.k.sa_rows, C = c.k.sa_cols;
+    double comp = 0;
+    for (int ib = 0; ib < c.tiles(c.s.M); ib++) {
+        int i_cnt = c.tile_len(c.s.M, ib);
+        for (int jb = 0; jb < c.tiles(c.s.N); jb++) {
+            int j_cnt = c.tile_len(c.s.N, jb);
+            int blocks = ((i_cnt + R - 1) / R) * ((j_cnt + C - 1) / C);
+            for (int kb = 0; kb < c.tiles(c.s.K); kb++) {
+                int k_cnt = c.tile_len(c.s.K, kb);
+                comp += 2 * k_cnt * c.pipelined(M / dpp);
+                comp += blocks * (2 * c.pipelined(R) + c.pipelined(k_cnt + R + C - 2));
+            }
+            comp += i_cnt * c.pipelined(c.out_beats(j_cnt));
+        }
+    }
+    // no changeARate stage, A arrives as whole beats
+    r.stages = {r.stages[0], r.stages[2], {"comp", comp}, r.stages[4]};
+    return r;
+}
+
+// gemv: gemv_strip x 2 -> gemv_readA -> gemv_comp -> gemv_write. A streams
+// once per column chunk, comp loads the chunk's B rows unless they are still
+// resident and spends one cycle per A beat and gemv_n columns of the chunk.
+inline mm_model_result gemv(const ctx &c) {
+    mm_model_result r;
+    r.version = "gemv";
+    const int M = c.k.M, pb = c.k.port_bytes, dpp = c.k.in_per_port();
+    const int chunk = std::max(c.k.gemv_n, c.k.out_per_port());
+    const bool keep = c.s.K <= c.k.gemv_panel_k;
+    double read_a = 0, comp = 0, write_ab = 0;
+    int resident = -1;
+    int tm = c.tiles(c.s.M), tn = c.tiles(c.s.N);
+    for (int t = 0; t < tm * tn; t++) {
+        int ib = c.k.order == TILE_COLS ? t % tm : t / tn;
+        int jb = c.k.order == TILE_COLS ? t / tm : t % tn;
+        int i_cnt = c.tile_len(c.s.M, ib), j_cnt = c.tile_len(c.s.N, jb);
+        int ii_cnt = c.beats(i_cnt);
+        for (int j = 0; j < j_cnt; j += chunk) {
+            int j0 = jb * M + j, cw = std::min(chunk, j_cnt - j);
+            int passes = (cw + c.k.gemv_n - 1) / c.k.gemv_n, out = c.out_beats(cw);
+            // even rows on gmem0, odd rows on gmem3, each strip one burst
+            // per row; the merge passes at most a beat per cycle
+            int even = (c.s.K + 1) / 2;
+            read_a += std::max(even * c.burst(ii_cnt), c.pipelined((double) c.s.K * ii_cnt));
+            r.bytes[0] += (double) even * ii_cnt * pb;
+            r.bytes[3] += (double) (c.s.K - even) * ii_cnt * pb;
+            if (!keep || j0 != resident) {
+                int b_beats = (j0 + chunk - 1) / dpp - j0 / dpp + 1;
+                comp += c.s.K * c.burst(b_beats);
+                r.bytes[1] += (double) c.s.K * b_beats * pb;
+                resident = keep ? j0 : -1;
+            }
+            comp += c.pipelined(M) + c.s.K * c.pipelined((double) ii_cnt * passes) + i_cnt * c.pipelined(out);
+            write_ab += i_cnt * c.burst(out);
+            r.bytes[2] += (double) i_cnt * out * pb;
+        }
+    }
+    r.stages = {{"readA", read_a}, {"comp", comp}, {"writeAB", write_ab}};
+    return r;
+}
+
+} // namespace mm_model_impl
+
+// Models one launch of `batch` problems.
+inline mm_model_result mm_model(const std::string &version, const mm_shape &shape, const mm_model_kernel &k,
+                                const mm_model_hw &hw, int batch = 1) {
+    mm_model_impl::ctx c{shape, k, hw};
+    mm_model_result r;
+    if (version == "v0" || version == "v1" || version == "v2")
+        r = mm_model_impl::v0_v2(c, version[1] - '0');
+    else if (version == "v3")
+        r = mm_model_impl::v3(c);
+    else if (version == "v4")
+        r = mm_model_impl::v4(c);
+    else if (version == "v5")
+        r = mm_model_impl::v5(c);
+    else if (version == "gemv")
+        r = mm_model_impl::gemv(c);
+    else
+        return r;
+    r.cycles *= batch;
+    for (auto &b : r.bytes)
+        b *= batch;
+    for (auto &s : r.stages)
+        s.cycles *= batch;
+    // dataflow: slowest stage plus the time for the first data to reach it
+    if (!r.stages.empty())
+        r.cycles = r.stages[r.bottleneck()].cycles + hw.mem_latency + (double) r.stages.size() * hw.pipe_depth;
+    return r;
+}
+
+inline const std::vector<std::string> &mm_model_versions() {
+    static const std::vector<std::string> v = {"v0", "v1", "v2", "v3", "v4", "v5", "gemv"};
+    return v;
+}
+
+#endif
@@ -0,0 +1,250 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Out-of-core GEMM over matrices kept in files.
+//
+// mm_operands sizes every buffer as a whole matrix. mm_ooc instead cuts
+// C = A B into panels: every C panel is the sum over the K panels of a
+// block-row of A times a block-column of B, each product one launch on
+// panel sized operands. The launches run through mm_stream, so a bounded
+// pool of buffer sets serves any problem size, and while the kernel
+// computes one product the panels of the next are read from their files
+// and synced in, and the previous result comes back and is added into the
+// C panel on a helper thread, which writes the panel to its file after its
+// last K panel. Panels are the largest tile multiples that let the pool
+// fit the memory budget, evened out over each dimension so the edges waste
+// little.
+//
+// Files hold raw row-major elements in their storage types
+// (mm_file_matrix). Integers add up their K partials modulo 2^out_bits,
+// equal to the kernel's single pass whenever out_bits <= acc_bits; float
+// adds them in float. Half and ap_fixed round every partial, 4 bit
+// elements share bytes across panel edges; neither is supported.
+
+#ifndef MM_OOC_H
+#define MM_OOC_H
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mm_layout.h"
+#include "mm_stream.h"
+#include "mm_trace.h"
+
+// A rows x cols matrix of `bits` wide elements stored row-major in a file.
+class mm_file_matrix {
+public:
+    // With create the file is (re)sized to the matrix, otherwise it has to
+    // hold one already.
+    mm_file_matrix(const std::string &path, int rows, int cols, int bits, bool create)
+        : path(path), rows(rows), cols(cols), elem_bytes(bits / 8) {
+        if (bits % 8)
+            throw std::invalid_argument("mm_file_matrix: elements of whole bytes only");
+        fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+        if (fd < 0)
+            throw std::runtime_error("mm_file_matrix: cannot open " + path);
+        off_t size = (off_t) rows * cols * elem_bytes;
+        if (create ? ::ftruncate(fd, size) != 0 : ::lseek(fd, 0, SEEK_END) != size) {
+            ::close(fd);
+            throw std::runtime_error("mm_file_matrix: " + path + " does not hold a " + std::to_string(rows) + " x " +
+                                     std::to_string(cols) + " matrix");
+        }
+    }
+    ~mm_file_matrix() { ::close(fd); }
+    mm_file_matrix(const mm_file_matrix &) = delete;
+    mm_file_matrix &operator=(const mm_file_matrix &) = delete;
+
+    // The block rows x cols at (r0, c0) into dst, leading dimension ld
+    // (elements), zero where it runs past the matrix.
+    void read(int r0, int c0, int nrows, int ncols, void *dst, size_t ld) const {
+        int valid_rows = std::max(0, std::min(nrows, rows - r0)), valid_cols = std::max(0, std::min(ncols, cols - c0));
+        for (int r = 0; r < nrows; r++) {
+            char *row = (char *) dst + (size_t) r * ld * elem_bytes;
+            size_t got = r < valid_rows ? (size_t) valid_cols * elem_bytes : 0;
+            if (got)
+                io(::pread, row, got, offset(r0 + r, c0));
+            std::memset(row + got, 0, (size_t) ncols * elem_bytes - got);
+        }
+    }
+
+    // The block rows x cols at (r0, c0) from src, which must lie inside
+    // the matrix.
+    void write(int r0, int c0, int nrows, int ncols, const void *src, size_t ld) {
+        for (int r = 0; r < nrows; r++)
+            io(::pwrite, (char *) src + (size_t) r * ld * elem_bytes, (size_t) ncols * elem_bytes,
+               offset(r0 + r, c0));
+    }
+
+    // Asks the OS to read rows [r0, r0 + nrows) ahead.
+    void prefetch(int r0, int nrows) const {
+        if (r0 < rows)
+            ::posix_fadvise(fd, offset(r0, 0), (off_t) std::min(nrows, rows - r0) * cols * elem_bytes,
+                            POSIX_FADV_WILLNEED);
+    }
+
+    std::string path;
+    int rows, cols;
+
+private:
+    off_t offset(int r, int c) const { return ((off_t) r * cols + c) * elem_bytes; }
+
+    template <class F, class P> void io(F f, P p, size_t bytes, off_t at) const {
+        while (bytes > 0) {
+            ssize_t n = f(fd, p, bytes, at);
+            if (n <= 0)
+                throw std::runtime_error("mm_file_matrix: I/O error on " + path);
+            p += n;
+            bytes -= n;
+            at += n;
+        }
+    }
+
+    int elem_bytes;
+    int fd;
+};
+
+// K partials add modulo 2^out_bits for the exact families, in float
+// otherwise.
+template <class T, bool EXACT = T::exact> struct mm_ooc_impl {
+    static bool supported() { return T::frac_bits == 0 && T::in_bits >= 8 && T::out_bits <= T::acc_bits; }
+    static mm_out_t add(mm_out_t a, mm_out_t b) { return (mm_out_t) ((int64_t) a + b); }
+};
+
+template <class T> struct mm_ooc_impl<T, false> {
+    static bool supported() { return T::in_bits == 32; }
+    static mm_out_t add(mm_out_t a, mm_out_t b) { return a + b; }
+};
+
+inline bool mm_ooc_supported() { return mm_ooc_impl<mm_t>::supported(); }
+
+struct mm_ooc_stats {
+    long jobs;         // panel products launched
+    double seconds;    // first read to last C panel written
+    double read_busy;  // reading and syncing in operand panels
+    double write_busy; // adding up results and writing C panels
+};
+
+class mm_ooc {
+public:
+    // budget_bytes bounds the nbuf operand sets of the pool.
+    mm_ooc(mm_backend &backend, const mm_shape &shape, size_t budget_bytes, int nbuf = 3,
+           mm_bo_mode mode = BO_DEVICE)
+        : shape(shape), panel_shape(panel_of(shape, budget_bytes, nbuf)),
+          stream(backend, panel_shape, nbuf, mode) {
+        if (!mm_ooc_supported())
+            throw std::invalid_argument("mm_ooc: element types do not add up K partials exactly");
+    }
+
+    // Largest tile multiple c for which nbuf c x c x c operand sets fit the
+    // budget, then each dimension split evenly into panels of at most c.
+    static mm_shape panel_of(const mm_shape &shape, size_t budget_bytes, int nbuf) {
+        auto round = [](int d) { return (d + TILE_DIM - 1) / TILE_DIM * TILE_DIM; };
+        auto fit = [&](int c) {
+            mm_shape p{std::min(round(shape.M), c), std::min(round(shape.K), c), std::min(round(shape.N), c),
+                       A_COL_MAJOR};
+            return (double) nbuf * (p.a_bytes() + p.b_bytes() + p.ab_bytes()) <= (double) budget_bytes;
+        };
+        int c = round(std::max(shape.M, std::max(shape.K, shape.N)));
+        while (c > TILE_DIM && !fit(c))
+            c -= TILE_DIM;
+        if (!fit(c))
+            throw std::invalid_argument("mm_ooc: budget below one tile sized panel");
+        auto even = [&](int d) {
+            int n = (d + c - 1) / c;
+            return round((d + n - 1) / n);
+        };
+        return mm_shape{even(shape.M), even(shape.K), even(shape.N), A_COL_MAJOR};
+    }
+
+    const mm_shape &panel() const { return panel_shape; }
+    int panel_rows() const { return (shape.M + panel_shape.M - 1) / panel_shape.M; }
+    int panel_depth() const { return (shape.K + panel_shape.K - 1) / panel_shape.K; }
+    int panel_cols() const { return (shape.N + panel_shape.N - 1) / panel_shape.N; }
+    long num_jobs() const { return (long) panel_rows() * panel_cols() * panel_depth(); }
+
+    // Relative tolerance of float results against the single pass
+    // reference: every K panel regroups the sum.
+    double tolerance() const { return mm_t::tolerance * panel_depth(); }
+
+    // C = A B, the files shaped M x K, K x N and M x N.
+    mm_ooc_stats run(const mm_file_matrix &A, const mm_file_matrix &B, mm_file_matrix &C) {
+        typedef std::chrono::high_resolution_clock clock;
+        typedef mm_ooc_impl<mm_t> impl;
+        if (A.rows != shape.M || A.cols != shape.K || B.rows != shape.K || B.cols != shape.N ||
+            C.rows != shape.M || C.cols != shape.N)
+            throw std::invalid_argument("mm_ooc: files do not match the shape");
+
+        const mm_shape &p = panel_shape;
+        int nk = panel_depth(), nj = panel_cols();
+        std::vector<mm_in_t> staging((size_t) p.M * p.K);
+        std::vector<mm_out_t> acc(p.ab_elems());
+        mm_ooc_stats stats = {num_jobs(), 0, 0, 0};
+
+        // job = (ib * nj + jb) * nk + kb
+        auto produce = [&](int job, mm_in_t *pa, mm_in_t *pb) {
+            auto t0 = clock::now();
+            int kb = job % nk, jb = job / nk % nj, ib = job / nk / nj;
+            {
+                mm_trace_scope trace("ooc read");
+                A.read(ib * p.M, kb * p.K, p.M, p.K, staging.data(), p.K);
+                B.read(kb * p.K, jb * p.N, p.K, p.N, pb, p.ldb());
+                // the block-row of A of the next C panel
+                if (kb == nk - 1 && jb == nj - 1)
+                    A.prefetch((ib + 1) * p.M, p.M);
+            }
+            {
+                mm_trace_scope trace("layout");
+                mm_load_a(p, pa, staging.data(), A_ROW_MAJOR, p.K);
+            }
+            stats.read_busy += std::chrono::duration<double>(clock::now() - t0).count();
+        };
+        auto consume = [&](int job, const mm_out_t *pab) {
+            auto t0 = clock::now();
+            mm_trace_scope trace("ooc write");
+            int kb = job % nk, jb = job / nk % nj, ib = job / nk / nj;
+            if (kb == 0)
+                std::copy(pab, pab + acc.size(), acc.begin());
+            else
+                for (size_t e = 0; e < acc.size(); e++)
+                    acc[e] = impl::add(acc[e], pab[e]);
+            if (kb == nk - 1) {
+                int i0 = ib * p.M, j0 = jb * p.N;
+                C.write(i0, j0, std::min(p.M, shape.M - i0), std::min(p.N, shape.N - j0), acc.data(), p.ldab());
+            }
+            stats.write_busy += std::chrono::duration<double>(clock::now() - t0).count();
+        };
+
+        auto start = clock::now();
+        stream.run((int) num_jobs(), produce, consume);
+        stats.seconds = std::chrono::duration<double>(clock::now() - start).count();
+        return stats;
+    }
+
+private:
+    mm_shape shape;
+    mm_shape panel_shape;
+    mm_stream stream;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Host reference results for the element types of mm_types.h.
+//
+// The original int16 types go through the packed GEMM of mm_sw.h. Other
+// exact types (integers, ap_fixed) work on the raw bits: they sum modulo
+// 2^32 when the kernel's accumulator is at most 32 bits wide (only those
+// low bits survive anyway) and exactly in 64 bits otherwise, then wrap the
+// sum the way the kernel's accumulator and output do, so the comparison
+// with the kernel stays bit exact. Float and half are summed in float in
+// the kernel's k order and compared within mm_t::tolerance. Results with
+// a fused epilogue take the generic paths, with the epilogue applied to
+// every finished sum as the kernel's writeAB does.
+
+#ifndef MM_REF_H
+#define MM_REF_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "mm_shape.h"
+#include "mm_sw.h"
+
+// Bias and scale words of column j, unused without an epilogue.
+struct mm_ref_epilogue {
+    const mm_epilogue &e;
+    const uint32_t *bias, *scale;
+
+    uint32_t b(int j) const { return bias ? bias[j] : 0; }
+    uint32_t s(int j) const { return scale ? scale[j] : 0; }
+};
+
+template <class T> struct mm_ref_raw {
+    typedef typename std::conditional<T::acc_bits <= 32, uint32_t, int64_t>::type sum_t;
+
+    static void run(const mm_shape &s, const void *A, const void *B, void *AB, const mm_ref_epilogue &epi) {
+        // B unpacked once, narrow types included
+        std::vector<int32_t> b((size_t) s.K * s.N);
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < s.K; k++)
+            for (int j = 0; j < s.N; j++)
+                b[(size_t) k * s.N + j] = (int32_t) T::in::get_raw(B, s.b_index(k, j));
+
+#pragma omp parallel
+        {
+            std::vector<sum_t> acc(s.N);
+#pragma omp for schedule(static)
+            for (int i = 0; i < s.M; i++) {
+                std::fill(acc.begin(), acc.end(), 0);
+                for (int k = 0; k < s.K; k++) {
+                    sum_t a = (sum_t) T::in::get_raw(A, s.a_index(i, k));
+                    if (a == 0)
+                        continue;
+                    const int32_t *row = &b[(size_t) k * s.N];
+                    sum_t *out = acc.data();
+#pragma omp simd
+                    for (int j = 0; j < s.N; j++)
+                        out[j] += a * (sum_t) row[j];
+                }
+                for (int j = 0; j < s.N; j++)
+                    T::out::set_raw(AB, s.ab_index(i, j), T::result((int64_t) acc[j], epi.b(j), epi.s(j), epi.e));
+            }
+        }
+    }
+};
+
+template <class T, bool EXACT = T::exact> struct mm_ref : mm_ref_raw<T> {};
+
+template <class T> struct mm_ref<T, false> {
+    static void run(const mm_shape &s, const void *A, const void *B, void *AB, const mm_ref_epilogue &epi) {
+        std::vector<float> b((size_t) s.K * s.N);
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < s.K; k++)
+            for (int j = 0; j < s.N; j++)
+                b[(size_t) k * s.N + j] = (float) T::in::get(B, s.b_index(k, j));
+
+#pragma omp parallel
+        {
+            std::vector<float> acc(s.N);
+#pragma omp for schedule(static)
+            for (int i = 0; i < s.M; i++) {
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                for (int k = 0; k < s.K; k++) {
+                    float a = (float) T::in::get(A, s.a_index(i, k));
+                    const float *row = &b[(size_t) k * s.N];
+                    float *out = acc.data();
+#pragma omp simd
+                    for (int j = 0; j < s.N; j++)
+                        out[j] += a * row[j];
+                }
+                for (int j = 0; j < s.N; j++)
+                    T::out::set(AB, s.ab_index(i, j), mm_epilogue_float(acc[j], epi.b(j), epi.s(j), epi.e));
+            }
+        }
+    }
+};
+
+template <> struct mm_ref<mm_types<16, 16, 16>, true> {
+    static void run(const mm_shape &s, const void *A, const void *B, void *AB, const mm_ref_epilogue &epi) {
+        if (epi.e.flags) {
+            mm_ref_raw<mm_types<16, 16, 16>>::run(s, A, B, AB, epi);
+            return;
+        }
+        typedef mm_sw_impl::DTYPE DTYPE;
+        mm_sw((const DTYPE *) A, (const DTYPE *) B, (DTYPE *) AB, s.M, s.K, s.N, s.a_layout, s.lda(), s.ldb(),
+              s.ldab());
+    }
+};
+
+// AB = A * B for one problem laid out as described by shape, computed the
+// way the kernel built with the same element type flags computes it,
+// finished with epilogue e and its per-column bias / scale words.
+inline void mm_golden(const mm_shape &shape, const mm_in_t *A, const mm_in_t *B, mm_out_t *AB,
+                      const mm_epilogue &e = mm_epilogue(), const uint32_t *bias = nullptr,
+                      const uint32_t *scale = nullptr) {
+    mm_ref<mm_t>::run(shape, A, B, AB, mm_ref_epilogue{e, bias, scale});
+}
+
+// Whether a kernel result hw is acceptable for the reference result sw:
+// equal for the exact types, within tol relative to max(1, |sw|) otherwise
+// (sums that cancel would make a purely relative bound meaningless).
+inline bool mm_close(double sw, double hw, double tol = mm_t::tolerance) {
+    if (tol == 0)
+        return sw == hw;
+    return std::fabs(hw - sw) <= tol * std::max(1.0, std::fabs(sw));
+}
+
+#endif
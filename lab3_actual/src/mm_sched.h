@@ -0,0 +1,155 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Tile scheduler for one GEMM over several compute units.
+//
+// A unit is any backend that runs one launch at a time: a CU of an xclbin
+// (possibly on another device) or a CPU backend instance. Every unit gets
+// its own copy of A and B and its own AB buffer. The output tile grid is
+// handed out in chunks of `chunk` consecutive tiles from a shared counter,
+// so a unit asks for more work as soon as it finishes and faster units end
+// up computing more tiles. Each finished chunk is synced back and copied
+// into the shared host result. A unit that fails stops the hand-out; run()
+// waits for the others and rethrows the failure.
+
+#ifndef MM_SCHED_H
+#define MM_SCHED_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "mm_backend.h"
+
+struct mm_sched_stats {
+    double seconds;
+    std::vector<int> tiles_per_unit;
+};
+
+class mm_sched {
+public:
+    mm_sched(const std::vector<mm_backend *> &units, const mm_shape &shape, int chunk = 1,
+             mm_bo_mode mode = BO_DEVICE)
+        : units(units), shape(shape), chunk(chunk),
+          a(mm_buffer::host(shape.a_bytes())),
+          b(mm_buffer::host(shape.b_bytes())),
+          ab(mm_buffer::host(shape.ab_bytes())) {
+        if (units.empty() || chunk < 1)
+            throw std::invalid_argument("mm_sched: need at least one unit and a positive chunk");
+        for (mm_backend *u : units)
+            ops.emplace_back(*u, shape, 1, mode);
+    }
+
+    int num_units() const { return (int) units.size(); }
+
+    // Host operands, laid out as described by shape.
+    mm_in_t *A() const { return a.data<mm_in_t>(); }
+    mm_in_t *B() const { return b.data<mm_in_t>(); }
+    mm_out_t *AB() const { return ab.data<mm_out_t>(); }
+
+    // Distributes A and B, computes every tile and gathers AB. The time
+    // covers all of it, from the first input copy to the last tile.
+    mm_sched_stats run() {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::atomic<int> next(0);
+        mm_sched_stats stats;
+        stats.tiles_per_unit.assign(units.size(), 0);
+
+        std::vector<std::exception_ptr> errors(units.size());
+        std::vector<std::thread> threads;
+        for (int u = 0; u < num_units(); u++)
+            threads.emplace_back([this, u, &next, &stats, &errors] {
+                work(u, next, stats.tiles_per_unit[u], errors[u]);
+            });
+        for (auto &t : threads)
+            t.join();
+        for (auto &e : errors)
+            if (e)
+                std::rethrow_exception(e);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        stats.seconds = std::chrono::duration<double>(end - start).count();
+        return stats;
+    }
+
+private:
+    // Computes chunks until none are left. An exception is kept in error
+    // and ends the hand-out for every unit.
+    void work(int u, std::atomic<int> &next, int &done, std::exception_ptr &error) {
+        try {
+            work(u, next, done);
+        } catch (...) {
+            error = std::current_exception();
+            next = shape.num_tiles();
+        }
+    }
+
+    void work(int u, std::atomic<int> &next, int &done) {
+        mm_operands &o = ops[u];
+        std::memcpy(o.A(), A(), shape.a_bytes());
+        std::memcpy(o.B(), B(), shape.b_bytes());
+        o.sync_in();
+
+        size_t row_bytes = (size_t) shape.ldab() * sizeof(mm_out_t);
+        for (;;) {
+            int first = next.fetch_add(chunk);
+            if (first >= shape.num_tiles())
+                break;
+            int count = std::min(chunk, shape.num_tiles() - first);
+            mm_trace_job in_job(first / chunk);
+
+            // row order keeps every chunk inside a contiguous range of rows
+            mm_args args = o.args();
+            args.order = TILE_ROWS;
+            args.tile_first = first;
+            args.tile_count = count;
+            units[u]->launch(o.a, o.b, o.ab, o.occ, o.epi, o.chk, args).wait();
+
+            // the chunk spans whole tile rows tile_row(first)..tile_row(last)
+            int r0 = shape.tile_row(first) * TILE_DIM;
+            int r1 = std::min(shape.M, (shape.tile_row(first + count - 1) + 1) * TILE_DIM);
+            {
+                mm_trace_scope trace("sync out");
+                o.ab.from_device((r1 - r0) * row_bytes, r0 * row_bytes);
+            }
+            for (int t = first; t < first + count; t++)
+                copy_tile(o.AB(), t);
+            done += count;
+        }
+    }
+
+    void copy_tile(const mm_out_t *src, int t) {
+        int i0 = shape.tile_row(t) * TILE_DIM, j0 = shape.tile_col(t) * TILE_DIM;
+        int i1 = std::min(shape.M, i0 + TILE_DIM), j1 = std::min(shape.N, j0 + TILE_DIM);
+        for (int i = i0; i < i1; i++) {
+            size_t row = (size_t) i * shape.ldab();
+            std::memcpy(AB() + row + j0, src + row + j0, (j1 - j0) * sizeof(mm_out_t));
+        }
+    }
+
+    std::vector<mm_backend *> units;
+    mm_shape shape;
+    int chunk;
+    mm_buffer a, b, ab;
+    std::vector<mm_operands> ops;
+};
+
+#endif
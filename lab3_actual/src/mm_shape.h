@@ -0,0 +1,188 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Problem shape shared by the hosts and the kernels.
+//
+// AB[M][N] = A[M][K] * B[K][N]. The kernels move whole MM_PORT_BYTES
+// (64) byte block_t beats, so every row stride is rounded up to a whole beat of its element
+// type (LD_ALIGN_IN for A and B, LD_ALIGN_OUT for AB, see mm_types.h). Only the
+// strides are padded, never the dimensions: edge tiles are handled by the
+// kernels themselves. Padding elements only ever feed padding results, so
+// buffers do not need to be cleared before use.
+
+#ifndef MM_SHAPE_H
+#define MM_SHAPE_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+
+#include "mm_types.h"
+
+const int LD_ALIGN_IN = MM_PORT_BYTES * 8 / mm_t::in_bits;
+const int LD_ALIGN_OUT = MM_PORT_BYTES * 8 / mm_t::out_bits;
+
+inline int ld_round(int n, int align) { return (n + align - 1) / align * align; }
+
+// How A is stored in memory.
+//   A_ROW_MAJOR: A[i*lda+k]   (.../src/host.cpp, mm_v0..v2 with A_ROWS)
+//   A_COL_MAJOR: At[k*lda+i]  (lab3_actual, mm_v3/v4 read A by column)
+enum a_layout_t { A_ROW_MAJOR, A_COL_MAJOR };
+
+// Output tile edge of the kernels (M of mm_kernel_cfg).
+const int TILE_DIM = MM_TILE;
+
+// Tile numbering and traversal order of mm_v4 (ORDER_ROWS / ORDER_COLS).
+enum tile_order_t { TILE_ROWS, TILE_COLS };
+
+inline bool parse_tile_order(const std::string &s, tile_order_t &order) {
+    if (s == "rows")
+        order = TILE_ROWS;
+    else if (s == "cols")
+        order = TILE_COLS;
+    else
+        return false;
+    return true;
+}
+
+struct mm_shape {
+    int M, K, N;
+    a_layout_t a_layout;
+
+    // Row-major A is M x K, column-major A is stored as At, K x M.
+    int a_rows() const { return a_layout == A_COL_MAJOR ? K : M; }
+    int lda() const { return ld_round(a_layout == A_COL_MAJOR ? M : K, LD_ALIGN_IN); }
+    int ldb() const { return ld_round(N, LD_ALIGN_IN); }
+    int ldab() const { return ld_round(N, LD_ALIGN_OUT); }
+
+    size_t a_elems() const { return (size_t) a_rows() * lda(); }
+    size_t b_elems() const { return (size_t) K * ldb(); }
+    size_t ab_elems() const { return (size_t) M * ldab(); }
+
+    // Strides are whole beats, so these are always whole bytes.
+    size_t a_bytes() const { return a_elems() * mm_t::in_bits / 8; }
+    size_t b_bytes() const { return b_elems() * mm_t::in_bits / 8; }
+    size_t ab_bytes() const { return ab_elems() * mm_t::out_bits / 8; }
+
+    size_t a_index(int i, int k) const {
+        return a_layout == A_COL_MAJOR ? (size_t) k * lda() + i : (size_t) i * lda() + k;
+    }
+    size_t b_index(int k, int j) const { return (size_t) k * ldb() + j; }
+    size_t ab_index(int i, int j) const { return (size_t) i * ldab() + j; }
+
+    // Element access, packed narrow types included.
+    double get_a(const void *A, int i, int k) const { return mm_t::in::get(A, a_index(i, k)); }
+    double get_b(const void *B, int k, int j) const { return mm_t::in::get(B, b_index(k, j)); }
+    double get_ab(const void *AB, int i, int j) const { return mm_t::out::get(AB, ab_index(i, j)); }
+    void set_a(void *A, int i, int k, double v) const { mm_t::in::set(A, a_index(i, k), v); }
+    void set_b(void *B, int k, int j, double v) const { mm_t::in::set(B, b_index(k, j), v); }
+
+    double ops() const { return 2.0 * M * K * N; }
+
+    // Output tile grid, tile t covers rows tile_row(t) * TILE_DIM onwards
+    // and columns tile_col(t) * TILE_DIM onwards.
+    int tile_rows() const { return (M + TILE_DIM - 1) / TILE_DIM; }
+    int tile_cols() const { return (N + TILE_DIM - 1) / TILE_DIM; }
+    int num_tiles() const { return tile_rows() * tile_cols(); }
+    int tile_row(int t, tile_order_t order = TILE_ROWS) const {
+        return order == TILE_COLS ? t % tile_rows() : t / tile_cols();
+    }
+    int tile_col(int t, tile_order_t order = TILE_ROWS) const {
+        return order == TILE_COLS ? t / tile_rows() : t % tile_cols();
+    }
+
+    // Tile occupancy bitmaps of the block-sparse mode (see mm_sparse.h):
+    // the A bitmap, bit ib * tile_depth() + kb, then from word occ_b_word()
+    // the B bitmap, bit kb * tile_cols() + jb.
+    int tile_depth() const { return (K + TILE_DIM - 1) / TILE_DIM; }
+    int occ_b_word() const { return (tile_rows() * tile_depth() + 31) / 32; }
+    int occ_words() const { return occ_b_word() + (tile_depth() * tile_cols() + 31) / 32; }
+    size_t occ_bytes() const { return (size_t) occ_words() * 4; }
+
+    // Epilogue vectors: bias words [0, epi_ld()), scale words from epi_ld(),
+    // one per column of AB, padded to whole beats.
+    int epi_ld() const { return ld_round(N, MM_PORT_BYTES / 4); }
+    size_t epi_bytes() const { return (size_t) 2 * epi_ld() * 4; }
+
+    // ABFT checksums (see mm_abft.h): per output tile, in row order
+    // whatever the launch order, TILE_DIM column checksums then TILE_DIM
+    // row checksums, 64 bit words.
+    size_t chk_index(int t) const { return (size_t) t * 2 * TILE_DIM; }
+    size_t chk_words() const { return chk_index(num_tiles()); }
+    size_t chk_bytes() const { return chk_words() * 8; }
+};
+
+// Which operands a launch treats as block sparse (bits as the kernels'
+// SPARSE_A / SPARSE_B): tile products with an empty A or B tile are skipped.
+enum mm_sparse_t { BLOCK_DENSE = 0, BLOCK_SPARSE_A = 1, BLOCK_SPARSE_B = 2, BLOCK_SPARSE_AB = 3 };
+
+inline bool parse_sparse(const std::string &s, mm_sparse_t &sparse) {
+    if (s == "none")
+        sparse = BLOCK_DENSE;
+    else if (s == "A")
+        sparse = BLOCK_SPARSE_A;
+    else if (s == "B")
+        sparse = BLOCK_SPARSE_B;
+    else if (s == "AB")
+        sparse = BLOCK_SPARSE_AB;
+    else
+        return false;
+    return true;
+}
+
+// Scalar arguments of one mm kernel launch. Strides are the distance
+// between consecutive problems of a batch, in block_t beats. Only
+// output tiles [tile_first, tile_first + tile_count) are computed, numbered
+// in `order` over the TILE_DIM x TILE_DIM tile grid. The occupancy bitmaps
+// of problem i start i * strideOcc 32 bit words into the occupancy buffer,
+// sparse says which of them apply. epilogue, shift, act_lo and act_hi are
+// those of mm_epilogue. abft asks for the tile checksums, strideChk beats
+// per problem.
+struct mm_args {
+    int M, K, N;
+    int batch;
+    int strideA, strideB, strideAB;
+    int tile_first, tile_count;
+    int order;
+    int strideOcc, sparse;
+    int epilogue, shift, act_lo, act_hi;
+    int strideChk, abft;
+};
+
+// Parses "M K N" (or a single "N" for a square problem) from the n strings
+// in dims. Returns false if they are malformed.
+inline bool parse_shape(int n, char **dims, mm_shape &shape) {
+    int v[3];
+    if (n != 0 && n != 1 && n != 3)
+        return false;
+    for (int i = 0; i < n; i++) {
+        char *end;
+        long d = std::strtol(dims[i], &end, 10);
+        if (*end != '\0' || d <= 0 || d > (1 << 20))
+            return false;
+        v[i] = (int) d;
+    }
+    if (n == 1) {
+        shape.M = shape.K = shape.N = v[0];
+    } else if (n == 3) {
+        shape.M = v[0];
+        shape.K = v[1];
+        shape.N = v[2];
+    }
+    return true;
+}
+
+#endif
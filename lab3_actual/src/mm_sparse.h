@@ -0,0 +1,125 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Tile occupancy of block-sparse operands.
+//
+// The kernels skip the k blocks of an output tile whose A tile or B tile
+// holds only zeros, so runtime and DRAM traffic scale with the nonzero
+// tiles. mm_occupancy() scans the host operands of one problem and writes
+// the bitmaps the kernels read (layout in mm_shape.h); a set bit marks a
+// TILE_DIM x TILE_DIM tile (edge tiles clipped) with a nonzero element.
+//
+// A bitmap per operand rather than a block-CSR index keeps the kernel side
+// to a single bit test per (tile, k block), costs one bit per tile and
+// lets A, B or both be declared sparse with the same buffer.
+
+#ifndef MM_SPARSE_H
+#define MM_SPARSE_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "mm_shape.h"
+
+// Tile counts, and the (ib, kb, jb) tile products a full GEMM has and the
+// kernels still compute.
+struct mm_occupancy_stats {
+    long a_tiles, a_nonzero;
+    long b_tiles, b_nonzero;
+    long products, live;
+
+    void add(const mm_occupancy_stats &s) {
+        a_tiles += s.a_tiles;
+        a_nonzero += s.a_nonzero;
+        b_tiles += s.b_tiles;
+        b_nonzero += s.b_nonzero;
+        products += s.products;
+        live += s.live;
+    }
+    double work() const { return products ? (double) live / products : 1; }
+};
+
+inline bool mm_occ_bit(const uint32_t *words, int bit) { return words[bit / 32] >> (bit % 32) & 1; }
+
+// Sets the A bitmap bits of the nonzero tiles of A in occ (cleared
+// beforehand) and returns their number.
+inline long mm_occupancy_a(const mm_shape &shape, const void *A, uint32_t *occ) {
+    long nonzero = 0;
+    for (int ib = 0; ib < shape.tile_rows(); ib++) {
+        for (int kb = 0; kb < shape.tile_depth(); kb++) {
+            bool nz = false;
+            for (int i = ib * TILE_DIM; i < shape.M && i < (ib + 1) * TILE_DIM && !nz; i++)
+                for (int k = kb * TILE_DIM; k < shape.K && k < (kb + 1) * TILE_DIM && !nz; k++)
+                    nz = shape.get_a(A, i, k) != 0;
+            int bit = ib * shape.tile_depth() + kb;
+            if (nz) {
+                occ[bit / 32] |= 1u << (bit % 32);
+                nonzero++;
+            }
+        }
+    }
+    return nonzero;
+}
+
+// The same for B, occ_b pointing at word occ_b_word() of the bitmaps. The
+// B bitmap does not depend on M.
+inline long mm_occupancy_b(const mm_shape &shape, const void *B, uint32_t *occ_b) {
+    long nonzero = 0;
+    for (int kb = 0; kb < shape.tile_depth(); kb++) {
+        for (int jb = 0; jb < shape.tile_cols(); jb++) {
+            bool nz = false;
+            for (int k = kb * TILE_DIM; k < shape.K && k < (kb + 1) * TILE_DIM && !nz; k++)
+                for (int j = jb * TILE_DIM; j < shape.N && j < (jb + 1) * TILE_DIM && !nz; j++)
+                    nz = shape.get_b(B, k, j) != 0;
+            int bit = kb * shape.tile_cols() + jb;
+            if (nz) {
+                occ_b[bit / 32] |= 1u << (bit % 32);
+                nonzero++;
+            }
+        }
+    }
+    return nonzero;
+}
+
+// Counts the tile products of finished bitmaps the kernels compute with
+// sparse; a_nonzero and b_nonzero are the counts of the two scans above.
+inline mm_occupancy_stats mm_occupancy_count(const mm_shape &shape, const uint32_t *occ, mm_sparse_t sparse,
+                                             long a_nonzero, long b_nonzero) {
+    mm_occupancy_stats stats = {shape.tile_rows() * shape.tile_depth(), a_nonzero,
+                                shape.tile_depth() * shape.tile_cols(), b_nonzero,
+                                (long) shape.tile_rows() * shape.tile_depth() * shape.tile_cols(), 0};
+    const uint32_t *occ_b = occ + shape.occ_b_word();
+    for (int ib = 0; ib < shape.tile_rows(); ib++)
+        for (int kb = 0; kb < shape.tile_depth(); kb++)
+            for (int jb = 0; jb < shape.tile_cols(); jb++)
+                if ((!(sparse & BLOCK_SPARSE_A) || mm_occ_bit(occ, ib * shape.tile_depth() + kb)) &&
+                    (!(sparse & BLOCK_SPARSE_B) || mm_occ_bit(occ_b, kb * shape.tile_cols() + jb)))
+                    stats.live++;
+    return stats;
+}
+
+// Fills the occ_words() words at occ from the operands A and B of one
+// problem; sparse selects the bitmaps the live tile products are counted
+// with.
+inline mm_occupancy_stats mm_occupancy(const mm_shape &shape, const void *A, const void *B, uint32_t *occ,
+                                       mm_sparse_t sparse) {
+    std::memset(occ, 0, shape.occ_bytes());
+    long a_nonzero = mm_occupancy_a(shape, A, occ);
+    long b_nonzero = mm_occupancy_b(shape, B, occ + shape.occ_b_word());
+    return mm_occupancy_count(shape, occ, sparse, a_nonzero, b_nonzero);
+}
+
+#endif
@@ -0,0 +1,67 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Summary statistics over repeated timings.
+
+#ifndef MM_STATS_H
+#define MM_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+class mm_samples {
+public:
+    void add(double v) {
+        values.push_back(v);
+        sorted = false;
+    }
+
+    int size() const { return (int) values.size(); }
+    bool empty() const { return values.empty(); }
+
+    // Nearest-rank percentile, p in [0, 100]. Zero when there are no samples.
+    double percentile(double p) {
+        if (values.empty())
+            return 0;
+        sort();
+        int rank = (int) std::ceil(p / 100.0 * values.size());
+        return values[std::min(std::max(rank, 1), size()) - 1];
+    }
+
+    double median() { return percentile(50); }
+    double min() { return percentile(0); }
+    double max() { return percentile(100); }
+
+    double mean() const {
+        double sum = 0;
+        for (double v : values)
+            sum += v;
+        return values.empty() ? 0 : sum / values.size();
+    }
+
+private:
+    void sort() {
+        if (!sorted)
+            std::sort(values.begin(), values.end());
+        sorted = true;
+    }
+
+    std::vector<double> values;
+    bool sorted = true;
+};
+
+#endif
@@ -0,0 +1,313 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Strassen-Winograd recursion on top of the mm kernels.
+//
+// Every level of the recursion replaces one product of 2 x 2 block
+// matrices by 7 half size products (Winograd's form), 7/8 of the work. With
+// `depth` levels, A and B are cut into 2^depth x 2^depth blocks of
+// ceil(dim / 2^depth), zero padded at the far edges, and the 7^depth leaf
+// products are formed directly from signed sums of those blocks. All leaves
+// have the same shape, so they run as one mm_batch, a single launch. The
+// results are combined into AB by another pass of signed sums. Both
+// passes are O(dim^2) and run row by row on the host.
+//
+// The leaf operands are sums of inputs, which the kernels only take in
+// their input width. Integers therefore qualify when their results wrap at
+// no more bits than the inputs (min(out_bits, acc_bits) <= in_bits, e.g.
+// the default int16): the operand sums wrap harmlessly, the products being
+// taken modulo the same power of two. Float qualifies, with the rounding
+// error of the recursion on top of the kernel's. Half rounds every leaf
+// result to half and ap_fixed truncates it; neither combines exactly
+// enough, nor do the epilogues, which apply to the final sums only.
+
+#ifndef MM_STRASSEN_H
+#define MM_STRASSEN_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "mm_batch.h"
+#include "mm_trace.h"
+
+// One level of Winograd's form. The product p multiplies
+// sum_q WINOGRAD_A[p][q] A_q by sum_q WINOGRAD_B[p][q] B_q, quadrants q in
+// the order 11, 12, 21, 22; quadrant q of AB is sum_p WINOGRAD_C[q][p] P_p.
+const int WINOGRAD_A[7][4] = {
+    {1, 0, 0, 0},   // A11
+    {0, 1, 0, 0},   // A12
+    {1, 1, -1, -1}, // S4 = A12 - S2
+    {0, 0, 0, 1},   // A22
+    {0, 0, 1, 1},   // S1 = A21 + A22
+    {-1, 0, 1, 1},  // S2 = S1 - A11
+    {1, 0, -1, 0},  // S3 = A11 - A21
+};
+const int WINOGRAD_B[7][4] = {
+    {1, 0, 0, 0},   // B11
+    {0, 0, 1, 0},   // B21
+    {0, 0, 0, 1},   // B22
+    {1, -1, -1, 1}, // T4 = T2 - B21
+    {-1, 1, 0, 0},  // T1 = B12 - B11
+    {1, -1, 0, 1},  // T2 = B22 - T1
+    {0, -1, 0, 1},  // T3 = B22 - B12
+};
+const int WINOGRAD_C[4][7] = {
+    {1, 1, 0, 0, 0, 0, 0},  // P1 + P2
+    {1, 0, 1, 0, 1, 1, 0},  // P1 + P6 + P5 + P3
+    {1, 0, 0, -1, 0, 1, 1}, // P1 + P6 + P7 - P4
+    {1, 0, 0, 0, 1, 1, 1},  // P1 + P6 + P7 + P5
+};
+
+// Sums are formed in int64 (wrapping like the kernels) for the exact
+// families, in double otherwise.
+template <class T, bool EXACT = T::exact> struct mm_strassen_impl {
+    typedef int64_t work_t;
+    static bool supported() {
+        return T::frac_bits == 0 && T::in_bits >= 8 && std::min(T::out_bits, T::acc_bits) <= T::in_bits;
+    }
+    static mm_in_t in(work_t v) { return (mm_in_t) v; }
+    static mm_out_t out(work_t v) { return (mm_out_t) T::result(v); }
+};
+
+template <class T> struct mm_strassen_impl<T, false> {
+    typedef double work_t;
+    static bool supported() { return T::in_bits == 32; }
+    static mm_in_t in(work_t v) { return (mm_in_t) v; }
+    static mm_out_t out(work_t v) { return (mm_out_t) v; }
+};
+
+inline bool mm_strassen_supported() { return mm_strassen_impl<mm_t>::supported(); }
+
+// The depth actually used for at most max_depth levels: every leaf
+// dimension stays at least cutoff.
+inline int mm_strassen_depth(const mm_shape &shape, int max_depth, int cutoff) {
+    int d = 0;
+    while (d < max_depth && std::min(shape.M, std::min(shape.K, shape.N)) >> (d + 1) >= cutoff)
+        d++;
+    return d;
+}
+
+// Relative tolerance for results of `depth` levels: the operand sums grow
+// the magnitudes each leaf rounds at, about 4x the error per level for float.
+inline double mm_strassen_tolerance(int depth) { return std::ldexp(mm_t::tolerance, 2 * depth); }
+
+struct mm_strassen_stats {
+    double split, kernel, combine; // seconds per phase
+    double seconds;
+
+    double total() const { return split + kernel + combine; }
+};
+
+class mm_strassen {
+public:
+    mm_strassen(mm_backend &backend, const mm_shape &shape, int depth, mm_bo_mode mode = BO_DEVICE)
+        : shape(shape), depth(depth), leaf_shape(leaf_of(shape, depth)),
+          a(mm_buffer::host(shape.a_bytes())), b(mm_buffer::host(shape.b_bytes())),
+          ab(mm_buffer::host(shape.ab_bytes())),
+          leaves(backend, leaf_shape, count_of(depth), mode) {
+        if (!mm_strassen_supported())
+            throw std::invalid_argument("mm_strassen: element types do not combine exactly");
+    }
+
+    int num_leaves() const { return leaves.size(); }
+    const mm_shape &leaf() const { return leaf_shape; }
+
+    // Host views of the whole problem, laid out as described by shape
+    mm_in_t *A() const { return a.data<mm_in_t>(); }
+    mm_in_t *B() const { return b.data<mm_in_t>(); }
+    mm_out_t *AB() const { return ab.data<mm_out_t>(); }
+
+    // Forms the leaf operands, runs them and combines their results into AB.
+    mm_strassen_stats run() {
+        typedef std::chrono::high_resolution_clock clock;
+        mm_strassen_stats stats;
+        auto t0 = clock::now();
+        {
+            mm_trace_scope trace("strassen split");
+            for (int l = 0; l < num_leaves(); l++) {
+                split_a(l);
+                split_b(l);
+            }
+        }
+        auto t1 = clock::now();
+        leaves.sync_in();
+        leaves.run();
+        leaves.sync_out();
+        auto t2 = clock::now();
+        {
+            mm_trace_scope trace("strassen combine");
+            combine();
+        }
+        auto t3 = clock::now();
+        stats.split = std::chrono::duration<double>(t1 - t0).count();
+        stats.kernel = std::chrono::duration<double>(t2 - t1).count();
+        stats.combine = std::chrono::duration<double>(t3 - t2).count();
+        stats.seconds = std::chrono::duration<double>(t3 - t0).count();
+        return stats;
+    }
+
+private:
+    typedef mm_strassen_impl<mm_t> impl;
+    typedef impl::work_t work_t;
+
+    // Block (r, c) of a matrix, with the sign it is summed with.
+    struct term {
+        int r, c, sign;
+    };
+    // A stored matrix and the rows x cols blocks terms refer to.
+    template <class S> struct view {
+        const S *base;
+        size_t ld;
+        int rows, cols;
+        int block_rows, block_cols;
+    };
+
+    static int count_of(int depth) {
+        int n = 1;
+        for (int d = 0; d < depth; d++)
+            n *= 7;
+        return n;
+    }
+    static mm_shape leaf_of(const mm_shape &s, int depth) {
+        int f = 1 << depth;
+        return mm_shape{(s.M + f - 1) / f, (s.K + f - 1) / f, (s.N + f - 1) / f, s.a_layout};
+    }
+
+    // The blocks of the 2^depth x 2^depth grid summed into the operand of
+    // leaf l, its base 7 digits naming the product at each level.
+    std::vector<term> operand_terms(const int table[7][4], int l) const {
+        std::vector<term> terms = {{0, 0, 1}};
+        int digits = count_of(depth);
+        for (int d = 0; d < depth; d++) {
+            digits /= 7;
+            int p = l / digits % 7;
+            std::vector<term> next;
+            for (auto &t : terms)
+                for (int q = 0; q < 4; q++)
+                    if (table[p][q])
+                        next.push_back({t.r * 2 + q / 2, t.c * 2 + q % 2, t.sign * table[p][q]});
+            terms.swap(next);
+        }
+        return terms;
+    }
+
+    // dst (rows x cols, ld_dst) = sum of the terms' blocks of src, zero
+    // where a block runs past the edge of src.
+    template <class S, class D, class F>
+    static void pass(D *dst, size_t ld_dst, int rows, int cols, const view<S> &src, const std::vector<term> &terms,
+                     F finish) {
+#pragma omp parallel
+        {
+            std::vector<work_t> acc(cols);
+#pragma omp for schedule(static)
+            for (int r = 0; r < rows; r++) {
+                std::fill(acc.begin(), acc.end(), 0);
+                for (auto &t : terms) {
+                    int sr = t.r * src.block_rows + r, sc = t.c * src.block_cols;
+                    if (sr >= src.rows || sc >= src.cols)
+                        continue;
+                    const S *row = src.base + (size_t) sr * src.ld + sc;
+                    int n = std::min(cols, src.cols - sc);
+                    if (t.sign > 0)
+                        for (int c = 0; c < n; c++)
+                            acc[c] += (work_t) row[c];
+                    else
+                        for (int c = 0; c < n; c++)
+                            acc[c] -= (work_t) row[c];
+                }
+                D *out = dst + (size_t) r * ld_dst;
+                for (int c = 0; c < cols; c++)
+                    out[c] = finish(acc[c]);
+            }
+        }
+    }
+
+    // Stored A is At (K x M) in the kernels' layout, so its blocks swap
+    // their coordinates there.
+    void split_a(int l) {
+        bool col_major = shape.a_layout == A_COL_MAJOR;
+        std::vector<term> terms = operand_terms(WINOGRAD_A, l);
+        if (col_major)
+            for (auto &t : terms)
+                std::swap(t.r, t.c);
+        view<mm_in_t> src = {A(), (size_t) shape.lda(), shape.a_rows(), col_major ? shape.M : shape.K,
+                             leaf_shape.a_rows(), col_major ? leaf_shape.M : leaf_shape.K};
+        pass(leaves.A(l), leaf_shape.lda(), src.block_rows, src.block_cols, src, terms, impl::in);
+    }
+
+    void split_b(int l) {
+        view<mm_in_t> src = {B(), (size_t) shape.ldb(), shape.K, shape.N, leaf_shape.K, leaf_shape.N};
+        pass(leaves.B(l), leaf_shape.ldb(), leaf_shape.K, leaf_shape.N, src, operand_terms(WINOGRAD_B, l), impl::in);
+    }
+
+    // Block (bi, bj) of AB sums the leaves whose product digits each carry
+    // a coefficient for its quadrant digits.
+    void combine() {
+        int grid = 1 << depth;
+        for (int bi = 0; bi < grid; bi++) {
+            for (int bj = 0; bj < grid; bj++) {
+                int i0 = bi * leaf_shape.M, j0 = bj * leaf_shape.N;
+                if (i0 >= shape.M || j0 >= shape.N)
+                    continue;
+                std::vector<std::pair<int, int>> leaf_signs = {{0, 1}};
+                for (int d = depth - 1; d >= 0; d--) {
+                    int q = (bi >> d & 1) * 2 + (bj >> d & 1);
+                    std::vector<std::pair<int, int>> next;
+                    for (auto &ls : leaf_signs)
+                        for (int p = 0; p < 7; p++)
+                            if (WINOGRAD_C[q][p])
+                                next.push_back({ls.first * 7 + p, ls.second * WINOGRAD_C[q][p]});
+                    leaf_signs.swap(next);
+                }
+                int rows = std::min(leaf_shape.M, shape.M - i0), cols = std::min(leaf_shape.N, shape.N - j0);
+                mm_out_t *dst = AB() + shape.ab_index(i0, j0);
+                // the leaf results are the terms, all at block (0, 0)
+#pragma omp parallel
+                {
+                    std::vector<work_t> acc(cols);
+#pragma omp for schedule(static)
+                    for (int r = 0; r < rows; r++) {
+                        std::fill(acc.begin(), acc.end(), 0);
+                        for (auto &ls : leaf_signs) {
+                            const mm_out_t *row = leaves.AB(ls.first) + leaf_shape.ab_index(r, 0);
+                            if (ls.second > 0)
+                                for (int c = 0; c < cols; c++)
+                                    acc[c] += (work_t) row[c];
+                            else
+                                for (int c = 0; c < cols; c++)
+                                    acc[c] -= (work_t) row[c];
+                        }
+                        mm_out_t *out = dst + (size_t) r * shape.ldab();
+                        for (int c = 0; c < cols; c++)
+                            out[c] = impl::out(acc[c]);
+                    }
+                }
+            }
+        }
+    }
+
+    mm_shape shape;
+    int depth;
+    mm_shape leaf_shape;
+    mm_buffer a, b, ab;
+    mm_batch leaves;
+};
+
+#endif
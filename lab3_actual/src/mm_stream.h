@@ -0,0 +1,134 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Streaming host pipeline for a long sequence of same-shaped jobs.
+//
+// Buffer sets are used in rotation. While the kernel runs job i, the
+// inputs of job i+1 are produced and synced to the device on the calling
+// thread, and the result of job i-1 is synced back and consumed on a
+// helper thread. Three sets are the minimum for that overlap: one
+// uploading, one computing, one downloading.
+
+#ifndef MM_STREAM_H
+#define MM_STREAM_H
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "mm_backend.h"
+
+struct mm_stream_stats {
+    int jobs;
+    double seconds;
+    double ops_per_job;
+
+    double gops() const { return ops_per_job * jobs * 1e-9 / seconds; }
+    double jobs_per_sec() const { return jobs / seconds; }
+};
+
+class mm_stream {
+public:
+    // produce(job, A, B) writes the inputs of a job into mapped host memory,
+    // consume(job, AB) reads its result. Pointers are laid out per shape.
+    // With resident weights B is null, every job multiplies by them and
+    // only A is uploaded.
+    typedef std::function<void(int, mm_in_t *, mm_in_t *)> produce_fn;
+    typedef std::function<void(int, const mm_out_t *)> consume_fn;
+
+    mm_stream(mm_backend &backend, const mm_shape &shape, int nbuf = 3, mm_bo_mode mode = BO_DEVICE)
+        : backend(backend), shape(shape) {
+        if (nbuf < 3)
+            throw std::invalid_argument("mm_stream: need at least 3 buffer sets");
+        for (int s = 0; s < nbuf; s++)
+            slots.push_back(slot{mm_operands(backend, shape, 1, mode), mm_job()});
+    }
+
+    mm_stream(mm_backend &backend, const mm_shape &shape, mm_weights &w, int nbuf = 3, mm_bo_mode mode = BO_DEVICE)
+        : backend(backend), shape(shape) {
+        if (nbuf < 3)
+            throw std::invalid_argument("mm_stream: need at least 3 buffer sets");
+        for (int s = 0; s < nbuf; s++)
+            slots.push_back(slot{mm_operands(backend, shape, w, 1, mode), mm_job()});
+    }
+
+    int num_slots() const { return (int) slots.size(); }
+
+    // Runs jobs [0, jobs) through the pipeline and returns the sustained
+    // rate, measured from the first upload to the last consumed result.
+    mm_stream_stats run(int jobs, const produce_fn &produce, const consume_fn &consume) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if (jobs > 0)
+            upload(0, produce);
+        std::future<void> drain;
+        for (int i = 0; i < jobs; i++) {
+            slot &cur = at(i);
+            {
+                mm_trace_job in_job(i);
+                cur.run = cur.ops.launch(backend);
+            }
+
+            // job i-1 downloads while job i computes and job i+1 uploads
+            if (i > 0)
+                drain = std::async(std::launch::async, [this, i, &consume] { download(i - 1, consume); });
+            if (i + 1 < jobs)
+                upload(i + 1, produce);
+            if (drain.valid())
+                drain.get();
+        }
+        if (jobs > 0)
+            download(jobs - 1, consume);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        mm_stream_stats stats;
+        stats.jobs = jobs;
+        stats.seconds = std::chrono::duration<double>(end - start).count();
+        stats.ops_per_job = shape.ops();
+        return stats;
+    }
+
+private:
+    struct slot {
+        mm_operands ops;
+        mm_job run;
+    };
+
+    slot &at(int job) { return slots[job % slots.size()]; }
+
+    void upload(int job, const produce_fn &produce) {
+        mm_trace_job in_job(job);
+        slot &s = at(job);
+        produce(job, s.ops.A(), s.ops.weights ? nullptr : s.ops.B());
+        s.ops.sync_in();
+    }
+
+    void download(int job, const consume_fn &consume) {
+        mm_trace_job in_job(job);
+        slot &s = at(job);
+        s.run.wait();
+        s.ops.sync_out();
+        consume(job, s.ops.AB());
+    }
+
+    mm_backend &backend;
+    mm_shape shape;
+    std::vector<slot> slots;
+};
+
+#endif
@@ -0,0 +1,292 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// CPU golden model for the int16 build of the mm kernels (the default
+// 16/16/16 types of mm_types.h, see mm_ref.h for the others).
+//
+// Packed, register-blocked GEMM in the usual three-level blocking
+// (NC x KC panels of B, MC x KC panels of A, MR x NR register tile).
+// Panels are packed with pairs of consecutive k interleaved so the
+// micro-kernel can use the int16 multiply-add instructions
+// (vpmaddwd / vpdpwssd), which produce a 32 bit sum of two products.
+//
+// The int16 kernels accumulate modulo 2^16. Accumulating in 32 bits and
+// truncating at the end gives the same bits, so the result matches the
+// FPGA output exactly.
+
+#ifndef MM_SW_H
+#define MM_SW_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <omp.h>
+
+#include "mm_shape.h"
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+
+namespace mm_sw_impl {
+
+typedef short DTYPE;
+
+#if defined(__AVX512BW__)
+const int MR = 12;
+const int NR = 32;
+#elif defined(__AVX2__)
+const int MR = 6;
+const int NR = 16;
+#else
+const int MR = 4;
+const int NR = 16;
+#endif
+const int MC = 96;
+const int KC = 256;
+const int NC = 2048;
+
+static_assert(MC % MR == 0, "MC must be a multiple of MR");
+static_assert(NC % NR == 0, "NC must be a multiple of NR");
+static_assert(KC % 2 == 0, "KC must be even, k is packed in pairs");
+
+struct aligned_buf {
+    DTYPE *p;
+    explicit aligned_buf(size_t n) {
+        size_t bytes = (n * sizeof(DTYPE) + 63) & ~size_t(63);
+        p = (DTYPE *) std::aligned_alloc(64, bytes);
+        if (!p)
+            throw std::bad_alloc();
+    }
+    ~aligned_buf() { std::free(p); }
+    aligned_buf(const aligned_buf &) = delete;
+    aligned_buf &operator=(const aligned_buf &) = delete;
+};
+
+// Pack B[k0:k0+kc, j0:j0+nc] into NR wide column strips.
+// Within a strip each k pair is stored as NR (b[k][j], b[k+1][j]) pairs.
+inline void pack_B(const DTYPE *B, int ldb, int k0, int kc, int j0, int nc, DTYPE *Bp) {
+    int kp_cnt = (kc + 1) / 2;
+    for (int jr = 0; jr < nc; jr += NR) {
+        DTYPE *dst = Bp + (size_t) jr * kp_cnt * 2;
+        int nr = std::min(NR, nc - jr);
+        for (int kp = 0; kp < kp_cnt; kp++) {
+            int k = k0 + 2 * kp;
+            const DTYPE *b0 = B + (size_t) k * ldb + j0 + jr;
+            const DTYPE *b1 = (2 * kp + 1 < kc) ? b0 + ldb : nullptr;
+            int j = 0;
+            for (; j < nr; j++) {
+                dst[2 * j] = b0[j];
+                dst[2 * j + 1] = b1 ? b1[j] : 0;
+            }
+            for (; j < NR; j++) {
+                dst[2 * j] = 0;
+                dst[2 * j + 1] = 0;
+            }
+            dst += 2 * NR;
+        }
+    }
+}
+
+// Pack A[i0:i0+mc, k0:k0+kc] into MR tall row strips of (a[i][k], a[i][k+1]) pairs.
+inline void pack_A(const DTYPE *A, int lda, a_layout_t layout, int i0, int mc, int k0, int kc, DTYPE *Ap) {
+    int kp_cnt = (kc + 1) / 2;
+    for (int ir = 0; ir < mc; ir += MR) {
+        DTYPE *dst = Ap + (size_t) ir * kp_cnt * 2;
+        int mr = std::min(MR, mc - ir);
+        if (layout == A_COL_MAJOR) {
+            for (int kp = 0; kp < kp_cnt; kp++) {
+                int k = k0 + 2 * kp;
+                const DTYPE *a0 = A + (size_t) k * lda + i0 + ir;
+                const DTYPE *a1 = (2 * kp + 1 < kc) ? a0 + lda : nullptr;
+                int i = 0;
+                for (; i < mr; i++) {
+                    dst[2 * i] = a0[i];
+                    dst[2 * i + 1] = a1 ? a1[i] : 0;
+                }
+                for (; i < MR; i++) {
+                    dst[2 * i] = 0;
+                    dst[2 * i + 1] = 0;
+                }
+                dst += 2 * MR;
+            }
+        } else {
+            for (int kp = 0; kp < kp_cnt; kp++) {
+                int k = k0 + 2 * kp;
+                bool pair = 2 * kp + 1 < kc;
+                int i = 0;
+                for (; i < mr; i++) {
+                    const DTYPE *a = A + (size_t) (i0 + ir + i) * lda + k;
+                    dst[2 * i] = a[0];
+                    dst[2 * i + 1] = pair ? a[1] : 0;
+                }
+                for (; i < MR; i++) {
+                    dst[2 * i] = 0;
+                    dst[2 * i + 1] = 0;
+                }
+                dst += 2 * MR;
+            }
+        }
+    }
+}
+
+// (a[i][k], a[i][k+1]) as one 32 bit lane for broadcasting
+inline int32_t load_pair(const DTYPE *p) {
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// C[MR][NR] (+)= Ap * Bp over kp_cnt k pairs, results truncated to DTYPE.
+// Partial tiles (mr < MR or nr < NR) go through a scratch tile.
+inline void micro_kernel(int kp_cnt, const DTYPE *Ap, const DTYPE *Bp, DTYPE *C, int ldc, int mr, int nr, bool accumulate) {
+    alignas(64) int32_t acc[MR][NR];
+
+#if defined(__AVX512BW__)
+    __m512i c[MR][2];
+    for (int i = 0; i < MR; i++) {
+        c[i][0] = _mm512_setzero_si512();
+        c[i][1] = _mm512_setzero_si512();
+    }
+    for (int kp = 0; kp < kp_cnt; kp++) {
+        __m512i b0 = _mm512_load_si512((const void *) (Bp + 2 * NR * kp));
+        __m512i b1 = _mm512_load_si512((const void *) (Bp + 2 * NR * kp + 32));
+        const DTYPE *a = Ap + 2 * MR * kp;
+        for (int i = 0; i < MR; i++) {
+            __m512i av = _mm512_set1_epi32(load_pair(a + 2 * i));
+#if defined(__AVX512VNNI__)
+            c[i][0] = _mm512_dpwssd_epi32(c[i][0], av, b0);
+            c[i][1] = _mm512_dpwssd_epi32(c[i][1], av, b1);
+#else
+            c[i][0] = _mm512_add_epi32(c[i][0], _mm512_madd_epi16(av, b0));
+            c[i][1] = _mm512_add_epi32(c[i][1], _mm512_madd_epi16(av, b1));
+#endif
+        }
+    }
+    // madd pairs (b[k][j], b[k+1][j]) so lane j of each register is column j
+    for (int i = 0; i < MR; i++) {
+        _mm512_store_si512((void *) &acc[i][0], c[i][0]);
+        _mm512_store_si512((void *) &acc[i][16], c[i][1]);
+    }
+#elif defined(__AVX2__)
+    __m256i c[MR][2];
+    for (int i = 0; i < MR; i++) {
+        c[i][0] = _mm256_setzero_si256();
+        c[i][1] = _mm256_setzero_si256();
+    }
+    for (int kp = 0; kp < kp_cnt; kp++) {
+        __m256i b0 = _mm256_load_si256((const __m256i *) (Bp + 2 * NR * kp));
+        __m256i b1 = _mm256_load_si256((const __m256i *) (Bp + 2 * NR * kp + 16));
+        const DTYPE *a = Ap + 2 * MR * kp;
+        for (int i = 0; i < MR; i++) {
+            __m256i av = _mm256_set1_epi32(load_pair(a + 2 * i));
+            c[i][0] = _mm256_add_epi32(c[i][0], _mm256_madd_epi16(av, b0));
+            c[i][1] = _mm256_add_epi32(c[i][1], _mm256_madd_epi16(av, b1));
+        }
+    }
+    for (int i = 0; i < MR; i++) {
+        _mm256_store_si256((__m256i *) &acc[i][0], c[i][0]);
+        _mm256_store_si256((__m256i *) &acc[i][8], c[i][1]);
+    }
+#else
+    // unsigned products and accumulation so the 32 bit wraparound is well
+    // defined, 2 * (-32768)^2 overflows int
+    uint32_t u[MR][NR] = {};
+    for (int kp = 0; kp < kp_cnt; kp++) {
+        const DTYPE *b = Bp + 2 * NR * kp;
+        const DTYPE *a = Ap + 2 * MR * kp;
+        for (int i = 0; i < MR; i++) {
+            for (int j = 0; j < NR; j++) {
+                u[i][j] += (uint32_t) a[2 * i] * (uint32_t) b[2 * j] +
+                           (uint32_t) a[2 * i + 1] * (uint32_t) b[2 * j + 1];
+            }
+        }
+    }
+    std::memcpy(acc, u, sizeof(acc));
+#endif
+
+    for (int i = 0; i < mr; i++) {
+        DTYPE *c_row = C + (size_t) i * ldc;
+        if (accumulate) {
+            for (int j = 0; j < nr; j++)
+                c_row[j] = (DTYPE) (c_row[j] + acc[i][j]);
+        } else {
+            for (int j = 0; j < nr; j++)
+                c_row[j] = (DTYPE) acc[i][j];
+        }
+    }
+}
+
+} // namespace mm_sw_impl
+
+// AB[M][N] = A[M][K] * B[K][N], wrapping at 16 bits like the kernels.
+// A is read according to layout, B and AB are row-major.
+inline void mm_sw(const mm_sw_impl::DTYPE *A, const mm_sw_impl::DTYPE *B, mm_sw_impl::DTYPE *AB, int M, int K,
+                  int N, a_layout_t layout, int lda, int ldb, int ldab) {
+    using namespace mm_sw_impl;
+
+    if (K == 0) {
+        for (int i = 0; i < M; i++)
+            std::memset(AB + (size_t) i * ldab, 0, sizeof(DTYPE) * N);
+        return;
+    }
+
+    aligned_buf Bp((size_t) NC * KC);
+
+    for (int jc = 0; jc < N; jc += NC) {
+        int nc = std::min(NC, N - jc);
+        for (int pc = 0; pc < K; pc += KC) {
+            int kc = std::min(KC, K - pc);
+            int kp_cnt = (kc + 1) / 2;
+            bool accumulate = pc != 0;
+
+#pragma omp parallel
+            {
+                // B panel is shared, packed cooperatively one NR strip per iteration
+#pragma omp for schedule(static)
+                for (int jr = 0; jr < nc; jr += NR) {
+                    pack_B(B, ldb, pc, kc, jc + jr, std::min(NR, nc - jr), Bp.p + (size_t) jr * kp_cnt * 2);
+                }
+
+                aligned_buf Ap((size_t) MC * KC);
+#pragma omp for schedule(dynamic)
+                for (int ic = 0; ic < M; ic += MC) {
+                    int mc = std::min(MC, M - ic);
+                    pack_A(A, lda, layout, ic, mc, pc, kc, Ap.p);
+                    for (int jr = 0; jr < nc; jr += NR) {
+                        int nr = std::min(NR, nc - jr);
+                        const DTYPE *Bs = Bp.p + (size_t) jr * kp_cnt * 2;
+                        for (int ir = 0; ir < mc; ir += MR) {
+                            int mr = std::min(MR, mc - ir);
+                            micro_kernel(kp_cnt, Ap.p + (size_t) ir * kp_cnt * 2, Bs,
+                                         AB + (size_t) (ic + ir) * ldab + jc + jr, ldab, mr, nr, accumulate);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Square, densely stored SIZE x SIZE operands.
+inline void mm_sw(const mm_sw_impl::DTYPE *A, const mm_sw_impl::DTYPE *B, mm_sw_impl::DTYPE *AB, int size,
+                  a_layout_t layout) {
+    mm_sw(A, B, AB, size, size, size, layout, size, size, size);
+}
+
+#endif
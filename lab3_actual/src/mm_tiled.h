@@ -0,0 +1,215 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Memory-mappable matrix files in the kernels' operand layout (.mmt).
+//
+// A file is one page of header followed by the payload: the matrix exactly
+// as the kernels burst-read it from an operand buffer, rows of whole
+// block_t beats (MM_PORT_BYTES), padded with zeros, A transposed for the
+// kernels that read At. Opening a file maps it and mm_tiled_file::import()
+// hands the payload to the backend as a user pointer buffer, so operands go
+// from disk to the device without being parsed, packed or copied on the
+// host, and a result file created for AB receives the kernel's output in
+// place. The header records the shape, element type, layout and the
+// tile and beat sizes of the build that wrote it; files of another element
+// type or beat size are rejected, the tile size only affects how the
+// kernels walk the payload. tools/mm_convert.cpp converts row-major raw
+// and .npy files.
+
+#ifndef MM_TILED_H
+#define MM_TILED_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "mm_backend.h"
+
+const char MM_TILED_MAGIC[8] = {'M', 'M', 'T', 'I', 'L', 'E', 'D', '\n'};
+const uint32_t MM_TILED_VERSION = 1;
+const size_t MM_TILED_PAGE = 4096;
+
+// Element families of mm_types.h.
+enum mm_dtype_t { DTYPE_INT = 0, DTYPE_FIXED = 1, DTYPE_FLOAT = 2, DTYPE_HALF = 3 };
+
+// Stored layouts, the payload is rows x cols or its transpose cols x rows.
+enum mm_tiled_layout_t { TILED_ROW_MAJOR = 0, TILED_TRANSPOSED = 1 };
+
+struct mm_dtype {
+    uint32_t family, bits, frac_bits;
+
+    bool operator==(const mm_dtype &o) const {
+        return family == o.family && bits == o.bits && frac_bits == o.frac_bits;
+    }
+    std::string name() const {
+        static const char *names[] = {"int", "fixed", "float", "half"};
+        return (family < 4 ? names[family] : "?") + std::to_string(bits) +
+               (family == DTYPE_FIXED ? "." + std::to_string(frac_bits) : "");
+    }
+};
+
+template <class T, bool EXACT = T::exact> struct mm_dtype_of {
+    static mm_dtype in() { return {T::frac_bits ? DTYPE_FIXED : DTYPE_INT, T::in_bits, T::frac_bits}; }
+    static mm_dtype out() { return {T::frac_bits ? DTYPE_FIXED : DTYPE_INT, T::out_bits, T::frac_bits}; }
+};
+
+template <class T> struct mm_dtype_of<T, false> {
+    static mm_dtype in() { return {T::in_bits == 32 ? DTYPE_FLOAT : DTYPE_HALF, T::in_bits, 0}; }
+    static mm_dtype out() { return {T::out_bits == 32 ? DTYPE_FLOAT : DTYPE_HALF, T::out_bits, 0}; }
+};
+
+// Operand types of this build: A and B, AB.
+inline mm_dtype mm_dtype_in() { return mm_dtype_of<mm_t>::in(); }
+inline mm_dtype mm_dtype_out() { return mm_dtype_of<mm_t>::out(); }
+
+// The first page of a file, little endian.
+struct mm_tiled_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes; // payload offset, a whole page
+    mm_dtype dtype;
+    uint32_t layout;     // mm_tiled_layout_t
+    uint32_t tile;       // TILE_DIM of the writer
+    uint32_t port_bytes; // block_t beat, stored rows are whole beats
+    uint64_t rows, cols; // the logical matrix
+    uint64_t ld;         // stored row stride in elements
+    uint64_t payload_bytes;
+};
+static_assert(sizeof(mm_tiled_header) == 72, "the header layout is part of the file format");
+
+class mm_tiled_file {
+public:
+    // Maps an existing file, writable for results. Inputs are mapped
+    // private and writable, as a user pointer buffer may pin its pages for
+    // writing; the file is never modified.
+    static mm_tiled_file open(const std::string &path, bool writable = false) {
+        int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("mm_tiled_file: cannot open " + path);
+        struct stat st;
+        mm_tiled_header h;
+        if (::fstat(fd, &st) != 0 || (size_t) st.st_size < MM_TILED_PAGE ||
+            ::pread(fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h) || std::memcmp(h.magic, MM_TILED_MAGIC, 8) ||
+            h.version != MM_TILED_VERSION || h.header_bytes % MM_TILED_PAGE ||
+            (size_t) st.st_size < h.header_bytes + h.payload_bytes) {
+            ::close(fd);
+            throw std::runtime_error("mm_tiled_file: " + path + " is not a matrix file");
+        }
+        return mm_tiled_file(path, fd, h, writable);
+    }
+
+    // Creates (or replaces) the file of a zeroed rows x cols matrix of
+    // dtype, stored in layout, padded for this build.
+    static mm_tiled_file create(const std::string &path, int rows, int cols, mm_dtype dtype,
+                                mm_tiled_layout_t layout = TILED_ROW_MAJOR) {
+        mm_tiled_header h = header(rows, cols, dtype, layout);
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("mm_tiled_file: cannot create " + path);
+        if (::ftruncate(fd, h.header_bytes + round_page(h.payload_bytes)) != 0 ||
+            ::pwrite(fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h)) {
+            ::close(fd);
+            throw std::runtime_error("mm_tiled_file: cannot write " + path);
+        }
+        return mm_tiled_file(path, fd, h, true);
+    }
+
+    // The header of a rows x cols matrix as this build lays it out.
+    static mm_tiled_header header(int rows, int cols, mm_dtype dtype, mm_tiled_layout_t layout) {
+        mm_tiled_header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, MM_TILED_MAGIC, 8);
+        h.version = MM_TILED_VERSION;
+        h.header_bytes = MM_TILED_PAGE;
+        h.dtype = dtype;
+        h.layout = layout;
+        h.tile = TILE_DIM;
+        h.port_bytes = MM_PORT_BYTES;
+        h.rows = rows;
+        h.cols = cols;
+        uint64_t stored_rows = layout == TILED_TRANSPOSED ? cols : rows;
+        h.ld = ld_round(layout == TILED_TRANSPOSED ? rows : cols, MM_PORT_BYTES * 8 / dtype.bits);
+        h.payload_bytes = stored_rows * h.ld * dtype.bits / 8;
+        return h;
+    }
+
+    const mm_tiled_header &info() const { return h; }
+    int rows() const { return (int) h.rows; }
+    int cols() const { return (int) h.cols; }
+    void *data() const { return (char *) map.get() + h.header_bytes; }
+
+    // The payload as a buffer of backend, without a copy.
+    mm_buffer import(mm_backend &backend) const { return backend.import(data(), h.payload_bytes, map); }
+
+    // Writes the pages of a writable mapping back to the file.
+    void flush() const { ::msync(map.get(), h.header_bytes + h.payload_bytes, MS_SYNC); }
+
+    // Whether this file holds the given operand of shape in this build's
+    // layout, with the reason in why when not.
+    bool holds_a(const mm_shape &s, std::string *why = nullptr) const {
+        return holds(s.M, s.K, mm_dtype_in(),
+                     s.a_layout == A_COL_MAJOR ? TILED_TRANSPOSED : TILED_ROW_MAJOR, s.lda(), why);
+    }
+    bool holds_b(const mm_shape &s, std::string *why = nullptr) const {
+        return holds(s.K, s.N, mm_dtype_in(), TILED_ROW_MAJOR, s.ldb(), why);
+    }
+    bool holds_ab(const mm_shape &s, std::string *why = nullptr) const {
+        return holds(s.M, s.N, mm_dtype_out(), TILED_ROW_MAJOR, s.ldab(), why);
+    }
+
+    std::string path;
+
+private:
+    mm_tiled_file(const std::string &path, int fd, const mm_tiled_header &h, bool writable) : path(path), h(h) {
+        size_t len = h.header_bytes + h.payload_bytes;
+        void *p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("mm_tiled_file: cannot map " + path);
+        map.reset(p, [len](void *q) { ::munmap(q, len); });
+    }
+
+    static uint64_t round_page(uint64_t n) { return (n + MM_TILED_PAGE - 1) / MM_TILED_PAGE * MM_TILED_PAGE; }
+
+    bool holds(int rows, int cols, mm_dtype dtype, mm_tiled_layout_t layout, int ld, std::string *why) const {
+        std::string err;
+        if (!(h.dtype == dtype))
+            err = "holds " + h.dtype.name() + " elements, not " + dtype.name();
+        else if (h.port_bytes != MM_PORT_BYTES)
+            err = "is padded for " + std::to_string(h.port_bytes) + " byte beats";
+        else if ((int) h.rows != rows || (int) h.cols != cols)
+            err = "holds a " + std::to_string(h.rows) + " x " + std::to_string(h.cols) + " matrix";
+        else if (h.layout != (uint32_t) layout)
+            err = h.layout == TILED_TRANSPOSED ? "is stored transposed" : "is not stored transposed";
+        else if ((int) h.ld != ld)
+            err = "has a row stride of " + std::to_string(h.ld);
+        if (why)
+            *why = path + " " + err;
+        return err.empty();
+    }
+
+    mm_tiled_header h;
+    std::shared_ptr<void> map;
+};
+
+#endif
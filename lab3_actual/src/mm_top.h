@@ -0,0 +1,136 @@
+/**********
+Copyright (c) 2019, Xilinx, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software
+without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********/
+
+// Top function of a kernel design point. Include after mm_kernel.h and the
+// design point's `mm_cfg`:
+//
+//   #include "mm_kernel.h"
+//   struct mm_cfg : mm_kernel_cfg { static const int PARTITION = 4; };
+//   #include "mm_top.h"
+//
+// MM_TOP names the top function (mm) and MM_TOP_CFG the design point
+// struct (mm_cfg). A kernel that shares an xclbin or a native build with
+// mm, like mm_gemv, sets both so neither symbol collides.
+// MM_TOP_ONE_BUNDLE puts every port on gmem0, as mm_v0 and mm_v1 do.
+// MM_TOP_SPLIT_A adds a last argument A1_p on gmem3, which the host points
+// at A as well; the skinny kernel reads the odd At rows through it.
+
+#ifndef MM_TOP_H
+#define MM_TOP_H
+
+#ifndef MM_TOP
+#define MM_TOP mm
+#endif
+#ifndef MM_TOP_CFG
+#define MM_TOP_CFG mm_cfg
+#endif
+
+typedef mm_traits<MM_TOP_CFG> KT;
+typedef KT::block_t block_t;
+
+extern "C" {
+// AB[Mdim][Ndim] = A[Mdim][Kdim] * B[Kdim][Ndim] for `batch` problems, A
+// stored transposed (row-major with A_ROWS), only output tiles [tile_first, tile_first + tile_count)
+// in `order`, skipping the empty tiles of occ_p that `sparse` selects and
+// finishing every result with the epilogue set by epi_p, epilogue, shift,
+// act_lo and act_hi, and with abft storing tile checksums at chk_p (see
+// mm_kernel.h).
+void MM_TOP(block_t *A_p,  block_t *B_p, block_t *AB_p, int Mdim, int Kdim, int Ndim,
+            int batch, int strideA, int strideB, int strideAB, int tile_first, int tile_count,
+            int order, unsigned *occ_p, int strideOcc, int sparse,
+            block_t *epi_p, int epilogue, int shift, int act_lo, int act_hi,
+#ifdef MM_TOP_SPLIT_A
+            block_t *chk_p, int strideChk, int abft, block_t *A1_p)
+#else
+            block_t *chk_p, int strideChk, int abft)
+#endif
+{
+#ifdef MM_TOP_ONE_BUNDLE
+#pragma HLS INTERFACE m_axi port = A_p offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = B_p offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = AB_p offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = occ_p offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = epi_p offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = chk_p offset = slave bundle = gmem0
+#else
+#pragma HLS INTERFACE m_axi port = A_p offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = B_p offset = slave bundle = gmem1
+#pragma HLS INTERFACE m_axi port = AB_p offset = slave bundle = gmem2
+#pragma HLS INTERFACE m_axi port = occ_p offset = slave bundle = gmem0
+#pragma HLS INTERFACE m_axi port = epi_p offset = slave bundle = gmem2
+#pragma HLS INTERFACE m_axi port = chk_p offset = slave bundle = gmem2
+#endif
+#pragma HLS INTERFACE s_axilite port = A_p bundle = control
+#pragma HLS INTERFACE s_axilite port = B_p bundle = control
+#pragma HLS INTERFACE s_axilite port = AB_p bundle = control
+#pragma HLS INTERFACE s_axilite port = Mdim bundle = control
+#pragma HLS INTERFACE s_axilite port = Kdim bundle = control
+#pragma HLS INTERFACE s_axilite port = Ndim bundle = control
+#pragma HLS INTERFACE s_axilite port = batch bundle = control
+#pragma HLS INTERFACE s_axilite port = strideA bundle = control
+#pragma HLS INTERFACE s_axilite port = strideB bundle = control
+#pragma HLS INTERFACE s_axilite port = strideAB bundle = control
+#pragma HLS INTERFACE s_axilite port = tile_first bundle = control
+#pragma HLS INTERFACE s_axilite port = tile_count bundle = control
+#pragma HLS INTERFACE s_axilite port = order bundle = control
+#pragma HLS INTERFACE s_axilite port = occ_p bundle = control
+#pragma HLS INTERFACE s_axilite port = strideOcc bundle = control
+#pragma HLS INTERFACE s_axilite port = sparse bundle = control
+#pragma HLS INTERFACE s_axilite port = epi_p bundle = control
+#pragma HLS INTERFACE s_axilite port = epilogue bundle = control
+#pragma HLS INTERFACE s_axilite port = shift bundle = control
+#pragma HLS INTERFACE s_axilite port = act_lo bundle = control
+#pragma HLS INTERFACE s_axilite port = act_hi bundle = control
+#pragma HLS INTERFACE s_axilite port = chk_p bundle = control
+#pragma HLS INTERFACE s_axilite port = strideChk bundle = control
+#pragma HLS INTERFACE s_axilite port = abft bundle = control
+#ifdef MM_TOP_SPLIT_A
+#pragma HLS INTERFACE m_axi port = A1_p offset = slave bundle = gmem3
+#pragma HLS INTERFACE s_axilite port = A1_p bundle = control
+#endif
+#pragma HLS INTERFACE s_axilite port = return bundle = control
+
+#ifdef MM_TOP_SPLIT_A
+	mm_body<KT>::run(A_p, A1_p, B_p, AB_p, occ_p, epi_p, Mdim, Kdim, Ndim, batch, strideA, strideB, strideAB, strideOcc,
+	                 sparse, epilogue, shift, act_lo, act_hi, tile_first, tile_count, order, chk_p, strideChk, abft);
+#else
+	mm_body<KT>::run(A_p, B_p, AB_p, occ_p, epi_p, Mdim, Kdim, Ndim, batch, strideA, strideB, strideAB, strideOcc,
+	                 sparse, epilogue, shift, act_lo, act_hi, tile_first, tile_count, order, chk_p, strideChk, abft);
+#endif
+}
+
+}
+
+#endif
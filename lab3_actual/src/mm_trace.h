@@ -0,0 +1,183 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Phase-level timing of the host flow.
+//
+// Phases (xclbin load, BO allocation, map, sync in, kernel, sync out, data
+// generation, validation) are recorded as intervals with nanosecond
+// timestamps, the recording thread and the job they belong to. The job is
+// a per-thread value set with mm_trace_job, so code that works on one job
+// at a time doesn't have to pass it around.
+//
+// Tracing is off until mm_tracer::get().enable() is called; a disabled
+// scope costs one relaxed atomic load. The events can be written as Chrome
+// trace-event JSON (chrome://tracing, Perfetto) and summarized per phase
+// with percentiles and a log2 histogram.
+
+#ifndef MM_TRACE_H
+#define MM_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mm_stats.h"
+
+class mm_tracer {
+public:
+    struct event {
+        const char *name;
+        uint64_t start_ns, end_ns;
+        int tid;
+        int job; // -1 if not part of a job
+    };
+
+    static mm_tracer &get() {
+        static mm_tracer t;
+        return t;
+    }
+
+    void enable() { on.store(true, std::memory_order_relaxed); }
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    // Nanoseconds since the tracer was created.
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(const char *name, uint64_t start_ns, uint64_t end_ns, int job) {
+        if (!enabled())
+            return;
+        std::lock_guard<std::mutex> lock(mu);
+        events.push_back(event{name, start_ns, end_ns, thread_id(), job});
+    }
+    void record(const char *name, uint64_t start_ns, uint64_t end_ns) { record(name, start_ns, end_ns, job()); }
+
+    // Job of the calling thread.
+    static int &job() {
+        static thread_local int current = -1;
+        return current;
+    }
+
+    std::vector<event> snapshot() {
+        std::lock_guard<std::mutex> lock(mu);
+        return events;
+    }
+
+    bool write_chrome(const std::string &path) {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+        std::vector<event> ev = snapshot();
+        for (size_t i = 0; i < ev.size(); i++) {
+            char line[256];
+            std::snprintf(line, sizeof(line),
+                          "  {\"name\": \"%s\", \"cat\": \"mm\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, "
+                          "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"job\": %d}}%s\n",
+                          ev[i].name, ev[i].tid, ev[i].start_ns * 1e-3, (ev[i].end_ns - ev[i].start_ns) * 1e-3,
+                          ev[i].job, i + 1 < ev.size() ? "," : "");
+            out << line;
+        }
+        out << "]}\n";
+        return (bool) out;
+    }
+
+    // Per phase: count, total, median/p95/p99/max and a histogram with one
+    // bucket per power of two microseconds.
+    void print_summary(FILE *f = stdout) {
+        std::map<std::string, mm_samples> phases;
+        std::map<std::string, std::map<int, int>> buckets;
+        for (const event &e : snapshot()) {
+            double us = (e.end_ns - e.start_ns) * 1e-3;
+            phases[e.name].add(us);
+            int b = 0;
+            while (b < 40 && (1ull << b) <= us)
+                b++;
+            buckets[e.name][b]++;
+        }
+        std::fprintf(f, "%-12s %7s %12s %12s %12s %12s %12s\n", "phase", "count", "total(ms)", "median(us)",
+                     "p95(us)", "p99(us)", "max(us)");
+        for (auto &p : phases) {
+            mm_samples &s = p.second;
+            std::fprintf(f, "%-12s %7d %12.3f %12.1f %12.1f %12.1f %12.1f\n", p.first.c_str(), s.size(),
+                         s.mean() * s.size() * 1e-3, s.median(), s.percentile(95), s.percentile(99), s.max());
+        }
+        for (auto &p : buckets) {
+            std::fprintf(f, "\n%s:\n", p.first.c_str());
+            int most = 0;
+            for (auto &b : p.second)
+                most = std::max(most, b.second);
+            for (auto &b : p.second) {
+                std::string bar((size_t) (40.0 * b.second / most + 0.5), '#');
+                std::fprintf(f, "  < %10llu us %7d %s\n", 1ull << b.first, b.second, bar.c_str());
+            }
+        }
+    }
+
+private:
+    mm_tracer() : epoch(std::chrono::steady_clock::now()), on(false) {}
+
+    int thread_id() {
+        static std::atomic<int> next(0);
+        static thread_local int id = next++;
+        return id;
+    }
+
+    std::chrono::steady_clock::time_point epoch;
+    std::atomic<bool> on;
+    std::mutex mu;
+    std::vector<event> events;
+};
+
+// Records the enclosing block as one phase.
+class mm_trace_scope {
+public:
+    explicit mm_trace_scope(const char *name) : name(name), start(mm_tracer::get().enabled() ? mm_tracer::get().now() : 0) {}
+    ~mm_trace_scope() {
+        if (mm_tracer::get().enabled())
+            mm_tracer::get().record(name, start, mm_tracer::get().now());
+    }
+
+    mm_trace_scope(const mm_trace_scope &) = delete;
+    mm_trace_scope &operator=(const mm_trace_scope &) = delete;
+
+private:
+    const char *name;
+    uint64_t start;
+};
+
+// Attributes everything the calling thread records in this block to a job.
+class mm_trace_job {
+public:
+    explicit mm_trace_job(int job) : saved(mm_tracer::job()) { mm_tracer::job() = job; }
+    ~mm_trace_job() { mm_tracer::job() = saved; }
+
+    mm_trace_job(const mm_trace_job &) = delete;
+    mm_trace_job &operator=(const mm_trace_job &) = delete;
+
+private:
+    int saved;
+};
+
+#endif
@@ -0,0 +1,318 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Element types of the host side, the counterpart of the kernels' mm_elem.h.
+//
+// The types are fixed at build time with the flags of mm_config.h and have
+// to match the flags the xclbin was built with. Integer elements are packed
+// into the block_t beats little-endian, element e of a buffer occupying
+// bits [e * BITS, (e + 1) * BITS), so 8, 16 and 32 bit operands are plain
+// arrays and 4 bit operands store two elements per byte, low nibble first.
+// ap_fixed elements are stored as their raw two's complement bits, float
+// and half as their IEEE encodings.
+//
+// Every family has an element accessor for A/B (in) and AB (out) with
+// get/set of the value as a double. The exact families (integer, fixed)
+// also expose the raw integer bits, which the reference accumulates on;
+// their results are compared bit for bit. Float and half results depend
+// on the order of the additions and are compared with a relative
+// tolerance.
+
+#ifndef MM_TYPES_H
+#define MM_TYPES_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "mm_config.h"
+
+// Sign-extends the low BITS bits of v, i.e. what a BITS wide register holds.
+template <int BITS> inline int64_t mm_wrap(int64_t v) {
+    return (int64_t) ((uint64_t) v << (64 - BITS)) >> (64 - BITS);
+}
+
+// Host storage of BITS wide integers.
+template <int BITS> struct mm_elem {
+    typedef typename std::conditional<BITS <= 8, int8_t,
+            typename std::conditional<BITS <= 16, int16_t, int32_t>::type>::type storage_t;
+
+    static int64_t get_raw(const void *p, size_t e) { return ((const storage_t *) p)[e]; }
+    static void set_raw(void *p, size_t e, int64_t v) { ((storage_t *) p)[e] = (storage_t) v; }
+    static double get(const void *p, size_t e) { return (double) get_raw(p, e); }
+    static void set(void *p, size_t e, double v) { set_raw(p, e, (int64_t) v); }
+};
+
+template <> struct mm_elem<4> {
+    typedef int8_t storage_t;
+
+    static int64_t get_raw(const void *p, size_t e) {
+        return mm_wrap<4>(((const uint8_t *) p)[e / 2] >> (e % 2 * 4));
+    }
+    static void set_raw(void *p, size_t e, int64_t v) {
+        uint8_t &byte = ((uint8_t *) p)[e / 2];
+        int sh = e % 2 * 4;
+        byte = (uint8_t) ((byte & ~(0xf << sh)) | ((v & 0xf) << sh));
+    }
+    static double get(const void *p, size_t e) { return (double) get_raw(p, e); }
+    static void set(void *p, size_t e, double v) { set_raw(p, e, (int64_t) v); }
+};
+
+// ap_fixed<W, I>: the raw bits are the value times 2^(W - I). set() truncates
+// towards minus infinity and wraps, as AP_TRN / AP_WRAP do.
+template <int W, int I> struct mm_fixed_elem {
+    typedef typename mm_elem<W>::storage_t storage_t;
+    static const int frac_bits = W - I;
+
+    static int64_t get_raw(const void *p, size_t e) { return mm_elem<W>::get_raw(p, e); }
+    static void set_raw(void *p, size_t e, int64_t v) { mm_elem<W>::set_raw(p, e, v); }
+    static double get(const void *p, size_t e) { return std::ldexp((double) get_raw(p, e), -frac_bits); }
+    static void set(void *p, size_t e, double v) {
+        set_raw(p, e, mm_wrap<W>((int64_t) std::floor(std::ldexp(v, frac_bits))));
+    }
+};
+
+struct mm_float_elem {
+    typedef float storage_t;
+
+    static double get(const void *p, size_t e) { return ((const float *) p)[e]; }
+    static void set(void *p, size_t e, double v) { ((float *) p)[e] = (float) v; }
+};
+
+// IEEE binary16 <-> binary32, round to nearest even.
+inline float mm_half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16, exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+    if (exp == 0) {
+        float f = std::ldexp((float) mant, -24);
+        return sign ? -f : f;
+    }
+    uint32_t x = sign | (exp == 31 ? 0x7f800000 | mant << 13 : (exp + 112) << 23 | mant << 13);
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+inline uint16_t mm_float_to_half(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000, mant = x & 0x7fffff;
+    int fexp = (x >> 23) & 0xff, exp = fexp - 127 + 15;
+    if (fexp == 0xff)
+        return (uint16_t) (sign | 0x7c00 | (mant ? 0x200 : 0));
+    if (exp >= 31)
+        return (uint16_t) (sign | 0x7c00);
+    uint32_t h, rem, half;
+    if (exp <= 0) {
+        // subnormal or zero
+        if (exp < -10)
+            return (uint16_t) sign;
+        mant |= 0x800000;
+        int shift = 14 - exp;
+        h = mant >> shift;
+        rem = mant & ((1u << shift) - 1);
+        half = 1u << (shift - 1);
+    } else {
+        h = (uint32_t) exp << 10 | mant >> 13;
+        rem = mant & 0x1fff;
+        half = 0x1000;
+    }
+    // a carry out of the mantissa correctly bumps the exponent
+    if (rem > half || (rem == half && (h & 1)))
+        h++;
+    return (uint16_t) (sign | h);
+}
+
+struct mm_half_elem {
+    typedef uint16_t storage_t;
+
+    static double get(const void *p, size_t e) { return mm_half_to_float(((const uint16_t *) p)[e]); }
+    static void set(void *p, size_t e, double v) { ((uint16_t *) p)[e] = mm_float_to_half((float) v); }
+};
+
+// Fused output epilogue of the kernels (mm_elem.h). flags combine the
+// EPILOGUE_ bits; bias and scale are per-column 32 bit words, int32 for the
+// exact families and float otherwise (mm_epilogue_word()).
+enum { EPILOGUE_BIAS = 1, EPILOGUE_SCALE = 2, EPILOGUE_RELU = 4, EPILOGUE_CLAMP = 8 };
+
+struct mm_epilogue {
+    int flags = 0;
+    int shift = 0;
+    int act_lo = 0, act_hi = 0;
+};
+
+// The exact epilogue on a raw sum: bias, requantizing multiply rounded to
+// nearest, frac_shift fraction bits dropped (rounding down), saturation
+// to out_bits when requantizing, then the activation.
+inline int64_t mm_epilogue_raw(int64_t v, int frac_shift, int out_bits, uint32_t bias, uint32_t scale,
+                               const mm_epilogue &e) {
+    if (e.flags & EPILOGUE_BIAS)
+        v += (int32_t) bias;
+    if (e.flags & EPILOGUE_SCALE) {
+        v = (int64_t) ((uint64_t) v * (uint64_t) (int64_t) (int32_t) scale);
+        if (e.shift > 0)
+            v = (v + ((int64_t) 1 << (e.shift - 1))) >> e.shift;
+    }
+    v >>= frac_shift;
+    if (e.flags & EPILOGUE_SCALE) {
+        int64_t hi = ((int64_t) 1 << (out_bits - 1)) - 1;
+        v = std::min(std::max(v, -hi - 1), hi);
+    }
+    if ((e.flags & EPILOGUE_RELU) && v < 0)
+        v = 0;
+    if (e.flags & EPILOGUE_CLAMP)
+        v = std::min(std::max(v, (int64_t) e.act_lo), (int64_t) e.act_hi);
+    return v;
+}
+
+inline float mm_epilogue_float(float v, uint32_t bias, uint32_t scale, const mm_epilogue &e) {
+    float b, m;
+    std::memcpy(&b, &bias, sizeof(b));
+    std::memcpy(&m, &scale, sizeof(m));
+    if (e.flags & EPILOGUE_BIAS)
+        v += b;
+    if (e.flags & EPILOGUE_SCALE)
+        v *= m;
+    if ((e.flags & EPILOGUE_RELU) && v < 0)
+        v = 0;
+    if (e.flags & EPILOGUE_CLAMP)
+        v = v < e.act_lo ? (float) e.act_lo : v > e.act_hi ? (float) e.act_hi : v;
+    return v;
+}
+
+// Integers: IN_BITS wide A and B, the kernels accumulate in ACC_BITS and
+// write OUT_BITS wide results. The defaults (16/16/16) are the original
+// kernels, whose sums wrap at 16 bits; int8 inference is -DMM_IN_BITS=8
+// -DMM_ACC_BITS=32.
+template <int IN_BITS, int ACC_BITS, int OUT_BITS> struct mm_types {
+    static_assert(IN_BITS == 4 || IN_BITS == 8 || IN_BITS == 16 || IN_BITS == 32,
+                  "inputs are 4, 8, 16 or 32 bits");
+    static_assert(OUT_BITS == 8 || OUT_BITS == 16 || OUT_BITS == 32, "outputs are 8, 16 or 32 bits");
+    static_assert(ACC_BITS >= 1 && ACC_BITS <= 64, "accumulators are at most 64 bits");
+
+    static const int in_bits = IN_BITS;
+    static const int acc_bits = ACC_BITS;
+    static const int out_bits = OUT_BITS;
+    static const int frac_bits = 0;
+    static const bool exact = true;
+    static constexpr double tolerance = 0;
+
+    typedef mm_elem<IN_BITS> in;
+    typedef mm_elem<OUT_BITS> out;
+
+    // The kernel's raw result for an exact sum of raw products.
+    static int64_t result(int64_t sum) { return mm_wrap<OUT_BITS>(mm_wrap<ACC_BITS>(sum)); }
+    // ... and with the epilogue applied.
+    static int64_t result(int64_t sum, uint32_t bias, uint32_t scale, const mm_epilogue &e) {
+        return mm_wrap<OUT_BITS>(mm_epilogue_raw(mm_wrap<ACC_BITS>(sum), 0, OUT_BITS, bias, scale, e));
+    }
+    // Test data, small enough that the default 16 bit sums rarely wrap.
+    static double sample(int r) { return r % 8; }
+    static std::string name() {
+        return "int" + std::to_string(IN_BITS) + " inputs, int" + std::to_string(ACC_BITS) +
+               " accumulators, int" + std::to_string(OUT_BITS) + " outputs";
+    }
+};
+
+// ap_fixed<W, I> A, B and AB. Raw products carry 2 (W - I) fraction bits,
+// which the ACC_BITS wide accumulator keeps; the sum is then truncated and
+// wrapped to ap_fixed<W, I>.
+template <int W, int I, int ACC_BITS> struct mm_fixed_types {
+    static_assert(W == 4 || W == 8 || W == 16 || W == 32, "ap_fixed elements are 4, 8, 16 or 32 bits");
+    static_assert(I <= W, "more integer bits than bits");
+    static_assert(ACC_BITS > 2 * (W - I) && ACC_BITS <= 64, "the accumulator holds every product fraction bit");
+
+    static const int in_bits = W;
+    static const int acc_bits = ACC_BITS;
+    static const int out_bits = W;
+    static const int frac_bits = W - I;
+    static const bool exact = true;
+    static constexpr double tolerance = 0;
+
+    typedef mm_fixed_elem<W, I> in;
+    typedef mm_fixed_elem<W, I> out;
+
+    static int64_t result(int64_t sum) { return mm_wrap<W>(mm_wrap<ACC_BITS>(sum) >> (W - I)); }
+    static int64_t result(int64_t sum, uint32_t bias, uint32_t scale, const mm_epilogue &e) {
+        return mm_wrap<W>(mm_epilogue_raw(mm_wrap<ACC_BITS>(sum), W - I, W, bias, scale, e));
+    }
+    static double sample(int r) { return (r % 2001 - 1000) / 500.0; }
+    static std::string name() {
+        return "ap_fixed<" + std::to_string(W) + "," + std::to_string(I) + "> inputs and outputs, " +
+               std::to_string(ACC_BITS) + " bit accumulators";
+    }
+};
+
+struct mm_float_types {
+    static const int in_bits = 32;
+    static const int acc_bits = 32;
+    static const int out_bits = 32;
+    static const bool exact = false;
+    static constexpr double tolerance = 1e-4;
+
+    typedef mm_float_elem in;
+    typedef mm_float_elem out;
+
+    static double sample(int r) { return (r % 2001 - 1000) / 500.0; }
+    static std::string name() { return "float inputs, accumulators and outputs"; }
+};
+
+// half operands and results around float accumulators; the tolerance
+// covers the final rounding to half.
+struct mm_half_types {
+    static const int in_bits = 16;
+    static const int acc_bits = 32;
+    static const int out_bits = 16;
+    static const bool exact = false;
+    static constexpr double tolerance = 1e-2;
+
+    typedef mm_half_elem in;
+    typedef mm_half_elem out;
+
+    static double sample(int r) { return (r % 2001 - 1000) / 500.0; }
+    static std::string name() { return "half inputs and outputs, float accumulators"; }
+};
+
+#if defined(MM_FLOAT)
+typedef mm_float_types mm_t;
+#elif defined(MM_HALF)
+typedef mm_half_types mm_t;
+#elif defined(MM_FIXED_W)
+typedef mm_fixed_types<MM_FIXED_W, MM_FIXED_I, MM_ACC_BITS> mm_t;
+#else
+typedef mm_types<MM_IN_BITS, MM_ACC_BITS, MM_OUT_BITS> mm_t;
+#endif
+
+// An epilogue bias or scale word holding v: int32 for the exact families,
+// float otherwise.
+inline uint32_t mm_epilogue_word(double v) {
+    if (mm_t::exact)
+        return (uint32_t) (int32_t) v;
+    float f = (float) v;
+    uint32_t w;
+    std::memcpy(&w, &f, sizeof(w));
+    return w;
+}
+
+// Host pointers to A/B and AB. 4 bit operands are packed, index them
+// through mm_t::in rather than directly.
+typedef mm_t::in::storage_t mm_in_t;
+typedef mm_t::out::storage_t mm_out_t;
+
+#endif
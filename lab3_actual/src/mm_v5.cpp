@@ -0,0 +1,68 @@
+/**********
+Copyright (c) 2019, Xilinx, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software
+without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE,
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********/
+
+// mm_v5: same interface, feeders and panels as mm_v4, but the tile is
+// computed by a 2D systolic array (pe_array in mm_kernel.h) instead of one
+// fully unrolled M wide row of MACs, and A reaches comp as whole beats.
+
+#include "mm_kernel.h"
+
+#ifndef MM_A_PANELS
+#define MM_A_PANELS 1
+#endif
+#ifndef MM_B_PANELS
+#define MM_B_PANELS 1
+#endif
+#ifndef MM_PANEL_K
+#define MM_PANEL_K 1024
+#endif
+
+// Processing elements of the systolic array, both must divide M.
+#ifndef MM_SA_ROWS
+#define MM_SA_ROWS 32
+#endif
+#ifndef MM_SA_COLS
+#define MM_SA_COLS 32
+#endif
+
+struct mm_cfg : mm_kernel_cfg {
+	static const int A_PANELS = MM_A_PANELS;
+	static const int B_PANELS = MM_B_PANELS;
+	static const int PANEL_K = MM_PANEL_K;
+	static const int SA_ROWS = MM_SA_ROWS;
+	static const int SA_COLS = MM_SA_COLS;
+};
+
+#include "mm_top.h"
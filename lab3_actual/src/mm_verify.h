@@ -0,0 +1,281 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Probabilistic verification of kernel results (Freivalds' algorithm).
+//
+// Instead of recomputing A * B in O(MKN), every round draws a random vector
+// r and checks AB r against A (B r), and a random c to check c^T AB against
+// (c^T A) B, each in O(MK + KN + MN). A wrong result passes a round with
+// probability at most 1/2, so `rounds` rounds accept it with probability at
+// most 2^-rounds. The row checks that fail name the wrong rows, the column
+// checks the wrong columns, and the entries where they cross are recomputed
+// one by one to localize the errors.
+//
+// Integers check in the kernel's own modular arithmetic: their result is
+// the sum (plus bias) wrapped to m = min(out_bits, acc_bits) bits, so
+// AB r == A (B r) + bias . r holds exactly modulo 2^m, with r in {0, 1}^N.
+// Float and half sums may differ by the error mm_close() allows each entry
+// plus the float rounding of the kernel's sums, so a wrong entry is only
+// caught when its error exceeds that slack summed over its row or column.
+// ReLU, clamp, the integer
+// requantizing scale and the fraction bits ap_fixed truncates are not
+// linear; results using them need the full reference GEMM.
+
+#ifndef MM_VERIFY_H
+#define MM_VERIFY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "mm_ref.h"
+
+struct mm_verify_result {
+    bool supported = true;                  // false when the epilogue is not linear
+    int rounds = 0;
+    std::vector<int> rows, cols;            // rows and columns whose checks failed
+    std::vector<std::pair<int, int>> wrong; // recomputed (i, j) entries that differ
+
+    bool ok() const { return supported && rows.empty() && cols.empty(); }
+};
+
+// Entries recomputed at most to localize errors; beyond that only the
+// failing rows and columns are reported.
+const long MM_VERIFY_LOCATE_MAX = 1 << 20;
+
+template <class T, bool EXACT = T::exact> struct mm_verify_impl {
+    static const int BITS = std::min(T::out_bits, T::acc_bits);
+
+    static bool supported(const mm_epilogue &e) { return T::frac_bits == 0 && !(e.flags & ~EPILOGUE_BIAS); }
+
+    static uint64_t mask() { return BITS >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << BITS) - 1; }
+    static uint64_t a(const mm_shape &s, const void *A, int i, int k) { return T::in::get_raw(A, s.a_index(i, k)); }
+    static uint64_t b(const mm_shape &s, const void *B, int k, int j) { return T::in::get_raw(B, s.b_index(k, j)); }
+    static uint64_t ab(const mm_shape &s, const void *AB, int i, int j) {
+        return T::out::get_raw(AB, s.ab_index(i, j));
+    }
+    static uint64_t bias(const mm_ref_epilogue &epi, int j) {
+        return epi.e.flags & EPILOGUE_BIAS ? (uint64_t) (int64_t) (int32_t) epi.b(j) : 0;
+    }
+
+    static void rows(const mm_shape &s, const void *A, const void *B, const void *AB, const mm_ref_epilogue &epi,
+                     double tol, std::mt19937_64 &rng, std::vector<char> &bad) {
+        (void) tol;
+        std::vector<uint64_t> r(s.N), Br(s.K, 0);
+        uint64_t bias_r = 0;
+        for (int j = 0; j < s.N; j++) {
+            r[j] = rng() & 1;
+            bias_r += bias(epi, j) * r[j];
+        }
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < s.K; k++)
+            for (int j = 0; j < s.N; j++)
+                Br[k] += b(s, B, k, j) * r[j];
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < s.M; i++) {
+            uint64_t lhs = 0, rhs = bias_r;
+            for (int j = 0; j < s.N; j++)
+                lhs += ab(s, AB, i, j) * r[j];
+            for (int k = 0; k < s.K; k++)
+                rhs += a(s, A, i, k) * Br[k];
+            if ((lhs - rhs) & mask())
+                bad[i] = 1;
+        }
+    }
+
+    static void cols(const mm_shape &s, const void *A, const void *B, const void *AB, const mm_ref_epilogue &epi,
+                     double tol, std::mt19937_64 &rng, std::vector<char> &bad) {
+        (void) tol;
+        std::vector<uint64_t> c(s.M), cA(s.K, 0);
+        uint64_t ones = 0;
+        for (int i = 0; i < s.M; i++) {
+            c[i] = rng() & 1;
+            ones += c[i];
+        }
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < s.K; k++)
+            for (int i = 0; i < s.M; i++)
+                cA[k] += c[i] * a(s, A, i, k);
+#pragma omp parallel for schedule(static)
+        for (int j = 0; j < s.N; j++) {
+            uint64_t lhs = 0, rhs = bias(epi, j) * ones;
+            for (int i = 0; i < s.M; i++)
+                lhs += c[i] * ab(s, AB, i, j);
+            for (int k = 0; k < s.K; k++)
+                rhs += cA[k] * b(s, B, k, j);
+            if ((lhs - rhs) & mask())
+                bad[j] = 1;
+        }
+    }
+
+    static bool wrong(const mm_shape &s, const void *A, const void *B, const void *AB, const mm_ref_epilogue &epi,
+                      double tol, int i, int j) {
+        uint64_t sum = 0;
+        for (int k = 0; k < s.K; k++)
+            sum += a(s, A, i, k) * b(s, B, k, j);
+        (void) tol;
+        return T::result((int64_t) sum, epi.b(j), epi.s(j), epi.e) != T::out::get_raw(AB, s.ab_index(i, j));
+    }
+};
+
+template <class T> struct mm_verify_impl<T, false> {
+    static bool supported(const mm_epilogue &e) { return !(e.flags & ~(EPILOGUE_BIAS | EPILOGUE_SCALE)); }
+
+    // bias and scale of column j, 0 and 1 when unused
+    static float word(uint32_t w) {
+        float f;
+        std::memcpy(&f, &w, sizeof(f));
+        return f;
+    }
+    static double bias(const mm_ref_epilogue &epi, int j) {
+        return epi.e.flags & EPILOGUE_BIAS ? word(epi.b(j)) : 0;
+    }
+    static double scale(const mm_ref_epilogue &epi, int j) {
+        return epi.e.flags & EPILOGUE_SCALE ? word(epi.s(j)) : 1;
+    }
+    // what mm_close() allows an entry, and the float rounding of a sum of K
+    // products of magnitude `mag`, sqrt(K) unit roundoffs
+    static double allowed(double hw, double tol) { return tol * std::max(1.0, (std::fabs(hw) + tol) / (1 - tol)); }
+    static double rounding(const mm_shape &s, double mag) { return std::ldexp(std::sqrt((double) s.K), -24) * mag; }
+
+    // AB_ij = s_j (sum_k A_ik B_kj + b_j), so AB r = A (B (s r)) + b . (s r)
+    static void rows(const mm_shape &s, const void *A, const void *B, const void *AB, const mm_ref_epilogue &epi,
+                     double tol, std::mt19937_64 &rng, std::vector<char> &bad) {
+        std::uniform_real_distribution<double> dist(-1, 1);
+        std::vector<double> r(s.N), sr(s.N), Br(s.K, 0), Br_abs(s.K, 0);
+        double bias_r = 0;
+        for (int j = 0; j < s.N; j++) {
+            r[j] = dist(rng);
+            sr[j] = scale(epi, j) * r[j];
+            bias_r += bias(epi, j) * sr[j];
+        }
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < s.K; k++)
+            for (int j = 0; j < s.N; j++) {
+                double v = s.get_b(B, k, j);
+                Br[k] += v * sr[j];
+                Br_abs[k] += std::fabs(v * sr[j]);
+            }
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < s.M; i++) {
+            double lhs = 0, rhs = bias_r, bound = 0, mag = 0;
+            for (int j = 0; j < s.N; j++) {
+                double hw = s.get_ab(AB, i, j);
+                lhs += hw * r[j];
+                bound += allowed(hw, tol) * std::fabs(r[j]);
+            }
+            for (int k = 0; k < s.K; k++) {
+                double v = s.get_a(A, i, k);
+                rhs += v * Br[k];
+                mag += std::fabs(v) * Br_abs[k];
+            }
+            if (std::fabs(lhs - rhs) > bound + rounding(s, mag))
+                bad[i] = 1;
+        }
+    }
+
+    static void cols(const mm_shape &s, const void *A, const void *B, const void *AB, const mm_ref_epilogue &epi,
+                     double tol, std::mt19937_64 &rng, std::vector<char> &bad) {
+        std::uniform_real_distribution<double> dist(-1, 1);
+        std::vector<double> c(s.M), cA(s.K, 0), cA_abs(s.K, 0);
+        double c_sum = 0;
+        for (int i = 0; i < s.M; i++) {
+            c[i] = dist(rng);
+            c_sum += c[i];
+        }
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < s.K; k++)
+            for (int i = 0; i < s.M; i++) {
+                double v = s.get_a(A, i, k);
+                cA[k] += c[i] * v;
+                cA_abs[k] += std::fabs(c[i] * v);
+            }
+#pragma omp parallel for schedule(static)
+        for (int j = 0; j < s.N; j++) {
+            double lhs = 0, rhs = bias(epi, j) * c_sum, bound = 0, mag = 0;
+            for (int i = 0; i < s.M; i++) {
+                double hw = s.get_ab(AB, i, j);
+                lhs += c[i] * hw;
+                bound += allowed(hw, tol) * std::fabs(c[i]);
+            }
+            for (int k = 0; k < s.K; k++) {
+                double v = s.get_b(B, k, j);
+                rhs += cA[k] * v;
+                mag += cA_abs[k] * std::fabs(v);
+            }
+            double m = scale(epi, j);
+            if (std::fabs(lhs - m * rhs) > bound + rounding(s, std::fabs(m) * mag))
+                bad[j] = 1;
+        }
+    }
+
+    // summed in float in k order like mm_ref, rounded to the output type
+    static bool wrong(const mm_shape &s, const void *A, const void *B, const void *AB, const mm_ref_epilogue &epi,
+                      double tol, int i, int j) {
+        float sum = 0;
+        for (int k = 0; k < s.K; k++)
+            sum += (float) s.get_a(A, i, k) * (float) s.get_b(B, k, j);
+        typename T::out::storage_t sw;
+        T::out::set(&sw, 0, mm_epilogue_float(sum, epi.b(j), epi.s(j), epi.e));
+        return !mm_close(T::out::get(&sw, 0), s.get_ab(AB, i, j), tol);
+    }
+};
+
+// Whether results finished with e can be verified by mm_freivalds().
+inline bool mm_verify_supported(const mm_epilogue &e) { return mm_verify_impl<mm_t>::supported(e); }
+
+// Verifies one result AB of A * B laid out as described by shape, finished
+// with epilogue e and its per-column bias / scale words, by `rounds` rounds
+// of row and column checks with random vectors drawn from seed. tol is the
+// relative tolerance of the float and half entries, as for mm_close().
+inline mm_verify_result mm_freivalds(const mm_shape &shape, const void *A, const void *B, const void *AB, int rounds,
+                                     const mm_epilogue &e = mm_epilogue(), const uint32_t *bias = nullptr,
+                                     const uint32_t *scale = nullptr, uint64_t seed = 1,
+                                     double tol = mm_t::tolerance) {
+    typedef mm_verify_impl<mm_t> impl;
+    mm_verify_result res;
+    if (!mm_verify_supported(e)) {
+        res.supported = false;
+        return res;
+    }
+    mm_ref_epilogue epi{e, bias, scale};
+    std::mt19937_64 rng(seed);
+    std::vector<char> bad_rows(shape.M, 0), bad_cols(shape.N, 0);
+    for (int r = 0; r < rounds; r++) {
+        impl::rows(shape, A, B, AB, epi, tol, rng, bad_rows);
+        impl::cols(shape, A, B, AB, epi, tol, rng, bad_cols);
+    }
+    res.rounds = rounds;
+    for (int i = 0; i < shape.M; i++)
+        if (bad_rows[i])
+            res.rows.push_back(i);
+    for (int j = 0; j < shape.N; j++)
+        if (bad_cols[j])
+            res.cols.push_back(j);
+
+    if ((long) res.rows.size() * (long) res.cols.size() <= MM_VERIFY_LOCATE_MAX)
+        for (int i : res.rows)
+            for (int j : res.cols)
+                if (impl::wrong(shape, A, B, AB, epi, tol, i, j))
+                    res.wrong.push_back(std::make_pair(i, j));
+    return res;
+}
+
+#endif
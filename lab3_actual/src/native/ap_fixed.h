@@ -0,0 +1,86 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Lightweight stand-in for the vendor ap_fixed.h, used to build the kernels
+// natively (-DMM_NATIVE -Inative). Only what the kernels use is provided:
+// ap_fixed<W, I> of up to 64 bits with the default AP_TRN quantization and
+// AP_WRAP overflow modes, full precision products, += and .range(hi, lo)
+// access to the raw bits.
+//
+// The value is a W bit two's complement integer scaled by 2^-(W - I).
+
+#ifndef MM_NATIVE_AP_FIXED_H
+#define MM_NATIVE_AP_FIXED_H
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#include "ap_int.h"
+
+template <int W, int I> class ap_fixed {
+    static_assert(W > 0 && W <= 64, "native ap_fixed is at most 64 bits");
+    static_assert(I <= W, "native ap_fixed has no negative fraction widths");
+
+public:
+    static const int width = W;
+    static const int iwidth = I;
+    static const int fwidth = W - I;
+
+    ap_fixed() : v(0) {}
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    ap_fixed(T x) : v(scale((int64_t) x, 0)) {}
+
+    ap_fixed(double x) : v((int64_t) std::floor(std::ldexp(x, fwidth))) {}
+
+    // AP_TRN drops the extra fraction bits (rounding towards minus
+    // infinity), AP_WRAP the extra integer bits.
+    template <int W2, int I2> ap_fixed(const ap_fixed<W2, I2> &x) : v(scale(x.raw(), W2 - I2)) {}
+
+    template <int W2, int I2> ap_fixed<W + W2, I + I2> operator*(const ap_fixed<W2, I2> &b) const {
+        static_assert(W + W2 <= 64, "native ap_fixed products are at most 64 bits");
+        return ap_fixed<W + W2, I + I2>::from_raw(raw() * b.raw());
+    }
+
+    template <int W2, int I2> ap_fixed &operator+=(const ap_fixed<W2, I2> &b) {
+        static_assert(W2 - I2 <= W - I, "native ap_fixed sums are not rounded");
+        v = (int64_t) v + scale(b.raw(), W2 - I2);
+        return *this;
+    }
+
+    double to_double() const { return std::ldexp((double) raw(), -fwidth); }
+
+    ap_range_ref<W, true> range(int hi, int lo) { return v.range(hi, lo); }
+    uint64_t range(int hi, int lo) const { return v.range(hi, lo); }
+
+    int64_t raw() const { return v; }
+    static ap_fixed from_raw(int64_t r) {
+        ap_fixed x;
+        x.v = r;
+        return x;
+    }
+
+private:
+    // raw value r with f fraction bits, moved to this type's fraction bits
+    static int64_t scale(int64_t r, int f) {
+        return f <= fwidth ? (int64_t) ((uint64_t) r << (fwidth - f)) : r >> (f - fwidth);
+    }
+
+    ap_int<W> v;
+};
+
+#endif
@@ -0,0 +1,174 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Lightweight stand-in for the vendor ap_int.h, used to build the kernels
+// natively (-DMM_NATIVE -Inative). Only what the kernels use is provided:
+// ap_int<W> / ap_uint<W> of any width, .range(hi, lo) and (hi, lo) slices
+// of up to 64 bits, and integer arithmetic for widths up to 64 bits.
+//
+// Values are stored little-endian in 64 bit words, so an ap_int<512> has
+// the same bytes as the 64 byte beat it models and buffers can be cast.
+
+#ifndef MM_NATIVE_AP_INT_H
+#define MM_NATIVE_AP_INT_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+template <int W, bool S> class ap_int_base;
+
+// Slice proxy returned by range() and operator(). Reads as an unsigned
+// value, writes keep only the low (hi - lo + 1) bits of the source.
+template <int W, bool S> class ap_range_ref {
+public:
+    ap_range_ref(ap_int_base<W, S> *v, int hi, int lo) : v(v), hi(hi), lo(lo) {}
+
+    operator uint64_t() const { return v->get_bits(hi, lo); }
+
+    ap_range_ref &operator=(const ap_range_ref &r) { return *this = (uint64_t) r; }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    ap_range_ref &operator=(T x) {
+        v->set_bits(hi, lo, (uint64_t) x);
+        return *this;
+    }
+
+    template <int W2, bool S2> ap_range_ref &operator=(const ap_int_base<W2, S2> &x) {
+        v->set_bits(hi, lo, x.word(0));
+        return *this;
+    }
+
+    template <int W2, bool S2> ap_range_ref &operator=(const ap_range_ref<W2, S2> &r) {
+        return *this = (uint64_t) r;
+    }
+
+private:
+    ap_int_base<W, S> *v;
+    int hi, lo;
+};
+
+template <int W, bool S> class ap_int_base {
+    static_assert(W > 0, "ap_int width must be positive");
+
+public:
+    static const int width = W;
+    static const int words = (W + 63) / 64;
+
+    ap_int_base() { std::memset(w, 0, sizeof(w)); }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    ap_int_base(T x) {
+        assign_int((uint64_t) x, std::is_signed<T>::value && x < 0);
+    }
+
+    ap_int_base(double x) { assign_int((uint64_t) (int64_t) x, x < 0); }
+
+    template <int W2, bool S2> ap_int_base(const ap_int_base<W2, S2> &x) {
+        bool neg = S2 && x.bit(W2 - 1);
+        for (int i = 0; i < words; i++)
+            w[i] = i < x.words ? x.word(i) : (neg ? ~0ull : 0);
+        if (neg && W > W2) {
+            // sign-extend the partial top word of the narrower source
+            int top = (W2 - 1) / 64;
+            if (W2 % 64)
+                w[top] |= ~0ull << (W2 % 64);
+        }
+        mask_top();
+    }
+
+    template <int W2, bool S2> ap_int_base(const ap_range_ref<W2, S2> &r) { assign_int((uint64_t) r, false); }
+
+    // Integer value, sign-extended for ap_int. Wider values give their low
+    // 64 bits, which is what the kernels rely on when narrowing.
+    typedef typename std::conditional<S, int64_t, uint64_t>::type value_type;
+    operator value_type() const {
+        uint64_t x = w[0];
+        if (S && W < 64 && ((x >> (W - 1)) & 1))
+            x |= ~0ull << W;
+        return (value_type) x;
+    }
+
+    ap_range_ref<W, S> range(int hi, int lo) { return ap_range_ref<W, S>(this, hi, lo); }
+    ap_range_ref<W, S> operator()(int hi, int lo) { return ap_range_ref<W, S>(this, hi, lo); }
+    uint64_t range(int hi, int lo) const { return get_bits(hi, lo); }
+    uint64_t operator()(int hi, int lo) const { return get_bits(hi, lo); }
+
+    bool bit(int i) const { return (w[i / 64] >> (i % 64)) & 1; }
+    bool operator[](int i) const { return bit(i); }
+    void set_bit(int i, bool b) { set_bits(i, i, b); }
+
+    template <typename T> ap_int_base &operator+=(T x) { return *this = (value_type) *this + x; }
+    template <typename T> ap_int_base &operator-=(T x) { return *this = (value_type) *this - x; }
+    template <typename T> ap_int_base &operator*=(T x) { return *this = (value_type) *this * x; }
+
+    bool operator==(const ap_int_base &o) const { return !std::memcmp(w, o.w, sizeof(w)); }
+    bool operator!=(const ap_int_base &o) const { return !(*this == o); }
+
+    uint64_t word(int i) const { return w[i]; }
+
+    uint64_t get_bits(int hi, int lo) const {
+        int n = hi - lo + 1;
+        int i = lo / 64, off = lo % 64;
+        uint64_t x = w[i] >> off;
+        if (off + n > 64 && i + 1 < words)
+            x |= w[i + 1] << (64 - off);
+        return n == 64 ? x : x & ((1ull << n) - 1);
+    }
+
+    void set_bits(int hi, int lo, uint64_t x) {
+        int n = hi - lo + 1;
+        uint64_t m = n == 64 ? ~0ull : (1ull << n) - 1;
+        x &= m;
+        int i = lo / 64, off = lo % 64;
+        w[i] = (w[i] & ~(m << off)) | (x << off);
+        if (off + n > 64 && i + 1 < words) {
+            int sh = 64 - off;
+            w[i + 1] = (w[i + 1] & ~(m >> sh)) | (x >> sh);
+        }
+        mask_top();
+    }
+
+private:
+    void assign_int(uint64_t x, bool neg) {
+        w[0] = x;
+        for (int i = 1; i < words; i++)
+            w[i] = neg ? ~0ull : 0;
+        mask_top();
+    }
+
+    // bits above W are kept zero so that comparisons see canonical words
+    void mask_top() {
+        if (W % 64)
+            w[words - 1] &= (1ull << (W % 64)) - 1;
+    }
+
+    uint64_t w[words];
+};
+
+template <int W> class ap_int : public ap_int_base<W, true> {
+public:
+    using ap_int_base<W, true>::ap_int_base;
+    ap_int() {}
+};
+
+template <int W> class ap_uint : public ap_int_base<W, false> {
+public:
+    using ap_int_base<W, false>::ap_int_base;
+    ap_uint() {}
+};
+
+#endif
@@ -0,0 +1,70 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Native execution of a DATAFLOW region: every stage runs on its own
+// thread and the region ends when all of them have returned. Stages talk
+// only through hls::stream, which blocks on full/empty like the hardware
+// FIFOs. Not part of the vendor headers, kernels include it under
+// MM_NATIVE only.
+//
+// With MM_NATIVE_PROFILE set each stage reports its wall time, the stage
+// that finishes last with the least stalling is the bottleneck.
+
+#ifndef MM_NATIVE_HLS_DATAFLOW_H
+#define MM_NATIVE_HLS_DATAFLOW_H
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+#include "hls_stream.h"
+
+namespace hls_native {
+
+struct stage {
+    const char *name;
+    std::function<void()> body;
+};
+
+inline void dataflow(std::initializer_list<stage> stages) {
+    std::vector<std::thread> threads;
+    std::vector<double> seconds(stages.size());
+    int i = 0;
+    for (const stage &s : stages) {
+        double *t = &seconds[i++];
+        std::function<void()> body = s.body;
+        threads.emplace_back([body, t] {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            *t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    if (profiling()) {
+        i = 0;
+        for (const stage &s : stages)
+            std::fprintf(stderr, "[native] stage  %-12s %.3f ms\n", s.name, seconds[i++] * 1e3);
+    }
+}
+
+} // namespace hls_native
+
+#endif
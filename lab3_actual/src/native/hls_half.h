@@ -0,0 +1,86 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Lightweight stand-in for the vendor hls_half.h, used to build the kernels
+// natively (-DMM_NATIVE -Inative). Only what the kernels use is provided:
+// conversions between half and float (round to nearest even) and access to
+// the 16 encoding bits through get_bits() / set_bits().
+
+#ifndef MM_NATIVE_HLS_HALF_H
+#define MM_NATIVE_HLS_HALF_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "ap_int.h"
+
+class half {
+public:
+    half() : h(0) {}
+    half(float f) : h(from_float(f)) {}
+
+    operator float() const { return to_float(h); }
+
+    ap_uint<16> get_bits() const { return h; }
+    void set_bits(ap_uint<16> b) { h = (uint16_t) b; }
+
+private:
+    static float to_float(uint16_t h) {
+        uint32_t sign = (uint32_t) (h & 0x8000) << 16, exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+        if (exp == 0) {
+            float f = std::ldexp((float) mant, -24);
+            return sign ? -f : f;
+        }
+        uint32_t x = sign | (exp == 31 ? 0x7f800000 | mant << 13 : (exp + 112) << 23 | mant << 13);
+        float f;
+        std::memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+
+    static uint16_t from_float(float f) {
+        uint32_t x;
+        std::memcpy(&x, &f, sizeof(x));
+        uint32_t sign = (x >> 16) & 0x8000, mant = x & 0x7fffff;
+        int fexp = (x >> 23) & 0xff, exp = fexp - 127 + 15;
+        if (fexp == 0xff)
+            return (uint16_t) (sign | 0x7c00 | (mant ? 0x200 : 0));
+        if (exp >= 31)
+            return (uint16_t) (sign | 0x7c00);
+        if (exp < -10)
+            return (uint16_t) sign;
+        uint32_t r, rem, mid;
+        if (exp <= 0) {
+            // subnormal
+            int shift = 14 - exp;
+            mant |= 0x800000;
+            r = mant >> shift;
+            rem = mant & ((1u << shift) - 1);
+            mid = 1u << (shift - 1);
+        } else {
+            r = (uint32_t) exp << 10 | mant >> 13;
+            rem = mant & 0x1fff;
+            mid = 0x1000;
+        }
+        if (rem > mid || (rem == mid && (r & 1)))
+            r++;
+        return (uint16_t) (sign | r);
+    }
+
+    uint16_t h;
+};
+
+#endif
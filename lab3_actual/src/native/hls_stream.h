@@ -0,0 +1,155 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Lightweight stand-in for the vendor hls_stream.h, used to build the
+// kernels natively (-DMM_NATIVE -Inative).
+//
+// hls::stream is a bounded, lock-free single-producer/single-consumer FIFO.
+// Unlike C simulation, where streams are unbounded and DATAFLOW stages run
+// one after the other, the native build runs every stage on its own thread
+// (see hls_dataflow.h), so a full FIFO stalls its writer the same way it
+// back-pressures the hardware.
+//
+// With MM_NATIVE_PROFILE set in the environment each named stream reports
+// its stall counts when destroyed, which shows where the pipeline is
+// unbalanced.
+
+#ifndef MM_NATIVE_HLS_STREAM_H
+#define MM_NATIVE_HLS_STREAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+#ifndef MM_NATIVE_STREAM_DEPTH
+#define MM_NATIVE_STREAM_DEPTH 1024
+#endif
+
+namespace hls_native {
+
+inline bool profiling() {
+    static const bool on = std::getenv("MM_NATIVE_PROFILE") != nullptr;
+    return on;
+}
+
+// Spin briefly, then give the core away; stage threads usually outnumber cores.
+inline void backoff(unsigned &spins) {
+    if (++spins < 64)
+        return;
+    std::this_thread::yield();
+}
+
+inline size_t pow2_at_least(size_t n) {
+    size_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+} // namespace hls_native
+
+namespace hls {
+
+template <typename T, int DEPTH = 0> class stream {
+public:
+    stream() : stream("") {}
+
+    explicit stream(const char *name)
+        : cap(hls_native::pow2_at_least(DEPTH > 0 ? DEPTH : MM_NATIVE_STREAM_DEPTH)), buf(new T[cap]), label(name),
+          head(0), read_stalls(0), tail(0), write_stalls(0) {}
+
+    stream(const stream &) = delete;
+    stream &operator=(const stream &) = delete;
+
+    ~stream() {
+        if (hls_native::profiling() && !label.empty()) {
+            std::fprintf(stderr, "[native] stream %-12s depth %zu, read stalls %llu, write stalls %llu\n",
+                         label.c_str(), cap, (unsigned long long) read_stalls, (unsigned long long) write_stalls);
+        }
+    }
+
+    void write(const T &v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        unsigned spins = 0;
+        if (t - head.load(std::memory_order_acquire) == cap) {
+            write_stalls++;
+            while (t - head.load(std::memory_order_acquire) == cap)
+                hls_native::backoff(spins);
+        }
+        buf[t & (cap - 1)] = v;
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    T read() {
+        size_t h = head.load(std::memory_order_relaxed);
+        unsigned spins = 0;
+        if (tail.load(std::memory_order_acquire) == h) {
+            read_stalls++;
+            while (tail.load(std::memory_order_acquire) == h)
+                hls_native::backoff(spins);
+        }
+        T v = buf[h & (cap - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return v;
+    }
+
+    void read(T &v) { v = read(); }
+
+    bool write_nb(const T &v) {
+        if (full())
+            return false;
+        write(v);
+        return true;
+    }
+
+    bool read_nb(T &v) {
+        if (empty())
+            return false;
+        v = read();
+        return true;
+    }
+
+    stream &operator<<(const T &v) {
+        write(v);
+        return *this;
+    }
+    stream &operator>>(T &v) {
+        v = read();
+        return *this;
+    }
+
+    bool empty() const { return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire); }
+    bool full() const { return size() == cap; }
+    size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+
+private:
+    const size_t cap;
+    std::unique_ptr<T[]> buf;
+    std::string label;
+    // consumer and producer state live on separate cache lines
+    alignas(64) std::atomic<size_t> head;
+    unsigned long long read_stalls;
+    alignas(64) std::atomic<size_t> tail;
+    unsigned long long write_stalls;
+};
+
+} // namespace hls
+
+#endif
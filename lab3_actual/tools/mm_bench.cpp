@@ -0,0 +1,342 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Benchmark driver: every engine over a sweep of problem sizes.
+//
+// Engines are the FPGA kernels v0-v5 and the skinny mm_gemv kernel ("gemv")
+// (one xclbin each), the native CPU builds of mm_v4 ("cpu") and mm_gemv
+// ("cpu-gemv") and the host reference ("sw", mm_ref.h). For every
+// engine and size the inputs are synced once, then the kernel is launched
+// `warmup` times untimed and `repeats` times timed, each from launch to
+// completion. The result of the last run is checked against the reference.
+// Element types follow the flags of mm_config.h and have to match the
+// xclbins; float and half results are checked within mm_t::tolerance.
+//
+// An engine name suffixed +sD (e.g. cpu+s1, v4+s2) runs the same kernel
+// under D levels of Strassen-Winograd recursion (mm_strassen.h); its time
+// covers the host passes as well, launch to combined result, so it reads
+// directly against the plain engine at every size. Float results of D
+// levels are checked within mm_strassen_tolerance(D).
+//
+// Effective DRAM bandwidth is the traffic predicted by mm_model.h for that
+// kernel divided by the measured median time ("sw" counts each operand
+// once, recursion runs the leaves' traffic).
+//
+//   g++ -std=c++17 -O2 -fopenmp -march=native -I../src -I$XILINX_XRT/include mm_bench.cpp
+//       ../src/mm_cpu.cpp ../src/mm_cpu_gemv.cpp -DMM_NATIVE -I../src/native -L$XILINX_XRT/lib -lxrt_coreutil -pthread
+//   ./mm_bench --xclbin v4=mm_v4.xclbin --engines sw,cpu,v4 --sizes 256,512,1000x300x2000 --json out.json
+//
+// Build with -DMM_NO_XRT (and without the XRT flags) for the CPU engines only.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mm_backend.h"
+#include "mm_model.h"
+#include "mm_ref.h"
+#include "mm_shape.h"
+#include "mm_stats.h"
+#include "mm_strassen.h"
+
+struct bench_result {
+    std::string engine;
+    mm_shape shape;
+    int warmup, repeats;
+    double median, p95, p99, min; // seconds
+    double gops;
+    double dram_gbps;
+    bool valid;
+};
+
+static void usage(const char *prog) {
+    std::printf("Usage: %s [--engines sw,cpu,cpu-gemv,v0,...,v5,gemv[+sD]] [--sizes N,MxKxN,...] [--warmup W] [--repeats R]\n"
+                "          [--xclbin vX=file.xclbin]... [--json file] [--csv file]\n", prog);
+}
+
+static std::vector<std::string> split(const std::string &s, char sep) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, sep))
+        if (!item.empty())
+            out.push_back(item);
+    return out;
+}
+
+// "N" or "MxKxN"
+static bool parse_size(const std::string &s, mm_shape &shape) {
+    std::vector<std::string> d = split(s, 'x');
+    std::vector<char *> dims;
+    for (auto &x : d)
+        dims.push_back(&x[0]);
+    return (dims.size() == 1 || dims.size() == 3) && parse_shape((int) dims.size(), dims.data(), shape);
+}
+
+static void fill_problem(const mm_shape &shape, mm_in_t *A, mm_in_t *B) {
+    srand(1);
+    for (int i = 0; i < shape.M; ++i)
+        for (int k = 0; k < shape.K; ++k)
+            shape.set_a(A, i, k, mm_t::sample(rand()));
+    for (int k = 0; k < shape.K; ++k)
+        for (int j = 0; j < shape.N; ++j)
+            shape.set_b(B, k, j, mm_t::sample(rand()));
+}
+
+static bool matches(const mm_shape &shape, const mm_out_t *AB_sw, const mm_out_t *AB, double tol) {
+    for (int i = 0; i < shape.M; i++)
+        for (int j = 0; j < shape.N; j++)
+            if (!mm_close(shape.get_ab(AB_sw, i, j), shape.get_ab(AB, i, j), tol))
+                return false;
+    return true;
+}
+
+class bench_engine {
+public:
+    // v0-v2 read A row-major, v3-v5 and the CPU engines transposed. With
+    // depth >= 0 the kernel runs under that many levels of Strassen.
+    bench_engine(const std::string &name, const std::string &kernel, int depth, std::unique_ptr<mm_backend> backend)
+        : name(name), kernel(kernel), depth(depth), backend(std::move(backend)),
+          layout(kernel == "v0" || kernel == "v1" || kernel == "v2" ? A_ROW_MAJOR : A_COL_MAJOR) {}
+
+    bench_result run(mm_shape shape, int warmup, int repeats) {
+        shape.a_layout = layout;
+        if (depth >= 0)
+            return run_strassen(shape, warmup, repeats);
+        mm_operands ops(*backend, shape);
+        fill_problem(shape, ops.A(), ops.B());
+        ops.sync_in();
+
+        mm_samples t;
+        for (int r = 0; r < warmup + repeats; r++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            if (name == "sw")
+                mm_golden(shape, ops.A(), ops.B(), ops.AB());
+            else
+                ops.launch(*backend).wait();
+            auto end = std::chrono::high_resolution_clock::now();
+            if (r >= warmup)
+                t.add(std::chrono::duration<double>(end - start).count());
+        }
+        ops.sync_out();
+
+        std::vector<mm_out_t> golden(shape.ab_elems());
+        mm_golden(shape, ops.A(), ops.B(), golden.data());
+
+        bench_result res;
+        res.engine = name;
+        res.shape = shape;
+        res.warmup = warmup;
+        res.repeats = repeats;
+        res.median = t.median();
+        res.p95 = t.percentile(95);
+        res.p99 = t.percentile(99);
+        res.min = t.min();
+        res.gops = shape.ops() * 1e-9 / res.median;
+        res.dram_gbps = dram_bytes(shape) * 1e-9 / res.median;
+        res.valid = matches(shape, golden.data(), ops.AB(), mm_t::tolerance);
+        return res;
+    }
+
+    std::string name;
+
+private:
+    bench_result run_strassen(const mm_shape &shape, int warmup, int repeats) {
+        mm_strassen st(*backend, shape, depth, BO_DEVICE);
+        fill_problem(shape, st.A(), st.B());
+
+        mm_samples t;
+        for (int r = 0; r < warmup + repeats; r++) {
+            mm_strassen_stats s = st.run();
+            if (r >= warmup)
+                t.add(s.seconds);
+        }
+
+        std::vector<mm_out_t> golden(shape.ab_elems());
+        mm_golden(shape, st.A(), st.B(), golden.data());
+
+        bench_result res;
+        res.engine = name;
+        res.shape = shape;
+        res.warmup = warmup;
+        res.repeats = repeats;
+        res.median = t.median();
+        res.p95 = t.percentile(95);
+        res.p99 = t.percentile(99);
+        res.min = t.min();
+        res.gops = shape.ops() * 1e-9 / res.median;
+        res.dram_gbps = dram_bytes(st.leaf()) * st.num_leaves() * 1e-9 / res.median;
+        res.valid = matches(shape, golden.data(), st.AB(), mm_strassen_tolerance(depth));
+        return res;
+    }
+
+    double dram_bytes(const mm_shape &shape) const {
+        if (kernel == "sw")
+            return (double) (shape.a_bytes() + shape.b_bytes() + shape.ab_bytes());
+        std::string version = kernel == "cpu" ? "v4" : kernel == "cpu-gemv" ? "gemv" : kernel;
+        mm_model_kernel k;
+        k.in_bits = mm_t::in_bits;
+        k.out_bits = mm_t::out_bits;
+        return mm_model(version, shape, k, mm_model_hw()).total_bytes();
+    }
+
+    std::string kernel;
+    int depth;
+
+    std::unique_ptr<mm_backend> backend;
+    a_layout_t layout;
+};
+
+static void write_json(const std::string &path, const std::vector<bench_result> &results) {
+    std::ofstream out(path);
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const bench_result &r = results[i];
+        out << "  {\"engine\": \"" << r.engine << "\", \"M\": " << r.shape.M << ", \"K\": " << r.shape.K
+            << ", \"N\": " << r.shape.N << ", \"warmup\": " << r.warmup << ", \"repeats\": " << r.repeats
+            << ", \"median_s\": " << r.median << ", \"p95_s\": " << r.p95 << ", \"p99_s\": " << r.p99
+            << ", \"min_s\": " << r.min << ", \"gops\": " << r.gops << ", \"dram_gbps\": " << r.dram_gbps
+            << ", \"valid\": " << (r.valid ? "true" : "false") << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+static void write_csv(const std::string &path, const std::vector<bench_result> &results) {
+    std::ofstream out(path);
+    out << "engine,M,K,N,warmup,repeats,median_s,p95_s,p99_s,min_s,gops,dram_gbps,valid\n";
+    for (auto &r : results) {
+        out << r.engine << "," << r.shape.M << "," << r.shape.K << "," << r.shape.N << "," << r.warmup << ","
+            << r.repeats << "," << r.median << "," << r.p95 << "," << r.p99 << "," << r.min << "," << r.gops << ","
+            << r.dram_gbps << "," << (r.valid ? 1 : 0) << "\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> engine_names = {"sw", "cpu"};
+    std::vector<std::string> sizes = {"128", "256", "512", "1024"};
+    std::map<std::string, std::string> xclbins;
+    int warmup = 2, repeats = 10;
+    std::string json_path, csv_path;
+    bool engines_given = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool ok = i + 1 < argc;
+        if (ok && !strcmp(argv[i], "--engines")) {
+            engine_names = split(argv[++i], ',');
+            engines_given = true;
+        } else if (ok && !strcmp(argv[i], "--sizes")) {
+            sizes = split(argv[++i], ',');
+        } else if (ok && !strcmp(argv[i], "--warmup")) {
+            warmup = atoi(argv[++i]);
+        } else if (ok && !strcmp(argv[i], "--repeats")) {
+            repeats = atoi(argv[++i]);
+        } else if (ok && !strcmp(argv[i], "--xclbin")) {
+            std::string arg = argv[++i];
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            xclbins[arg.substr(0, eq)] = arg.substr(eq + 1);
+        } else if (ok && !strcmp(argv[i], "--json")) {
+            json_path = argv[++i];
+        } else if (ok && !strcmp(argv[i], "--csv")) {
+            csv_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    // without --engines, every kernel that got an xclbin is benchmarked too
+    if (!engines_given)
+        for (auto &x : xclbins)
+            engine_names.push_back(x.first);
+
+    std::vector<mm_shape> shapes;
+    for (auto &s : sizes) {
+        mm_shape shape = {0, 0, 0, A_COL_MAJOR};
+        if (!parse_size(s, shape)) {
+            std::printf("Bad size %s\n", s.c_str());
+            return EXIT_FAILURE;
+        }
+        shapes.push_back(shape);
+    }
+    if (warmup < 0 || repeats < 1 || shapes.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::unique_ptr<bench_engine>> engines;
+    for (auto &name : engine_names) {
+        // "<kernel>+s<depth>"
+        std::string kernel = name;
+        int depth = -1;
+        size_t plus = name.find("+s");
+        if (plus != std::string::npos) {
+            kernel = name.substr(0, plus);
+            depth = atoi(name.c_str() + plus + 2);
+            if (kernel == "sw" || depth < 0 || !mm_strassen_supported()) {
+                std::printf("Engine %s: no Strassen for this kernel or these element types\n", name.c_str());
+                return EXIT_FAILURE;
+            }
+        }
+        std::unique_ptr<mm_backend> backend;
+        if (kernel == "sw" || kernel == "cpu" || kernel == "cpu-gemv") {
+            backend.reset(new mm_cpu_backend(kernel == "cpu-gemv"));
+        } else if (xclbins.count(kernel)) {
+#ifndef MM_NO_XRT
+            backend.reset(new mm_xrt_backend(xclbins[kernel], 0, kernel == "gemv" ? "mm_gemv" : "mm"));
+#else
+            std::printf("Built without XRT, engine %s is not available\n", name.c_str());
+            return EXIT_FAILURE;
+#endif
+        } else {
+            std::printf("Engine %s needs --xclbin %s=<file>\n", name.c_str(), kernel.c_str());
+            return EXIT_FAILURE;
+        }
+        engines.emplace_back(new bench_engine(name, kernel, depth, std::move(backend)));
+    }
+
+    std::printf("%-11s %20s %12s %12s %12s %10s %10s %6s\n", "engine", "M x K x N", "median(ms)", "p95(ms)",
+                "p99(ms)", "GOPS", "DRAM GB/s", "valid");
+    std::vector<bench_result> results;
+    bool all_valid = true;
+    for (auto &shape : shapes) {
+        for (auto &e : engines) {
+            bench_result r = e->run(shape, warmup, repeats);
+            char dims[64];
+            std::snprintf(dims, sizeof(dims), "%d x %d x %d", shape.M, shape.K, shape.N);
+            std::printf("%-11s %20s %12.3f %12.3f %12.3f %10.2f %10.2f %6s\n", r.engine.c_str(), dims,
+                        r.median * 1e3, r.p95 * 1e3, r.p99 * 1e3, r.gops, r.dram_gbps, r.valid ? "yes" : "NO");
+            std::fflush(stdout);
+            all_valid = all_valid && r.valid;
+            results.push_back(r);
+        }
+    }
+
+    if (!json_path.empty())
+        write_json(json_path, results);
+    if (!csv_path.empty())
+        write_csv(csv_path, results);
+    return all_valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
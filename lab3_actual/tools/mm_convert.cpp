@@ -0,0 +1,322 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Converter between the kernels' matrix files (.mmt, mm_tiled.h) and
+// row-major raw or .npy files.
+//
+// The file type follows the extension: .mmt, .npy, anything else raw
+// row-major elements in the storage type of the operand (--shape gives
+// their dimensions). Into .mmt, --role selects the element type and
+// layout: A (transposed for the kernels, which read At, unless --a-layout
+// rows) and B take the input type, AB the output type. .npy data of any
+// integer or float dtype, C or Fortran order, is converted by value. Out
+// of .mmt, .npy files get the nearest dtype (ap_fixed as float64). Element
+// types follow the flags of mm_config.h, as for the host.
+//
+//   g++ -std=c++17 -O2 -I../src mm_convert.cpp -DMM_NO_XRT -o mm_convert
+//   ./mm_convert a.npy A.mmt --role a
+//   ./mm_convert b.raw B.mmt --role b --shape 1024 512
+//   ./mm_convert AB.mmt ab.npy
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mm_layout.h"
+#include "mm_tiled.h"
+
+static void usage(const char *prog) {
+    std::printf("Usage: %s <in.npy|in.raw|in.mmt> <out.mmt|out.npy|out.raw> [--role a|b|ab] [--a-layout rows|cols]\n"
+                "          [--shape ROWS COLS]\n", prog);
+}
+
+static bool ends_with(const std::string &s, const std::string &ext) {
+    return s.size() >= ext.size() && s.compare(s.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// A whole input file, mapped read-only.
+struct mapped_file {
+    explicit mapped_file(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0)
+            throw std::runtime_error("cannot open " + path);
+        size = st.st_size;
+        data = size ? (const char *) ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        ::close(fd);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("cannot map " + path);
+    }
+    ~mapped_file() {
+        if (data)
+            ::munmap((void *) data, size);
+    }
+
+    const char *data;
+    size_t size;
+};
+
+// A rows x cols matrix read element by element as doubles.
+struct source {
+    int rows, cols;
+    std::function<double(int, int)> get;
+};
+
+// Reads the dtype, order and shape of a .npy header (format 1.0 to 3.0);
+// descr is e.g. "<i2", "|i1" or "<f4".
+static source npy_source(const mapped_file &f) {
+    if (f.size < 10 || std::memcmp(f.data, "\x93NUMPY", 6))
+        throw std::runtime_error("not a .npy file");
+    int major = (unsigned char) f.data[6];
+    size_t len, start;
+    if (major == 1) {
+        len = (unsigned char) f.data[8] | (unsigned char) f.data[9] << 8;
+        start = 10;
+    } else {
+        uint32_t l;
+        std::memcpy(&l, f.data + 8, 4);
+        len = l;
+        start = 12;
+    }
+    if (start + len > f.size)
+        throw std::runtime_error("truncated .npy header");
+    std::string h(f.data + start, len);
+    auto value = [&](const std::string &key) {
+        size_t p = h.find("'" + key + "'");
+        if (p == std::string::npos)
+            throw std::runtime_error(".npy header without " + key);
+        p = h.find(':', p);
+        return h.substr(p + 1);
+    };
+    std::string descr = value("descr");
+    descr = descr.substr(descr.find('\'') + 1);
+    descr = descr.substr(0, descr.find('\''));
+    std::string order = value("fortran_order");
+    bool fortran = order.compare(order.find_first_not_of(' '), 4, "True") == 0;
+    std::string shape = value("shape");
+    shape = shape.substr(shape.find('(') + 1, shape.find(')') - shape.find('(') - 1);
+    std::vector<long> dims;
+    for (size_t p = 0; p < shape.size();) {
+        char *end;
+        long d = std::strtol(shape.c_str() + p, &end, 10);
+        if (end == shape.c_str() + p)
+            break;
+        dims.push_back(d);
+        p = shape.find(',', end - shape.c_str());
+        p = p == std::string::npos ? shape.size() : p + 1;
+    }
+    if (dims.empty() || dims.size() > 2 || descr.size() < 3 || descr[0] == '>')
+        throw std::runtime_error("unsupported .npy array " + descr + " (" + shape + ")");
+
+    source s;
+    s.rows = (int) dims[0];
+    s.cols = dims.size() == 2 ? (int) dims[1] : 1;
+    char kind = descr[1];
+    int bytes = std::atoi(descr.c_str() + 2);
+    const char *base = f.data + start + len;
+    if ((size_t) s.rows * s.cols * bytes > f.size - start - len)
+        throw std::runtime_error("truncated .npy data");
+    std::function<double(size_t)> elem;
+    if (kind == 'i' && bytes == 1)
+        elem = [base](size_t e) { return (double) ((const int8_t *) base)[e]; };
+    else if (kind == 'i' && bytes == 2)
+        elem = [base](size_t e) { return (double) mm_elem<16>::get_raw(base, e); };
+    else if (kind == 'i' && bytes == 4)
+        elem = [base](size_t e) { return (double) mm_elem<32>::get_raw(base, e); };
+    else if (kind == 'i' && bytes == 8)
+        elem = [base](size_t e) { int64_t v; std::memcpy(&v, base + e * 8, 8); return (double) v; };
+    else if (kind == 'u' && bytes == 1)
+        elem = [base](size_t e) { return (double) ((const uint8_t *) base)[e]; };
+    else if (kind == 'u' && bytes == 2)
+        elem = [base](size_t e) { uint16_t v; std::memcpy(&v, base + e * 2, 2); return (double) v; };
+    else if (kind == 'f' && bytes == 2)
+        elem = [base](size_t e) { return mm_half_elem::get(base, e); };
+    else if (kind == 'f' && bytes == 4)
+        elem = [base](size_t e) { return mm_float_elem::get(base, e); };
+    else if (kind == 'f' && bytes == 8)
+        elem = [base](size_t e) { double v; std::memcpy(&v, base + e * 8, 8); return v; };
+    else
+        throw std::runtime_error("unsupported .npy dtype " + descr);
+    int rows = s.rows, cols = s.cols;
+    if (fortran)
+        s.get = [elem, rows](int r, int c) { return elem((size_t) c * rows + r); };
+    else
+        s.get = [elem, cols](int r, int c) { return elem((size_t) r * cols + c); };
+    return s;
+}
+
+// Raw rows are whole bytes, 4 bit elements packed two per byte.
+static size_t raw_row_bytes(int cols, int bits) { return ((size_t) cols * bits + 7) / 8; }
+
+template <class E> static source raw_source(const mapped_file &f, int rows, int cols, int bits) {
+    size_t row_bytes = raw_row_bytes(cols, bits);
+    if (rows * row_bytes > f.size)
+        throw std::runtime_error("raw file smaller than " + std::to_string(rows) + " x " + std::to_string(cols));
+    const char *base = f.data;
+    return source{rows, cols, [base, row_bytes](int r, int c) { return E::get(base + r * row_bytes, c); }};
+}
+
+// Index of the element (r, c) in a .mmt payload.
+static size_t tiled_index(const mm_tiled_header &h, int r, int c) {
+    return h.layout == TILED_TRANSPOSED ? (size_t) c * h.ld + r : (size_t) r * h.ld + c;
+}
+
+template <class E> static void to_tiled(const source &src, const std::string &out, mm_dtype dtype,
+                                        mm_tiled_layout_t layout) {
+    mm_tiled_file f = mm_tiled_file::create(out, src.rows, src.cols, dtype, layout);
+    void *p = f.data();
+    for (int r = 0; r < src.rows; r++)
+        for (int c = 0; c < src.cols; c++)
+            E::set(p, tiled_index(f.info(), r, c), src.get(r, c));
+    f.flush();
+}
+
+// .npy descr written for dtype, with its element size.
+static std::string npy_descr(const mm_dtype &d, int &bytes) {
+    if (d.family == DTYPE_FLOAT)
+        return bytes = 4, "<f4";
+    if (d.family == DTYPE_HALF)
+        return bytes = 2, "<f2";
+    if (d.family == DTYPE_FIXED)
+        return bytes = 8, "<f8";
+    bytes = d.bits <= 8 ? 1 : d.bits / 8;
+    return bytes == 1 ? "|i1" : "<i" + std::to_string(bytes);
+}
+
+template <class E> static void from_tiled(const mm_tiled_file &f, const std::string &out) {
+    const mm_tiled_header &h = f.info();
+    FILE *fp = std::fopen(out.c_str(), "wb");
+    if (!fp)
+        throw std::runtime_error("cannot create " + out);
+    bool npy = ends_with(out, ".npy");
+    int bytes = 0;
+    std::string descr;
+    if (npy) {
+        descr = npy_descr(h.dtype, bytes);
+        std::string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (" +
+                           std::to_string(h.rows) + ", " + std::to_string(h.cols) + "), }";
+        // magic, version 1.0, the header padded with spaces to 64 bytes
+        size_t total = (10 + dict.size() + 1 + 63) / 64 * 64;
+        dict.append(total - 10 - dict.size() - 1, ' ');
+        dict += '\n';
+        uint16_t len = (uint16_t) dict.size();
+        std::fwrite("\x93NUMPY\x01\x00", 1, 8, fp);
+        std::fputc(len & 0xff, fp);
+        std::fputc(len >> 8, fp);
+        std::fwrite(dict.data(), 1, dict.size(), fp);
+    }
+    std::vector<char> row(npy ? (size_t) h.cols * bytes : raw_row_bytes((int) h.cols, h.dtype.bits));
+    for (int r = 0; r < (int) h.rows; r++) {
+        std::memset(row.data(), 0, row.size());
+        for (int c = 0; c < (int) h.cols; c++) {
+            double v = E::get(f.data(), tiled_index(h, r, c));
+            if (!npy)
+                E::set(row.data(), c, v);
+            else if (descr == "<f4")
+                mm_float_elem::set(row.data(), c, v);
+            else if (descr == "<f2")
+                mm_half_elem::set(row.data(), c, v);
+            else if (descr == "<f8")
+                std::memcpy(row.data() + (size_t) c * 8, &v, 8);
+            else if (bytes == 1)
+                mm_elem<8>::set(row.data(), c, v);
+            else if (bytes == 2)
+                mm_elem<16>::set(row.data(), c, v);
+            else
+                mm_elem<32>::set(row.data(), c, v);
+        }
+        std::fwrite(row.data(), 1, row.size(), fp);
+    }
+    if (std::fclose(fp) != 0)
+        throw std::runtime_error("cannot write " + out);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string in = argv[1], out = argv[2], role = "a";
+    a_layout_t a_layout = A_COL_MAJOR;
+    int rows = 0, cols = 0;
+    for (int i = 3; i < argc; i++) {
+        if (!strcmp(argv[i], "--role") && i + 1 < argc) {
+            role = argv[++i];
+        } else if (!strcmp(argv[i], "--a-layout") && i + 1 < argc) {
+            if (!parse_a_layout(argv[++i], a_layout)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (!strcmp(argv[i], "--shape") && i + 2 < argc) {
+            rows = atoi(argv[++i]);
+            cols = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if ((role != "a" && role != "b" && role != "ab") || ends_with(in, ".mmt") == ends_with(out, ".mmt")) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        if (ends_with(in, ".mmt")) {
+            mm_tiled_file f = mm_tiled_file::open(in);
+            if (f.info().dtype == mm_dtype_in())
+                from_tiled<mm_t::in>(f, out);
+            else if (f.info().dtype == mm_dtype_out())
+                from_tiled<mm_t::out>(f, out);
+            else
+                throw std::runtime_error(in + " holds " + f.info().dtype.name() + " elements, this build " +
+                                         mm_dtype_in().name() + " / " + mm_dtype_out().name());
+            std::printf("%s: %d x %d %s\n", out.c_str(), f.rows(), f.cols(), f.info().dtype.name().c_str());
+            return EXIT_SUCCESS;
+        }
+
+        bool is_ab = role == "ab";
+        mm_dtype dtype = is_ab ? mm_dtype_out() : mm_dtype_in();
+        mm_tiled_layout_t layout = role == "a" && a_layout == A_COL_MAJOR ? TILED_TRANSPOSED : TILED_ROW_MAJOR;
+        mapped_file f(in);
+        source src;
+        if (ends_with(in, ".npy"))
+            src = npy_source(f);
+        else if (rows <= 0 || cols <= 0)
+            throw std::runtime_error("raw input needs --shape ROWS COLS");
+        else
+            src = is_ab ? raw_source<mm_t::out>(f, rows, cols, mm_t::out_bits)
+                        : raw_source<mm_t::in>(f, rows, cols, mm_t::in_bits);
+        if (is_ab)
+            to_tiled<mm_t::out>(src, out, dtype, layout);
+        else
+            to_tiled<mm_t::in>(src, out, dtype, layout);
+        std::printf("%s: %d x %d %s%s\n", out.c_str(), src.rows, src.cols, dtype.name().c_str(),
+                    layout == TILED_TRANSPOSED ? ", transposed" : "");
+    } catch (const std::exception &e) {
+        std::printf("%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
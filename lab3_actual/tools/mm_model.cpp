@@ -0,0 +1,147 @@
+/**
+* Copyright (C) 2019-2021 Xilinx, Inc
+*
+* Licensed under the Apache License, Version 2.0 (the "License"). You may
+* not use this file except in compliance with the License. A copy of the
+* License is located at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+* WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+* License for the specific language governing permissions and limitations
+* under the License.
+*/
+
+// Estimates cycles, DRAM traffic and arithmetic intensity of every kernel
+// version without synthesis, see mm_model.h for the cost model.
+//
+//   g++ -std=c++17 -O2 -I../src mm_model.cpp -o mm_model
+//   ./mm_model 512
+//   ./mm_model 1000 300 2000 --clock 300 --kernel v4=../src/mm_v4.cpp
+//   ./mm_model 1024 --bits 8 32
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mm_model.h"
+
+static void usage(const char *prog) {
+    std::printf("Usage: %s [N | M K N] [--batch B] [--clock MHz] [--latency cycles] [--outstanding n]\n"
+                "          [--depth cycles] [--kernel vX=path/to/mm_vX.cpp]...\n"
+                "          [--order rows|cols] [--panels A B] [--array R C] [--bits IN OUT]\n", prog);
+}
+
+static bool parse_int(const char *s, int &v) {
+    char *end;
+    long x = std::strtol(s, &end, 10);
+    if (*end != '\0' || x <= 0)
+        return false;
+    v = (int) x;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    mm_shape shape = {512, 512, 512, A_COL_MAJOR};
+    mm_model_hw hw;
+    std::map<std::string, mm_model_kernel> kernels;
+    for (auto &v : mm_model_versions())
+        kernels[v] = mm_model_kernel();
+    int batch = 1;
+    std::vector<char *> dims;
+    for (int i = 1; i < argc; i++) {
+        bool ok = true;
+        if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+            ok = parse_int(argv[++i], batch);
+        } else if (!strcmp(argv[i], "--clock") && i + 1 < argc) {
+            hw.clock_mhz = std::atof(argv[++i]);
+            ok = hw.clock_mhz > 0;
+        } else if (!strcmp(argv[i], "--latency") && i + 1 < argc) {
+            ok = parse_int(argv[++i], hw.mem_latency);
+        } else if (!strcmp(argv[i], "--outstanding") && i + 1 < argc) {
+            ok = parse_int(argv[++i], hw.outstanding);
+        } else if (!strcmp(argv[i], "--depth") && i + 1 < argc) {
+            ok = parse_int(argv[++i], hw.pipe_depth);
+        } else if (!strcmp(argv[i], "--order") && i + 1 < argc) {
+            ok = parse_tile_order(argv[++i], kernels["v4"].order);
+            kernels["v5"].order = kernels["v4"].order;
+        } else if (!strcmp(argv[i], "--panels") && i + 2 < argc) {
+            ok = parse_int(argv[i + 1], kernels["v4"].a_panels) && parse_int(argv[i + 2], kernels["v4"].b_panels);
+            kernels["v5"].a_panels = kernels["v4"].a_panels;
+            kernels["v5"].b_panels = kernels["v4"].b_panels;
+            i += 2;
+        } else if (!strcmp(argv[i], "--array") && i + 2 < argc) {
+            ok = parse_int(argv[i + 1], kernels["v5"].sa_rows) && parse_int(argv[i + 2], kernels["v5"].sa_cols);
+            i += 2;
+        } else if (!strcmp(argv[i], "--bits") && i + 2 < argc) {
+            // element widths of the templated kernels
+            for (const char *v : {"v4", "v5"})
+                ok = ok && parse_int(argv[i + 1], kernels[v].in_bits) && parse_int(argv[i + 2], kernels[v].out_bits);
+            i += 2;
+        } else if (!strcmp(argv[i], "--kernel") && i + 1 < argc) {
+            std::string arg = argv[++i];
+            size_t eq = arg.find('=');
+            ok = eq != std::string::npos && kernels.count(arg.substr(0, eq)) &&
+                 parse_kernel(arg.substr(eq + 1), kernels[arg.substr(0, eq)]);
+        } else if (!strncmp(argv[i], "--", 2)) {
+            ok = false;
+        } else {
+            dims.push_back(argv[i]);
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!parse_shape((int) dims.size(), dims.data(), shape)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("Shape %d x %d x %d, batch %d, %.0f MHz, latency %d, outstanding %d, pipeline depth %d\n\n",
+                shape.M, shape.K, shape.N, batch, hw.clock_mhz, hw.mem_latency, hw.outstanding, hw.pipe_depth);
+    std::printf("%-4s %14s %12s %10s %11s %11s %11s %11s %10s\n", "ver", "cycles", "time(ms)", "GOPS", "gmem0(MB)",
+                "gmem1(MB)", "gmem2(MB)", "gmem3(MB)", "ops/byte");
+
+    std::vector<mm_model_result> results;
+    double ops = shape.ops() * batch;
+    for (auto &v : mm_model_versions()) {
+        mm_model_result r = mm_model(v, shape, kernels[v], hw, batch);
+        results.push_back(r);
+        double sec = r.seconds(hw);
+        std::printf("%-4s %14.0f %12.3f %10.2f", r.version.c_str(), r.cycles, sec * 1e3, ops * 1e-9 / sec);
+        if (r.shared_port)
+            std::printf(" %11.2f %11s %11s %11s", r.bytes[0] / 1e6, "(shared)", "(shared)", "-");
+        else
+            std::printf(" %11.2f %11.2f %11.2f %11.2f", r.bytes[0] / 1e6, r.bytes[1] / 1e6, r.bytes[2] / 1e6,
+                        r.bytes[3] / 1e6);
+        std::printf(" %10.2f\n", ops / r.total_bytes());
+    }
+
+    for (auto &r : results) {
+        int worst = r.bottleneck();
+        if (worst < 0)
+            continue;
+        std::printf("\n%s dataflow stages:\n", r.version.c_str());
+        for (int s = 0; s < (int) r.stages.size(); s++) {
+            std::printf("  %-12s %14.0f cycles %6.1f%%%s\n", r.stages[s].name.c_str(), r.stages[s].cycles,
+                        100.0 * r.stages[s].cycles / r.stages[worst].cycles, s == worst ? "  <- bottleneck" : "");
+        }
+    }
+
+    std::vector<const mm_model_result *> ranked;
+    for (auto &r : results)
+        ranked.push_back(&r);
+    std::sort(ranked.begin(), ranked.end(),
+              [](const mm_model_result *a, const mm_model_result *b) { return a->cycles < b->cycles; });
+    std::printf("\nRanking:");
+    for (auto *r : ranked)
+        std::printf(" %s", r->version.c_str());
+    std::printf("\n");
+    return EXIT_SUCCESS;
+}